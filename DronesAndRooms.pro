@@ -1,6 +1,7 @@
-QT       += core gui
+QT       += core gui concurrent widgets
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+# QPromise, QMouseEvent::position(), qsizetype and QList::clear() keeping its capacity
+lessThan(QT_MAJOR_VERSION, 6): error("DronesAndRooms requires Qt 6")
 
 CONFIG += c++17
 
@@ -10,22 +11,63 @@ CONFIG += c++17
 
 SOURCES += \
     canvas.cpp \
+    contractionhierarchy.cpp \
+    delaunay.cpp \
     determinant.cpp \
+    dispatcher.cpp \
+    eventsimulation.cpp \
+    failover.cpp \
+    headlessrun.cpp \
+    hilbert.cpp \
+    kpi.cpp \
     main.cpp \
     mainwindow.cpp \
     polygon.cpp \
+    roomgrid.cpp \
+    scenarioloader.cpp \
     serveranddrone.cpp \
+    sharedworld.cpp \
+    simulationclock.cpp \
+    spatialhash.cpp \
+    telemetry.cpp \
+    trace.cpp \
+    trajectory.cpp \
+    trajectoryindex.cpp \
+    trajectoryquery.cpp \
     trianglemesh.cpp \
-    vector2d.cpp
+    vector2d.cpp \
+    world.cpp
 
 HEADERS += \
     canvas.h \
+    contractionhierarchy.h \
+    delaunay.h \
     determinant.h \
+    dispatcher.h \
+    eventsimulation.h \
+    failover.h \
+    headlessrun.h \
+    hilbert.h \
+    kpi.h \
     mainwindow.h \
     polygon.h \
+    roomgrid.h \
+    scenarioloader.h \
     serveranddrone.h \
+    sharedworld.h \
+    simulationclock.h \
+    spatialhash.h \
+    telemetry.h \
+    trace.h \
+    trajectory.h \
+    trajectoryindex.h \
+    trajectoryquery.h \
     trianglemesh.h \
-    vector2d.h
+    vector2d.h \
+    world.h
+
+# shm_open of the shared world export
+unix:!macx: LIBS += -lrt
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,54 @@
+QT       += core gui concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# qsizetype and QList::clear() keeping its capacity, measured by the rebuild benchmark
+lessThan(QT_MAJOR_VERSION, 6): error("DronesAndRoomsBench requires Qt 6")
+
+# measurements of the model of DronesAndRooms, without the interface;
+# the allocation counter replaces malloc in this program only
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../contractionhierarchy.cpp \
+    ../delaunay.cpp \
+    ../determinant.cpp \
+    ../dispatcher.cpp \
+    ../failover.cpp \
+    ../hilbert.cpp \
+    ../kpi.cpp \
+    ../polygon.cpp \
+    ../roomgrid.cpp \
+    ../scenarioloader.cpp \
+    ../serveranddrone.cpp \
+    ../simulationclock.cpp \
+    ../spatialhash.cpp \
+    ../trace.cpp \
+    ../trianglemesh.cpp \
+    ../vector2d.cpp \
+    ../world.cpp \
+    allocationcounter.cpp \
+    benchmark.cpp \
+    main.cpp
+
+HEADERS += \
+    ../contractionhierarchy.h \
+    ../delaunay.h \
+    ../determinant.h \
+    ../dispatcher.h \
+    ../failover.h \
+    ../hilbert.h \
+    ../kpi.h \
+    ../polygon.h \
+    ../roomgrid.h \
+    ../scenarioloader.h \
+    ../serveranddrone.h \
+    ../simulationclock.h \
+    ../spatialhash.h \
+    ../trace.h \
+    ../trianglemesh.h \
+    ../vector2d.h \
+    ../world.h \
+    allocationcounter.h \
+    benchmark.h
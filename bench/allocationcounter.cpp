@@ -0,0 +1,104 @@
+#include "allocationcounter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+namespace {
+
+// constant initialized: malloc can be called before the static constructors
+std::atomic<int> counters{0};
+std::atomic<quint64> allocations{0};
+
+inline void countAllocation() {
+    if (counters.load(std::memory_order_relaxed)>0) allocations.fetch_add(1,std::memory_order_relaxed);
+}
+
+} // namespace
+
+#ifdef __GLIBC__
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n,size_t size);
+void *__libc_realloc(void *p,size_t size);
+void *__libc_memalign(size_t alignment,size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *p);
+
+void *malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n,size_t size) {
+    countAllocation();
+    return __libc_calloc(n,size);
+}
+
+void *realloc(void *p,size_t size) {
+    countAllocation();
+    return __libc_realloc(p,size);
+}
+
+void *memalign(size_t alignment,size_t size) {
+    countAllocation();
+    return __libc_memalign(alignment,size);
+}
+
+void *aligned_alloc(size_t alignment,size_t size) {
+    countAllocation();
+    return __libc_memalign(alignment,size);
+}
+
+int posix_memalign(void **p,size_t alignment,size_t size) {
+    // same checks as glibc: a power of two multiple of sizeof(void*)
+    if (alignment%sizeof(void*)!=0 || (alignment&(alignment-1))!=0 || alignment==0) return EINVAL;
+    countAllocation();
+    void *q=__libc_memalign(alignment,size);
+    if (q==nullptr) return ENOMEM;
+    *p=q;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    countAllocation();
+    return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size) {
+    countAllocation();
+    return __libc_pvalloc(size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+
+} // extern "C"
+#endif
+
+AllocationCounter::AllocationCounter() {
+    counters.fetch_add(1,std::memory_order_relaxed);
+    start=allocations.load(std::memory_order_relaxed);
+}
+
+AllocationCounter::~AllocationCounter() {
+    counters.fetch_sub(1,std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::count() const {
+    return allocations.load(std::memory_order_relaxed)-start;
+}
+
+void AllocationCounter::restart() {
+    start=allocations.load(std::memory_order_relaxed);
+}
+
+bool AllocationCounter::isAvailable() {
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
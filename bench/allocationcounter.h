@@ -0,0 +1,31 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The AllocationCounter class counts the heap allocations made by all the
+ * threads while it exists: malloc, calloc, realloc and the aligned allocations, so
+ * operator new and the Qt containers too. The benchmarks use it to check the paths
+ * that must not allocate.
+ * The counting is done by wrappers of the glibc allocator, linked in the benchmark
+ * program only: it costs one relaxed load per allocation when no counter exists.
+ * Elsewhere isAvailable() is false.
+ */
+class AllocationCounter {
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+    AllocationCounter(const AllocationCounter&)=delete;
+    AllocationCounter& operator=(const AllocationCounter&)=delete;
+    /**
+     * @brief count gives the allocations since the construction or the last restart().
+     */
+    quint64 count() const;
+    void restart();
+    static bool isAvailable();
+private:
+    quint64 start;
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,699 @@
+#include "benchmark.h"
+#include "allocationcounter.h"
+#include "spatialhash.h"
+#include "delaunay.h"
+#include "trianglemesh.h"
+#include "world.h"
+#include "contractionhierarchy.h"
+#include "serveranddrone.h"
+#include "dispatcher.h"
+#include "hilbert.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#ifdef Q_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Separation queries for growing fleets at constant density:
+ * the time per drone must stay constant if the spatial hash scales linearly.
+ */
+int benchSpatialHash(QTextStream &out) {
+    const double areaPerDrone=400.0; // one drone per 20x20 units
+    const int repeat=10;
+    QRandomGenerator rng(42);
+    out << "drones\tbuild+query (ms)\tns/drone\tneighbours/drone\n";
+    for (int n=1000; n<=256000; n*=2) {
+        const double side=sqrt(n*areaPerDrone);
+        QList<Drone> drones;
+        drones.reserve(n);
+        for (int i=0; i<n; i++) {
+            Drone d;
+            d.position=Vector2D(rng.generateDouble()*side,rng.generateDouble()*side);
+            drones.append(d);
+        }
+        SpatialHash hash;
+        QElapsedTimer timer;
+        timer.start();
+        for (int r=0; r<repeat; r++) {
+            Drone::updateSeparation(drones,hash);
+        }
+        const double ms=timer.nsecsElapsed()*1e-6/repeat;
+        qint64 found=0;
+        for (int i=0; i<n; i+=97) {
+            hash.forEachNeighbour(drones[i].position,separationRadius,[&found](int,double) { found++; });
+        }
+        out << n << "\t" << QString::number(ms,'f',3) << "\t"
+            << QString::number(ms*1e6/n,'f',1) << "\t"
+            << QString::number(double(found)/((n+96)/97),'f',2) << "\n";
+        out.flush();
+    }
+    return 0;
+}
+
+/**
+ * @brief Delaunay triangulation of random sites, then of degenerate sites (grids,
+ * cocircular rings, sites on the convex hull): incremental build against the parallel
+ * divide and conquer (both must give the same triangles, the same diagonals between
+ * cocircular sites), then the divide and conquer alone on very large maps.
+ */
+int benchDelaunay(QTextStream &out) {
+    QRandomGenerator rng(42);
+    auto randomSites=[&rng](int n) {
+        QVector<Vector2D> sites(n);
+        for (auto &p:sites) p=Vector2D(rng.generateDouble()*10000.0,rng.generateDouble()*10000.0);
+        return sites;
+    };
+    int errors=0;
+    auto compare=[&out,&errors](const QString &label,const QVector<Vector2D> &sites) {
+        QList<Server> servers;
+        servers.reserve(sites.size());
+        for (int i=0; i<sites.size(); i++) {
+            Server s;
+            s.id=i;
+            s.position=QPointF(sites[i].x,sites[i].y);
+            servers.append(s);
+        }
+        QElapsedTimer timer;
+        timer.start();
+        TriangleMesh incremental(servers,TriangleMesh::Incremental);
+        const double msInc=timer.nsecsElapsed()*1e-6;
+        timer.restart();
+        TriangleMesh dc(servers,TriangleMesh::DivideAndConquer);
+        const double msDC=timer.nsecsElapsed()*1e-6;
+        const bool same=sameTriangles(*incremental.getTriangles(),*dc.getTriangles());
+        if (!same) errors++;
+        out << label << "\t" << QString::number(msInc,'f',2) << "\t" << QString::number(msDC,'f',2) << "\t"
+            << dc.getTriangles()->size() << "\t" << (same?"yes":"NO") << "\n";
+        out.flush();
+    };
+    out << "sites\tincremental (ms)\tdivide&conquer (ms)\ttriangles\tsame\n";
+    for (int n=250; n<=2000; n*=2) compare(QString::number(n),randomSites(n));
+
+    // every square of a grid has 4 cocircular sites, its sides are on the convex hull
+    QVector<Vector2D> grid;
+    for (int i=0; i<12; i++) {
+        for (int j=0; j<12; j++) grid.append(Vector2D(100+i*50,100+j*50));
+    }
+    compare("grid 12x12",grid);
+    // only the corners on the convex hull, the grid lines cross its diagonals
+    QVector<Vector2D> framed={Vector2D(0,0),Vector2D(1000,0),Vector2D(1000,1000),Vector2D(0,1000)};
+    for (int i=1; i<10; i++) {
+        for (int j=1; j<10; j++) framed.append(Vector2D(i*100,j*100));
+    }
+    compare("framed grid 9x9",framed);
+    // 12 integer sites on each of 4 concentric circles (3-4-5 triangles)
+    const int ring[12][2]={{0,5},{3,4},{4,3},{5,0},{4,-3},{3,-4},{0,-5},{-3,-4},{-4,-3},{-5,0},{-4,3},{-3,4}};
+    QVector<Vector2D> rings;
+    for (int r=1; r<=4; r++) {
+        for (auto &p:ring) rings.append(Vector2D(500+40*r*p[0],500+40*r*p[1]));
+    }
+    compare("cocircular rings",rings);
+
+    for (int n=10000; n<=1000000; n*=10) {
+        const QVector<Vector2D> sites=randomSites(n);
+        QElapsedTimer timer;
+        timer.start();
+        const QVector<Triangle> tris=delaunayDivideAndConquer(sites);
+        out << n << "\t-\t" << QString::number(timer.nsecsElapsed()*1e-6,'f',2) << "\t"
+            << tris.size() << "\t-\n";
+        out.flush();
+    }
+    return errors?1:0;
+}
+
+/**
+ * @brief fills a world with n random servers linked by the edges of their
+ * Delaunay triangulation (the neighbours of the Voronoi map).
+ * @param hilbert servers and triangles sorted along a Hilbert curve, as World::spatialOrder
+ */
+void randomGraph(World &world,int n,QRandomGenerator &rng,bool hilbert=false) {
+    for (int i=0; i<n; i++) {
+        const Vector2D site(rng.generateDouble()*10000.0,rng.generateDouble()*10000.0);
+        Server s;
+        s.id=i;
+        s.position=QPointF(site.x,site.y);
+        world.servers.append(s);
+    }
+    if (hilbert) sortServersAlongHilbert(world.servers,world.drones);
+    QVector<Vector2D> sites(n);
+    QHash<QPair<float,float>,int> index;
+    for (int i=0; i<n; i++) {
+        sites[i]=Vector2D(world.servers[i].position.x(),world.servers[i].position.y());
+        index.insert({sites[i].x,sites[i].y},i);
+    }
+    QVector<Triangle> triangles=delaunayDivideAndConquer(sites);
+    if (hilbert) sortTrianglesAlongHilbert(triangles);
+    QSet<QPair<int,int>> edges;
+    for (const Triangle &t:triangles) {
+        for (int k=0; k<3; k++) {
+            const int a=index.value({t[k].x,t[k].y});
+            const int b=index.value({t[(k+1)%3].x,t[(k+1)%3].y});
+            if (edges.contains({qMin(a,b),qMax(a,b)})) continue;
+            edges.insert({qMin(a,b),qMax(a,b)});
+            Link *link=new Link(&world.servers[a],&world.servers[b],{t[k],t[(k+1)%3]});
+            world.links.append(link);
+            world.servers[a].links.append(link);
+            world.servers[b].links.append(link);
+        }
+    }
+}
+
+/**
+ * @brief Floyd-Warshall routing table against the contraction hierarchy:
+ * preprocessing time, query time and exactness of distances and first hops.
+ */
+int benchRouting(QTextStream &out) {
+    const int nQueries=10000;
+    QRandomGenerator rng(42);
+    int errors=0;
+    out << "servers\tfloyd (ms)\tCH build (ms)\tshortcuts\tCH query (us)\twrong routes\n";
+    for (int n:{250,500,1000,2000,10000,100000}) {
+        World world;
+        randomGraph(world,n,rng);
+        const bool withTable=n<=2000;
+        QElapsedTimer timer;
+        double msFloyd=-1;
+        if (withTable) {
+            timer.start();
+            world.fillDistanceArray();
+            msFloyd=timer.nsecsElapsed()*1e-6;
+        }
+        timer.start();
+        world.buildHierarchy();
+        const double msBuild=timer.nsecsElapsed()*1e-6;
+        const ContractionHierarchy &ch=*world.router;
+
+        QVector<QPair<int,int>> queries(nQueries);
+        for (auto &q:queries) q={int(rng.bounded(n)),int(rng.bounded(n))};
+        QVector<QPair<Link*,qreal>> routes(nQueries);
+        timer.start();
+        for (int i=0; i<nQueries; i++) routes[i]=ch.route(queries[i].first,queries[i].second);
+        const double usQuery=timer.nsecsElapsed()*1e-3/nQueries;
+
+        int wrong=0;
+        if (withTable) {
+            for (int i=0; i<nQueries; i++) {
+                const int a=queries[i].first,b=queries[i].second;
+                const qreal d=world.servers[a].bestDistance[b].second;
+                if (qAbs(routes[i].second-d)>1e-9*(1.0+d)) {
+                    wrong++;
+                } else if (a!=b) {
+                    // the first hop must start a shortest path
+                    Link *l=routes[i].first;
+                    const int next=(l==nullptr)?-1:l->getOther(&world.servers[a])->id;
+                    if (next<0 || qAbs(l->getDistance()+world.servers[next].bestDistance[b].second-d)>1e-9*(1.0+d)) wrong++;
+                }
+            }
+            errors+=wrong;
+        }
+        out << n << "\t" << (withTable?QString::number(msFloyd,'f',1):QString("-")) << "\t"
+            << QString::number(msBuild,'f',1) << "\t" << ch.getShortcutCount() << "\t"
+            << QString::number(usQuery,'f',2) << "\t" << (withTable?QString::number(wrong):QString("-")) << "\n";
+        out.flush();
+    }
+    return errors?1:0;
+}
+
+/**
+ * @brief Assignment throughput of the dispatcher: 10^5 missions given to fleets
+ * of idle drones spread on random servers, with the routing table costs and with
+ * the straight line costs of the maps routed by a hierarchy.
+ * Fails if less than 10^5 missions are assigned per second.
+ */
+int benchDispatch(QTextStream &out) {
+    const int nMissions=100000;
+    const double minRate=1e5;
+    QRandomGenerator rng(42);
+    int errors=0;
+    out << "servers\tdrones\tcosts\tmissions/s\tmean pickup distance\n";
+    for (int n:{500,100000}) {
+        World world;
+        randomGraph(world,n,rng);
+        const bool withTable=n<=2000;
+        if (withTable) world.fillDistanceArray();
+        for (int nDrones:{1000,10000}) {
+            QList<Drone> drones(nDrones);
+            Dispatcher dispatcher;
+            dispatcher.reset(&drones,&world.servers,&world.distanceArray);
+            dispatcher.setBudget(std::numeric_limits<qint64>::max());
+            dispatcher.generate(nMissions,0,rng);
+            QVector<QPair<int,int>> idle(nDrones);
+            QVector<QPair<int,Mission>> assignments;
+            QElapsedTimer timer;
+            qint64 ns=0;
+            double pickup=0;
+            while (dispatcher.getPendingCount()>0) {
+                // the whole fleet is idle again, somewhere else
+                for (int i=0; i<nDrones; i++) idle[i]={i,int(rng.bounded(n))};
+                timer.start();
+                dispatcher.assign(0,idle,assignments);
+                ns+=timer.nsecsElapsed();
+                for (auto &a:assignments) {
+                    const int from=idle[a.first].second,to=a.second.pickup;
+                    const QPointF d=world.servers[from].position-world.servers[to].position;
+                    pickup+=withTable?world.distanceArray[from][to]:sqrt(d.x()*d.x()+d.y()*d.y());
+                }
+            }
+            const double rate=nMissions*1e9/ns;
+            if (rate<minRate) errors++;
+            out << n << "\t" << nDrones << "\t" << (withTable?"table":"straight line") << "\t"
+                << QString::number(rate,'f',0) << "\t" << QString::number(pickup/nMissions,'f',1) << "\n";
+            out.flush();
+        }
+    }
+    return errors?1:0;
+}
+
+/**
+ * @brief The CacheMisses class counts the last level cache misses of the process
+ * between start() and stop(), if the kernel gives access to the hardware counters.
+ */
+class CacheMisses {
+public:
+    CacheMisses() {
+#ifdef Q_OS_LINUX
+        perf_event_attr attr{};
+        attr.type=PERF_TYPE_HARDWARE;
+        attr.size=sizeof(attr);
+        attr.config=PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled=1;
+        attr.exclude_kernel=1;
+        attr.exclude_hv=1;
+        fd=int(syscall(__NR_perf_event_open,&attr,0,-1,-1,0));
+#endif
+    }
+    ~CacheMisses() {
+#ifdef Q_OS_LINUX
+        if (fd>=0) close(fd);
+#endif
+    }
+    void start() {
+#ifdef Q_OS_LINUX
+        if (fd<0) return;
+        ioctl(fd,PERF_EVENT_IOC_RESET,0);
+        ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+#endif
+    }
+    /**
+     * @return misses since start(), -1 if not available.
+     */
+    qint64 stop() {
+#ifdef Q_OS_LINUX
+        if (fd<0) return -1;
+        ioctl(fd,PERF_EVENT_IOC_DISABLE,0);
+        qint64 count=0;
+        if (read(fd,&count,sizeof(count))!=sizeof(count)) return -1;
+        return count;
+#else
+        return -1;
+#endif
+    }
+private:
+    int fd=-1;
+};
+
+QString missesText(qint64 misses,int n) {
+    return misses<0?QString("-"):QString::number(double(misses)/n,'f',2);
+}
+
+/**
+ * @brief Memory order of the data against the Hilbert order, on large maps:
+ * neighbour sweep over the links of the servers, reading of the triangles around
+ * each server and separation of a shuffled fleet, with the cache misses per item
+ * when the hardware counters are available.
+ */
+int benchHilbert(QTextStream &out) {
+    const int nServers=200000;
+    const int nDrones=200000;
+    const int repeat=10;
+    CacheMisses counter;
+    QElapsedTimer timer;
+    out << "case\torder\ttime (ms)\tmisses/item\tmean id gap\n";
+    for (bool hilbert:{false,true}) {
+        QRandomGenerator rng(42);
+        World world;
+        randomGraph(world,nServers,rng,hilbert);
+        // neighbour sweep: each server reads the positions of its neighbours
+        double sum=0,gap=0;
+        int nLinks=0;
+        timer.start();
+        counter.start();
+        for (int r=0; r<repeat; r++) {
+            for (const Server &s:world.servers) {
+                for (Link *l:s.links) {
+                    const QPointF d=l->getOther(&s)->position-s.position;
+                    sum+=d.x()*d.x()+d.y()*d.y();
+                }
+            }
+        }
+        const qint64 misses=counter.stop();
+        const double ms=timer.nsecsElapsed()*1e-6;
+        for (const Server &s:world.servers) {
+            for (Link *l:s.links) {
+                gap+=qAbs(l->getOther(&s)->id-s.id);
+                nLinks++;
+            }
+        }
+        out << "links\t" << (hilbert?"hilbert":"file") << "\t" << QString::number(ms,'f',1) << "\t"
+            << missesText(misses,nLinks*repeat) << "\t" << QString::number(gap/qMax(nLinks,1),'f',0) << "\n";
+        out.flush();
+        if (sum<0) return 1; // keeps the sweep
+    }
+
+    {
+        // triangles around each server, found by the index of their first vertex,
+        // in the order of creation by the mesh builder (sites in file order), then sorted
+        QRandomGenerator rng(42);
+        QVector<Vector2D> sites(nServers);
+        for (auto &p:sites) p=Vector2D(rng.generateDouble()*10000.0,rng.generateDouble()*10000.0);
+        QVector<Triangle> triangles=delaunayDivideAndConquer(sites);
+        for (bool hilbert:{false,true}) {
+            if (hilbert) sortTrianglesAlongHilbert(triangles);
+            QVector<QPair<quint32,int>> keys(triangles.size());
+            HilbertCurve curve(QRectF(0,0,10000.0,10000.0));
+            for (int i=0; i<triangles.size(); i++) keys[i]={curve.index(triangles[i][0].x,triangles[i][0].y),i};
+            std::sort(keys.begin(),keys.end());
+            double area=0;
+            timer.start();
+            counter.start();
+            for (int r=0; r<repeat; r++) {
+                for (auto &k:keys) {
+                    const Triangle &t=triangles[k.second];
+                    area+=(t[1].x-t[0].x)*(t[2].y-t[0].y)-(t[2].x-t[0].x)*(t[1].y-t[0].y);
+                }
+            }
+            const qint64 misses=counter.stop();
+            out << "triangles\t" << (hilbert?"hilbert":"mesh") << "\t" << QString::number(timer.nsecsElapsed()*1e-6,'f',1)
+                << "\t" << missesText(misses,triangles.size()*repeat) << "\t-\n";
+            out.flush();
+            if (area<0) return 1;
+        }
+    }
+
+    {
+        // separation of a fleet in random order, at one drone per 20x20 units
+        QRandomGenerator rng(42);
+        const double side=sqrt(nDrones*400.0);
+        QList<Drone> drones;
+        drones.reserve(nDrones);
+        for (int i=0; i<nDrones; i++) {
+            Drone d;
+            d.position=Vector2D(rng.generateDouble()*side,rng.generateDouble()*side);
+            drones.append(d);
+        }
+        for (bool hilbert:{false,true}) {
+            SpatialHash hash;
+            hash.setHilbertOrder(hilbert);
+            Drone::updateSeparation(drones,hash); // first sort of the order
+            timer.start();
+            counter.start();
+            for (int r=0; r<repeat; r++) Drone::updateSeparation(drones,hash);
+            const qint64 misses=counter.stop();
+            out << "separation\t" << (hilbert?"hilbert":"file") << "\t" << QString::number(timer.nsecsElapsed()*1e-6,'f',1)
+                << "\t" << missesText(misses,nDrones*repeat) << "\t-\n";
+            out.flush();
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Heap allocations and time of the Voronoi map and of the links, then the
+ * edge comparisons of the links made on copied pairs (getEdge) and on edge views.
+ * The copied pairs and the views both stay on the stack: the views save time, not
+ * allocations, so the counts of the two stages are only reported, they are not
+ * compared with a former path. Fails if the views allocate or find other edges.
+ */
+int benchGeometry(QTextStream &out) {
+    QRandomGenerator rng(42);
+    if (!AllocationCounter::isAvailable()) out << "allocations are not counted on this platform\n";
+    out << "servers\tVoronoi (ms)\tallocs/server\tlinks (ms)\tallocs/server\tpair edges (ms)\tallocs\tedge views (ms)\tallocs\n";
+    for (int n:{100,200,400,800}) {
+        World world;
+        world.windowOrigin=QPoint(0,0);
+        world.windowSize=QSize(10000,10000);
+        for (int i=0; i<n; i++) {
+            const Vector2D site(rng.generateDouble()*10000.0,rng.generateDouble()*10000.0);
+            Server s;
+            s.id=i;
+            s.position=QPointF(site.x,site.y);
+            world.servers.append(s);
+        }
+        QElapsedTimer timer;
+        AllocationCounter allocations;
+        timer.start();
+        world.createVoronoiMap();
+        const double msVoronoi=timer.nsecsElapsed()*1e-6;
+        const quint64 voronoiAllocs=allocations.count();
+        allocations.restart();
+        timer.start();
+        world.createServersLinks();
+        const double msLinks=timer.nsecsElapsed()*1e-6;
+        const quint64 linkAllocs=allocations.count();
+
+        int pairs=0,views=0;
+        allocations.restart();
+        timer.start();
+        for (int i=0; i<n; i++) {
+            for (int j=i+1; j<n; j++) {
+                const Polygon &a=world.servers[i].area,&b=world.servers[j].area;
+                for (int ea=0; ea<a.nbVertices(); ea++) {
+                    const QPair<Vector2D,Vector2D> eA=a.getEdge(ea);
+                    for (int eb=0; eb<b.nbVertices(); eb++) {
+                        const QPair<Vector2D,Vector2D> eB=b.getEdge(eb);
+                        if (eA.first==eB.second && eA.second==eB.first) pairs++;
+                    }
+                }
+            }
+        }
+        const double msPairs=timer.nsecsElapsed()*1e-6;
+        const quint64 pairAllocs=allocations.count();
+        allocations.restart();
+        timer.start();
+        for (int i=0; i<n; i++) {
+            for (int j=i+1; j<n; j++) {
+                for (const EdgeView eA:world.servers[i].area.edges()) {
+                    for (const EdgeView eB:world.servers[j].area.edges()) {
+                        if (eA.first==eB.second && eA.second==eB.first) views++;
+                    }
+                }
+            }
+        }
+        const double msViews=timer.nsecsElapsed()*1e-6;
+        const quint64 viewAllocs=allocations.count();
+        out << n << "\t" << QString::number(msVoronoi,'f',1) << "\t" << QString::number(double(voronoiAllocs)/n,'f',1)
+            << "\t" << QString::number(msLinks,'f',1) << "\t" << QString::number(double(linkAllocs)/n,'f',1)
+            << "\t" << QString::number(msPairs,'f',1) << "\t" << pairAllocs
+            << "\t" << QString::number(msViews,'f',1) << "\t" << viewAllocs << "\n";
+        out.flush();
+        if (pairs!=views || viewAllocs>0) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief writes a scenario of n random servers in a 1000 x 1000 window and n/2 drones
+ * flying to random servers, in the format read by ScenarioLoader.
+ */
+bool writeScenario(const QString &path,int n,QRandomGenerator &rng) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QTextStream json(&file);
+    json << "{\"window\":{\"origine\":\"0,0\",\"size\":\"1000,1000\"},\n\"servers\":[";
+    for (int i=0; i<n; i++) {
+        json << (i?",\n":"\n") << "{\"name\":\"server" << i << "\",\"position\":\""
+             << QString::number(rng.generateDouble()*1000.0,'f',3) << "," << QString::number(rng.generateDouble()*1000.0,'f',3)
+             << "\",\"color\":\"#" << QString::number(rng.bounded(0x1000000),16).rightJustified(6,'0') << "\"}";
+    }
+    json << "],\n\"drones\":[";
+    for (int i=0; i<n/2; i++) {
+        json << (i?",\n":"\n") << "{\"name\":\"drone" << i << "\",\"position\":\""
+             << QString::number(rng.generateDouble()*1000.0,'f',3) << "," << QString::number(rng.generateDouble()*1000.0,'f',3)
+             << "\",\"target\":\"server" << rng.bounded(n) << "\"}";
+    }
+    json << "]}\n";
+    return json.status()==QTextStream::Ok;
+}
+
+/**
+ * @brief gives the most allocations of a dispatch of n indices to the pool by
+ * QtConcurrent::blockingMap, the way the parallel stages of the world are dispatched.
+ */
+quint64 dispatchAllocations(int n) {
+    QVector<int> indices(n);
+    std::iota(indices.begin(),indices.end(),0);
+    QVector<double> sink(n);
+    quint64 worst=0;
+    for (int r=0; r<16; r++) {
+        AllocationCounter counter;
+        // about a microsecond per index: all the threads of the pool take part
+        QtConcurrent::blockingMap(indices.cbegin(),indices.cend(),[&sink](int i) {
+            double x=i;
+            for (int k=0; k<200; k++) x=std::sqrt(x+k);
+            sink[i]=x;
+        });
+        worst=qMax(worst,counter.count());
+    }
+    return worst;
+}
+
+/**
+ * @brief Heap allocations of the reloads of a scenario and of the rebuilds of its world.
+ * The scenario is reloaded the way MainWindow::loadJson() does, by World::build() on
+ * the default settings, cache included (QStandardPaths test mode). Its fixed cost,
+ * opening and mapping the scenario and the cache files, is measured on a scenario of
+ * 8 servers: a same-size reload of a larger map must not allocate more.
+ * Then each stage of the rebuild, and rebuild() itself, must not allocate, except
+ * the dispatches of the parallel stages of the maps of 256 servers or more (the cells
+ * of the Voronoi map and the backup routes), whose cost is measured by a dispatch
+ * of the same size.
+ */
+int benchRebuild(QTextStream &out) {
+    const int repeat=3;
+    const int nStages=5;
+    const char *stageNames[nStages]={"Voronoi map","links","routing","backup routes","room grid"};
+    if (!AllocationCounter::isAvailable()) {
+        out << "allocations are not counted on this platform\n";
+        return 0;
+    }
+    QStandardPaths::setTestModeEnabled(true);
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out << "no temporary folder\n";
+        return 1;
+    }
+    QRandomGenerator rng(42);
+    // worst reload of a scenario after a first build; the first reload is not
+    // counted, it fills the lists that the loader takes back from the world
+    auto reloads=[&](World &world,const QString &path,double &ms) {
+        quint64 worst=0;
+        QElapsedTimer timer;
+        ms=0;
+        if (!world.build(path,QPoint(0,0),QSize(1000,1000))) return std::numeric_limits<quint64>::max();
+        for (int r=0; r<repeat; r++) {
+            AllocationCounter counter;
+            timer.start();
+            if (!world.build(path,QPoint(0,0),QSize(1000,1000))) return std::numeric_limits<quint64>::max();
+            ms+=timer.nsecsElapsed()*1e-6;
+            worst=qMax(worst,counter.count());
+        }
+        ms/=repeat;
+        return worst;
+    };
+
+    const QString smallPath=dir.filePath("scenario8.json");
+    World small;
+    double ms;
+    if (!writeScenario(smallPath,8,rng) || !small.build(smallPath,QPoint(0,0),QSize(1000,1000))) {
+        out << "cannot build the scenario " << smallPath << "\n";
+        return 1;
+    }
+    const quint64 fileAllocations=reloads(small,smallPath,ms);
+    out << "reload of 8 servers (files and cache)\t" << fileAllocations << " allocations\t"
+        << QString::number(ms,'f',1) << " ms\n";
+
+    int errors=0;
+    out << "servers\tstage\tfirst build allocs\trebuild allocs\tallowed\trebuild (ms)\n";
+    for (int n:{200,800,5000}) {
+        const QString path=dir.filePath(QString("scenario%1.json").arg(n));
+        World world;
+        if (!writeScenario(path,n,rng)) {
+            out << "cannot write " << path << "\n";
+            return 1;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        AllocationCounter firstBuild;
+        if (!world.build(path,QPoint(0,0),QSize(1000,1000))) {
+            out << "cannot build " << path << ": " << world.errorString() << "\n";
+            return 1;
+        }
+        const quint64 firstCount=firstBuild.count();
+        const double firstMs=timer.nsecsElapsed()*1e-6;
+        const quint64 reloadCount=reloads(world,path,ms);
+        if (reloadCount>fileAllocations) errors++;
+        out << n << "\treload (build)\t" << firstCount << "\t" << reloadCount << "\t" << fileAllocations << "\t"
+            << QString::number(ms,'f',1) << " (first " << QString::number(firstMs,'f',1) << ")\n";
+
+        // routing table below 1000 servers, as World::build(); the raster of 250 x 250
+        // cells of the room grid is not dispatched
+        const bool table=n<1000;
+        const bool parallel=n>=256;
+        const quint64 dispatch=parallel?dispatchAllocations(n):0;
+        const int dispatches[nStages]={parallel?1:0,0,0,parallel && table?1:0,0};
+        quint64 first[nStages],worst[nStages]={};
+        double stageMs[nStages]={};
+        for (int r=0; r<=repeat; r++) {
+            AllocationCounter counter;
+            for (int stage=0; stage<nStages; stage++) {
+                counter.restart();
+                timer.start();
+                switch (stage) {
+                case 0: world.createVoronoiMap(); break;
+                case 1: world.createServersLinks(); break;
+                case 2: if (table) world.fillDistanceArray(); else world.buildHierarchy(); break;
+                case 3: if (table) world.computeBackupLinks(); break;
+                default: world.createRoomGrid(QString()); break;
+                }
+                const quint64 count=counter.count();
+                if (r==0) {
+                    first[stage]=count;
+                } else {
+                    worst[stage]=qMax(worst[stage],count);
+                    stageMs[stage]+=timer.nsecsElapsed()*1e-6;
+                }
+            }
+        }
+        int totalDispatches=0;
+        for (int stage=0; stage<nStages; stage++) {
+            const quint64 allowed=dispatches[stage]*dispatch;
+            totalDispatches+=dispatches[stage];
+            if (worst[stage]>allowed) errors++;
+            out << n << "\t" << stageNames[stage] << "\t" << first[stage] << "\t" << worst[stage] << "\t"
+                << allowed << "\t" << QString::number(stageMs[stage]/repeat,'f',1) << "\n";
+        }
+        // whole rebuild, with the progress reports and the logs
+        AllocationCounter counter;
+        timer.start();
+        world.rebuild();
+        const quint64 count=counter.count();
+        if (count>totalDispatches*dispatch) errors++;
+        out << n << "\trebuild()\t-\t" << count << "\t" << totalDispatches*dispatch
+            << "\t" << QString::number(timer.nsecsElapsed()*1e-6,'f',1) << "\n";
+        out.flush();
+    }
+    if (errors) out << errors << " reloads or rebuilds allocated more than allowed\n";
+    return errors?1:0;
+}
+
+} // namespace
+
+int runBenchmark(const QString &name) {
+    QTextStream out(stdout);
+    if (name=="spatialhash") return benchSpatialHash(out);
+    if (name=="delaunay") return benchDelaunay(out);
+    if (name=="routing") return benchRouting(out);
+    if (name=="dispatch") return benchDispatch(out);
+    if (name=="hilbert") return benchHilbert(out);
+    if (name=="geometry") return benchGeometry(out);
+    if (name=="rebuild") return benchRebuild(out);
+    out << "available benchmarks: spatialhash, delaunay, routing, dispatch, hilbert, geometry, rebuild\n";
+    return name.isEmpty()?0:1;
+}
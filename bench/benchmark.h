@@ -0,0 +1,14 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+
+/**
+ * @brief runBenchmark executes a performance measurement from the command line
+ * (DronesAndRoomsBench <name>) and prints the results on the standard output.
+ * @param name name of the benchmark, an empty name lists the available ones
+ * @return the exit code of the program.
+ */
+int runBenchmark(const QString &name);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,14 @@
+#include "benchmark.h"
+
+#include <QCoreApplication>
+
+/**
+ * DronesAndRoomsBench <name>: performance measurements of the model,
+ * without name the available benchmarks are listed.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args = a.arguments();
+    return runBenchmark(args.size() > 1 ? args[1] : QString());
+}
@@ -1,5 +1,16 @@
 #include "canvas.h"
 #include <QPainter>
+#include <cmath>
+#include <trace.h>
+
+const int atlasFrames=72; ///< number of orientations in the drone atlas (5° steps)
+const int atlasColumns=12;
+const int maxAtlasIconSize=128; ///< bigger icons are scaled up from the atlas
+const int labelMinIconSize=24; ///< drone labels are hidden under this icon size (pixels)
+const int maxDroneLabels=500; ///< drone labels are hidden if more drones are visible
+const qreal labelMinScale=0.35; ///< server labels are hidden under this pixel/unit ratio
+const qreal minZoom=0.25;
+const qreal maxZoom=64.0;
 
 Canvas::Canvas(QWidget *parent) : QWidget{parent} {
     setMouseTracking(true);
@@ -10,10 +21,25 @@ Canvas::Canvas(QWidget *parent) : QWidget{parent} {
     droneImg.load("../../../media/drone.png");
 }
 
-void Canvas::paintEvent(QPaintEvent *) {
-    const QRect rect(-droneIconSize/2,-droneIconSize/2,droneIconSize,droneIconSize);
+QTransform Canvas::viewTransform() const {
+    QTransform t;
+    t.scale(windowScale.width()*zoom,windowScale.height()*zoom);
+    t.translate(-windowOrigin.x()-pan.x(),-windowOrigin.y()-pan.y());
+    return t;
+}
 
-    QPainter painter(this);
+QRectF Canvas::visibleArea() const {
+    return viewTransform().inverted().mapRect(QRectF(rect()));
+}
+
+void Canvas::resetView() {
+    zoom=1.0;
+    pan=QPointF(0,0);
+    invalidateStaticLayer();
+    update();
+}
+
+void Canvas::drawStaticLayer(QPainter &painter) {
     QBrush whiteBrush(Qt::SolidPattern);
     QPen serverPen(Qt::black);
     serverPen.setWidth(3);
@@ -28,13 +54,23 @@ void Canvas::paintEvent(QPaintEvent *) {
     painter.fillRect(0,0,width(),height(),whiteBrush);
 
     painter.save(); // drawing area coordinate system
-    painter.scale(windowScale.width(),windowScale.height());
-    painter.translate(-windowOrigin);
-
+    painter.setTransform(viewTransform());
+    const QRectF visible=visibleArea();
+    const bool showLabels=windowScale.width()*zoom>=labelMinScale;
 
     // drawing the servers
     QRect r;
     for (auto &s:servers) {
+        int tw=fm.horizontalAdvance(s.name)+2;
+        int th=fm.height()+2;
+        // skip the servers whose cell and icon are out of the viewport
+        QRectF bounds(s.position.x()-qMax(25,tw/2),s.position.y()-25-th,qMax(50,tw),50+th);
+        if (s.area.nbVertices()>0) {
+            auto box=s.area.getBoundingBox();
+            bounds|=QRectF(QPointF(box.first.x,box.first.y),QPointF(box.second.x,box.second.y));
+        }
+        if (!bounds.intersects(visible)) continue;
+
         painter.setBrush(s.color);
         s.area.draw(painter);
 
@@ -47,11 +83,10 @@ void Canvas::paintEvent(QPaintEvent *) {
         painter.drawEllipse(-15,-15,30,30);
         painter.setBrush(Qt::black);
         painter.drawEllipse(-5,-5,10,10);
-        int tw=fm.horizontalAdvance(s.name)+2;
-        int th=fm.height()+2;
-        r.setRect(-tw/2,-25-th,tw,th);
-        painter.drawText(r,s.name);
-
+        if (showLabels) {
+            r.setRect(-tw/2,-25-th,tw,th);
+            painter.drawText(r,s.name);
+        }
         painter.restore();
     }
 
@@ -62,25 +97,150 @@ void Canvas::paintEvent(QPaintEvent *) {
             l->draw(painter);
         }
     }
+    painter.restore();
+}
 
-    // drawing the drones
-    painter.setPen(Qt::white);
-    for (auto &d:drones) {
+void Canvas::buildDroneAtlas(int iconPx) {
+    atlasIconPx=iconPx;
+    atlasCell=int(std::ceil(iconPx*M_SQRT2))+2; // room for the rotated corners
+    droneAtlas=QPixmap(atlasCell*atlasColumns,atlasCell*((atlasFrames+atlasColumns-1)/atlasColumns));
+    droneAtlas.fill(Qt::transparent);
+
+    QPainter painter(&droneAtlas);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    const QRectF iconRect(-iconPx/2.0,-iconPx/2.0,iconPx,iconPx);
+    for (int k=0; k<atlasFrames; k++) {
         painter.save();
-        // place and orient the drone
-        painter.translate(d.position.x,d.position.y);
-        painter.rotate(d.azimut);
-        painter.drawImage(rect,droneImg);
+        painter.translate((k%atlasColumns+0.5)*atlasCell,(k/atlasColumns+0.5)*atlasCell);
+        painter.rotate(k*360.0/atlasFrames);
+        painter.drawImage(iconRect,droneImg);
+        painter.restore();
+    }
+}
 
-        int tw=fm.horizontalAdvance(d.name)+2;
-        int th=fm.height()+2;
-        r.setRect(-tw/2,-15,tw,th);
-        painter.drawText(r,d.name);
+void Canvas::paintEvent(QPaintEvent *) {
+    TRACE_SCOPE("paintEvent");
+    // the static map is only drawn again when the view or the scenario change
+    const qreal dpr=devicePixelRatioF();
+    const QSize pixSize=size()*dpr;
+    if (!staticLayerValid || staticLayer.size()!=pixSize) {
+        TRACE_SCOPE("staticLayer");
+        staticLayer=QPixmap(pixSize);
+        staticLayer.setDevicePixelRatio(dpr);
+        QPainter cachePainter(&staticLayer);
+        drawStaticLayer(cachePainter);
+        staticLayerValid=true;
+        layerShift=QPointF();
+    }
 
-        painter.restore();
+    QPainter painter(this);
+    painter.drawPixmap(layerShift,staticLayer);
+    frameCount++;
+
+    // drawing the visible drones in one batch from the pre-rotated atlas
+    const QTransform view=viewTransform();
+    const qreal pixelScale=windowScale.width()*zoom;
+    const QRectF visible=visibleArea().adjusted(-droneIconSize,-droneIconSize,droneIconSize,droneIconSize);
+    const int iconPx=qMax(4,int(droneIconSize*pixelScale+0.5));
+    const int atlasPx=qMin(iconPx,maxAtlasIconSize);
+    if (atlasPx!=atlasIconPx) buildDroneAtlas(atlasPx);
+    const qreal fragScale=qreal(iconPx)/atlasPx;
+
+    // drones are read from the telemetry, never from the simulation
+    updateFrames();
+    const QVector<DroneSample> &current=currentFrame.drones;
+    const bool interpolate=previousFrame.number+1==currentFrame.number &&
+                           previousFrame.drones.size()==current.size();
+    auto dronePosition=[&](int i) {
+        const DroneSample &c=current[i];
+        if (!interpolate) return Vector2D(c.x,c.y);
+        const DroneSample &p=previousFrame.drones[i];
+        return Vector2D(p.x+interpolation*(c.x-p.x),p.y+interpolation*(c.y-p.y));
+    };
+    auto droneAzimut=[&](int i) {
+        const DroneSample &c=current[i];
+        if (!interpolate) return qreal(c.azimut);
+        // shortest rotation between the two states
+        const qreal a0=previousFrame.drones[i].azimut;
+        qreal delta=c.azimut-a0;
+        while (delta>180.0) delta-=360.0;
+        while (delta<-180.0) delta+=360.0;
+        return a0+interpolation*delta;
+    };
+
+    fragments.clear();
+    visibleDrones.clear();
+    for (int i=0; i<current.size(); i++) {
+        const Vector2D pos=dronePosition(i);
+        if (!visible.contains(pos.x,pos.y)) continue;
+        int k=int(std::lround(droneAzimut(i)*atlasFrames/360.0))%atlasFrames;
+        if (k<0) k+=atlasFrames;
+        const QRectF source((k%atlasColumns)*atlasCell,(k/atlasColumns)*atlasCell,atlasCell,atlasCell);
+        fragments.append(QPainter::PixmapFragment::create(view.map(QPointF(pos.x,pos.y)),source,fragScale,fragScale));
+        visibleDrones.append(i);
     }
-    painter.restore();
+    painter.drawPixmapFragments(fragments.constData(),fragments.size(),droneAtlas);
+
+    // level of detail: names only when they can be read
+    if (iconPx>=labelMinIconSize && visibleDrones.size()<=maxDroneLabels) {
+        QFont myFont("Arial",14,QFont::Black);
+        QFontMetrics fm(myFont);
+        painter.setFont(myFont);
+        painter.setPen(Qt::white);
+        painter.setTransform(view);
+        QRectF r;
+        for (int i:visibleDrones) {
+            if (i>=drones.size()) break;
+            const QString &name=drones[i].name; // static data of the scenario
+            const Vector2D pos=dronePosition(i);
+            int tw=fm.horizontalAdvance(name)+2;
+            int th=fm.height()+2;
+            r.setRect(pos.x-tw/2,pos.y-15,tw,th);
+            painter.drawText(r,name);
+        }
+    }
+
+    if (Trace::isEnabled()) {
+        painter.resetTransform();
+        drawTraceOverlay(painter);
+    }
+}
 
+void Canvas::updateFrames() {
+    if (telemetry==nullptr) return;
+    const quint64 last=telemetry->getFrameCount();
+    if (last==currentFrame.number) return;
+    if (last==currentFrame.number+1) {
+        std::swap(previousFrame,currentFrame);
+    } else if (!telemetry->read(last-1,previousFrame)) {
+        previousFrame.number=0;
+    }
+    // overwritten before the copy: the previous state is drawn, read again next time
+    if (!telemetry->read(last,currentFrame)) currentFrame=previousFrame;
+}
+
+void Canvas::drawTraceOverlay(QPainter &painter) {
+    // live durations of the traced stages, in the top left corner
+    auto stages=Trace::lastDurations();
+    QFont font("Courier",10);
+    QFontMetrics fm(font);
+    const int lh=fm.height();
+    int tw=0;
+    QVector<QString> lines;
+    for (auto &stage:stages) {
+        lines.append(QString("%1 %2 ms").arg(QString::fromLatin1(stage.first),-20).arg(stage.second,8,'f',3));
+        tw=qMax(tw,fm.horizontalAdvance(lines.last()));
+    }
+    painter.setFont(font);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0,0,0,160));
+    painter.drawRect(5,5,tw+10,lh*lines.size()+10);
+    painter.setPen(Qt::white);
+    int y=10+fm.ascent();
+    for (auto &line:lines) {
+        painter.drawText(10,y,line);
+        y+=lh;
+    }
 }
 
 void Canvas::resizeEvent(QResizeEvent *event) {
@@ -106,11 +266,44 @@ void Canvas::resizeEvent(QResizeEvent *event) {
 
     windowScale={qreal(width())/windowSize.width(),
                    qreal(height())/windowSize.height()};
+    invalidateStaticLayer();
 }
 
 
 void Canvas::mousePressEvent(QMouseEvent *event) {
+    lastMousePos=event->position();
+    update();
+}
 
-    repaint();
+void Canvas::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton) {
+        // pan: the window point under the mouse follows the cursor
+        const QPointF delta=event->position()-lastMousePos;
+        pan-=QPointF(delta.x()/(windowScale.width()*zoom),delta.y()/(windowScale.height()*zoom));
+        lastMousePos=event->position();
+        // the cached map is moved while dragging, drawn again at the release
+        layerShift+=delta;
+        update();
+    }
+}
+
+void Canvas::mouseReleaseEvent(QMouseEvent *) {
+    if (layerShift.isNull()) return;
+    invalidateStaticLayer();
+    update();
 }
 
+void Canvas::mouseDoubleClickEvent(QMouseEvent *) {
+    resetView();
+}
+
+void Canvas::wheelEvent(QWheelEvent *event) {
+    // zoom around the window point under the cursor
+    const QPointF cursor=event->position();
+    const QPointF fixedPt=viewTransform().inverted().map(cursor);
+    zoom=qBound(minZoom,zoom*std::pow(1.0015,event->angleDelta().y()),maxZoom);
+    pan=fixedPt-QPointF(windowOrigin)-QPointF(cursor.x()/(windowScale.width()*zoom),cursor.y()/(windowScale.height()*zoom));
+    invalidateStaticLayer();
+    update();
+    event->accept();
+}
@@ -4,7 +4,11 @@
 #include <QWidget>
 #include <QMouseEvent>
 #include <QPaintEvent>
+#include <QPixmap>
+#include <QPainter>
+#include <QWheelEvent>
 #include <serveranddrone.h>
+#include <telemetry.h>
 
 class Canvas : public QWidget {
     Q_OBJECT
@@ -19,12 +23,52 @@ public:
         windowOrigin=origin;
         windowSize=size;
         windowScale={qreal(width())/windowSize.width(),qreal(height())/windowSize.height()};
+        resetView();
     }
+    /**
+     * @brief resetView cancels the zoom and the pan, the whole window is visible.
+     */
+    void resetView();
+    /**
+     * @brief viewTransform
+     * @return the transformation from window coordinates to widget pixels (scale, zoom and pan).
+     */
+    QTransform viewTransform() const;
+    /**
+     * @brief visibleArea
+     * @return the part of the window (in window coordinates) currently displayed.
+     */
+    QRectF visibleArea() const;
+    /**
+     * @brief invalidateStaticLayer forces the map (cells, doors, servers, graph)
+     * to be drawn again in the cache at the next paint event.
+     * Must be called when the scenario or the display options change.
+     */
+    void invalidateStaticLayer() { staticLayerValid=false; }
+    /**
+     * @brief setInterpolation sets the position of the next frame between the two last simulation steps.
+     * @param alpha 0 for the previous step, 1 for the last step.
+     */
+    void setInterpolation(qreal alpha) { interpolation=alpha; }
+    /**
+     * @brief setTelemetry sets the ring where the drones drawn are read.
+     * @param ring telemetry published by the simulation
+     */
+    void setTelemetry(const TelemetryRing *ring) { telemetry=ring; }
+    /**
+     * @brief takeFrameCount
+     * @return the number of frames painted since the previous call.
+     */
+    int takeFrameCount() { int n=frameCount; frameCount=0; return n; }
     QPoint getOrigin() { return windowOrigin; }
     QSize getSize() { return windowSize; }
     void paintEvent(QPaintEvent*) override;
     void resizeEvent(QResizeEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
 
     QList<Server> servers;
     QList<Drone> drones;
@@ -33,11 +77,34 @@ public:
 signals:
 
 private:
+    void drawStaticLayer(QPainter &painter);
+    void buildDroneAtlas(int iconPx);
+    void drawTraceOverlay(QPainter &painter);
+    /**
+     * @brief updateFrames reads the two last frames published in the telemetry.
+     */
+    void updateFrames();
+
     QPoint windowOrigin;
     QSize windowSize;
     QSizeF windowScale;
     qreal droneIconSize;
     QImage droneImg; ///< picture representing the drone in the canvas
+    QPixmap staticLayer; ///< cache of the static map at the current scale
+    bool staticLayerValid=false;
+    QPointF layerShift; ///< translation of the cached map since it was drawn, while panning
+    qreal zoom=1.0; ///< zoom factor of the viewport (1 = whole window)
+    QPointF pan; ///< translation of the viewport in window coordinates
+    QPointF lastMousePos; ///< previous mouse position while panning
+    QPixmap droneAtlas; ///< pre-rotated drone pictures at the current icon size
+    int atlasIconPx=0; ///< size in pixels of a drone in the atlas
+    int atlasCell=0; ///< size in pixels of an atlas cell
+    QVector<QPainter::PixmapFragment> fragments; ///< batch of visible drones, reused at each frame
+    QVector<int> visibleDrones; ///< indices of the drones in the batch
+    qreal interpolation=1.0; ///< drones are drawn between previous and current simulation states
+    const TelemetryRing *telemetry=nullptr;
+    TelemetryFrame previousFrame,currentFrame; ///< two last published states of the drones
+    int frameCount=0; ///< painted frames, read by the frame pacing counter
 };
 
 #endif // CANVAS_H
@@ -0,0 +1,337 @@
+#include "contractionhierarchy.h"
+#include "serveranddrone.h"
+#include <QIODevice>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const qreal infinity=std::numeric_limits<qreal>::infinity();
+const int witnessMaxSettled=500; ///< a shortcut is added if no witness is found in this budget
+
+using Entry=std::pair<qreal,int>;
+
+/**
+ * @brief Saved hierarchy: header, rank (nodes), upStart (nodes+1) and upArcs (arcs)
+ * as qint32, then the arcs.
+ */
+struct StoredHeader {
+    quint32 nodes;
+    quint32 arcs;
+};
+
+struct StoredArc {
+    double weight;
+    qint32 node1,node2;
+    qint32 link; ///< index in the links, -1 for a shortcut
+    qint32 child1,child2;
+    qint32 unused;
+};
+
+static_assert(sizeof(int)==sizeof(qint32),"node and arc indices are stored as qint32");
+
+} // namespace
+
+void ContractionHierarchy::Search::reset(int n) {
+    if (dist.size()!=n) {
+        dist.fill(infinity,n);
+        parent.fill(-1,n);
+        touched.clear();
+        queue.clear();
+        return;
+    }
+    for (int u:touched) {
+        dist[u]=infinity;
+        parent[u]=-1;
+    }
+    touched.clear();
+    queue.clear();
+}
+
+void ContractionHierarchy::Search::push(qreal d,int u) {
+    queue.push_back({d,u});
+    std::push_heap(queue.begin(),queue.end(),std::greater<Entry>());
+}
+
+ContractionHierarchy::Search::Entry ContractionHierarchy::Search::pop() {
+    std::pop_heap(queue.begin(),queue.end(),std::greater<Entry>());
+    const Entry e=queue.back();
+    queue.pop_back();
+    return e;
+}
+
+void ContractionHierarchy::build(const QList<Server> &servers,const QList<Link*> &links) {
+    const int n=servers.size();
+    // the arrays of the previous build keep their capacity
+    arcs.clear();
+    shortcutCount=0;
+    adjacency.resize(n);
+    for (auto &list:adjacency) list.clear();
+    contracted.fill(false,n);
+    rank.fill(-1,n);
+    for (Link *l:links) {
+        const int a=l->getNode1()->id;
+        const int b=l->getNode2()->id;
+        if (a==b || a<0 || b<0 || a>=n || b>=n) continue;
+        adjacency[a].append(arcs.size());
+        adjacency[b].append(arcs.size());
+        arcs.append({a,b,l->getDistance(),l,-1,-1});
+    }
+
+    // contraction order: edge difference + contracted neighbours, lazy updates
+    contractedNeighbours.fill(0,n);
+    auto priority=[&](int v) {
+        int degree=0;
+        for (int a:adjacency[v]) {
+            if (!contracted[otherNode(a,v)]) degree++;
+        }
+        return contractNode(v,true)-degree+contractedNeighbours[v];
+    };
+    const auto later=std::greater<std::pair<int,int>>();
+    order.clear();
+    for (int v=0; v<n; v++) {
+        order.push_back({priority(v),v});
+    }
+    std::make_heap(order.begin(),order.end(),later);
+    int next=0;
+    while (!order.empty()) {
+        std::pop_heap(order.begin(),order.end(),later);
+        const int v=order.back().second;
+        order.pop_back();
+        const int p=priority(v);
+        if (!order.empty() && p>order.front().first) {
+            order.push_back({p,v});
+            std::push_heap(order.begin(),order.end(),later);
+            continue;
+        }
+        contractNode(v,false);
+        contracted[v]=true;
+        rank[v]=next++;
+        for (int a:adjacency[v]) {
+            const int u=otherNode(a,v);
+            if (!contracted[u]) contractedNeighbours[u]++;
+        }
+    }
+
+    // upward graph: each arc is stored with its lower ranked node
+    upStart.fill(0,n+1);
+    for (const Arc &arc:arcs) {
+        upStart[(rank[arc.node1]<rank[arc.node2]?arc.node1:arc.node2)+1]++;
+    }
+    for (int u=0; u<n; u++) upStart[u+1]+=upStart[u];
+    upArcs.resize(arcs.size());
+    QVector<int> &fill=contractedNeighbours;
+    std::copy(upStart.cbegin(),upStart.cend()-1,fill.begin());
+    for (int a=0; a<arcs.size(); a++) {
+        const Arc &arc=arcs[a];
+        upArcs[fill[rank[arc.node1]<rank[arc.node2]?arc.node1:arc.node2]++]=a;
+    }
+
+    forward.reset(n);
+    backward.reset(n);
+}
+
+void ContractionHierarchy::clear() {
+    arcs.clear();
+    rank.clear();
+    upStart.clear();
+    upArcs.clear();
+    shortcutCount=0;
+}
+
+void ContractionHierarchy::save(QIODevice &device,const QHash<const Link*,qint32> &linkIndex) const {
+    const StoredHeader header={quint32(rank.size()),quint32(arcs.size())};
+    device.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    device.write(reinterpret_cast<const char*>(rank.constData()),rank.size()*sizeof(qint32));
+    device.write(reinterpret_cast<const char*>(upStart.constData()),upStart.size()*sizeof(qint32));
+    device.write(reinterpret_cast<const char*>(upArcs.constData()),upArcs.size()*sizeof(qint32));
+    for (const Arc &arc:arcs) {
+        const StoredArc stored={arc.weight,arc.node1,arc.node2,
+                                arc.link==nullptr?-1:linkIndex.value(arc.link,-1),arc.child1,arc.child2,0};
+        device.write(reinterpret_cast<const char*>(&stored),sizeof(stored));
+    }
+}
+
+bool ContractionHierarchy::load(const uchar *data,qint64 size,const QList<Link*> &links) {
+    StoredHeader header;
+    if (size<qint64(sizeof(header))) return false;
+    memcpy(&header,data,sizeof(header));
+    const qint64 n=header.nodes;
+    const qint64 m=header.arcs;
+    if (size!=qint64(sizeof(header))+(2*n+1+m)*qint64(sizeof(qint32))+m*qint64(sizeof(StoredArc))) return false;
+    const uchar *p=data+sizeof(header);
+    rank.resize(n);
+    memcpy(rank.data(),p,n*sizeof(qint32));
+    p+=n*sizeof(qint32);
+    upStart.resize(n+1);
+    memcpy(upStart.data(),p,(n+1)*sizeof(qint32));
+    p+=(n+1)*sizeof(qint32);
+    upArcs.resize(m);
+    memcpy(upArcs.data(),p,m*sizeof(qint32));
+    p+=m*sizeof(qint32);
+
+    // indices are checked once here, the queries trust them
+    bool valid=upStart[0]==0 && upStart[n]==m;
+    for (qint64 u=0; u<n && valid; u++) {
+        valid=rank[u]>=0 && rank[u]<n && upStart[u]<=upStart[u+1];
+    }
+    for (qint64 k=0; k<m && valid; k++) {
+        valid=upArcs[k]>=0 && upArcs[k]<m;
+    }
+    arcs.resize(m);
+    shortcutCount=0;
+    for (qint64 a=0; a<m && valid; a++) {
+        StoredArc stored;
+        memcpy(&stored,p+a*sizeof(stored),sizeof(stored));
+        valid=stored.node1>=0 && stored.node1<n && stored.node2>=0 && stored.node2<n;
+        if (stored.link<0) {
+            // the sub-arcs of a shortcut are created before it
+            valid=valid && stored.child1>=0 && stored.child1<a && stored.child2>=0 && stored.child2<a;
+            shortcutCount++;
+        } else {
+            valid=valid && stored.link<links.size();
+        }
+        if (!valid) break;
+        arcs[a]={stored.node1,stored.node2,stored.weight,stored.link<0?nullptr:links[stored.link],
+                 stored.child1,stored.child2};
+    }
+    if (!valid) {
+        clear();
+        return false;
+    }
+    forward.reset(n);
+    backward.reset(n);
+    return true;
+}
+
+/**
+ * For each pair (u,w) of remaining neighbours of v, u-v-w is replaced by a shortcut
+ * if a bounded Dijkstra from u that avoids v finds no path shorter or equal.
+ */
+int ContractionHierarchy::contractNode(int v,bool simulate) {
+    // lightest arc to each remaining neighbour
+    neighbours.clear();
+    for (int a:adjacency[v]) {
+        const int u=otherNode(a,v);
+        if (contracted[u] || u==v) continue;
+        auto it=neighbours.begin();
+        while (it!=neighbours.end() && it->first!=u) it++;
+        if (it==neighbours.end()) neighbours.append({u,a});
+        else if (arcs[a].weight<arcs[it->second].weight) it->second=a;
+    }
+
+    int shortcuts=0;
+    const int n=rank.size();
+    for (int i=0; i+1<neighbours.size(); i++) {
+        const int u=neighbours[i].first;
+        const qreal du=arcs[neighbours[i].second].weight;
+        qreal maxTarget=0;
+        for (int j=i+1; j<neighbours.size(); j++) {
+            maxTarget=qMax(maxTarget,du+arcs[neighbours[j].second].weight);
+        }
+        // witness search
+        witness.reset(n);
+        witness.dist[u]=0;
+        witness.touched.append(u);
+        witness.push(0.0,u);
+        int settled=0;
+        while (!witness.queue.empty()) {
+            const Entry e=witness.pop();
+            if (e.first>witness.dist[e.second]) continue;
+            if (e.first>maxTarget || ++settled>witnessMaxSettled) break;
+            for (int a:adjacency[e.second]) {
+                const int y=otherNode(a,e.second);
+                if (y==v || contracted[y]) continue;
+                const qreal d=e.first+arcs[a].weight;
+                if (d<witness.dist[y]) {
+                    if (witness.dist[y]==infinity) witness.touched.append(y);
+                    witness.dist[y]=d;
+                    witness.push(d,y);
+                }
+            }
+        }
+        for (int j=i+1; j<neighbours.size(); j++) {
+            const int w=neighbours[j].first;
+            const qreal via=du+arcs[neighbours[j].second].weight;
+            if (witness.dist[w]<=via) continue;
+            shortcuts++;
+            if (!simulate) {
+                const int id=arcs.size();
+                arcs.append({u,w,via,nullptr,neighbours[i].second,neighbours[j].second});
+                adjacency[u].append(id);
+                adjacency[w].append(id);
+                shortcutCount++;
+            }
+        }
+    }
+    return shortcuts;
+}
+
+Link* ContractionHierarchy::firstLink(int arc,int from) const {
+    // the sub-arc containing "from" starts the path
+    while (arcs[arc].link==nullptr) {
+        const Arc &c1=arcs[arcs[arc].child1];
+        arc=(c1.node1==from || c1.node2==from)?arcs[arc].child1:arcs[arc].child2;
+    }
+    return arcs[arc].link;
+}
+
+QPair<Link*,qreal> ContractionHierarchy::route(int from,int to) const {
+    const int n=rank.size();
+    if (from<0 || to<0 || from>=n || to>=n) return {nullptr,infinity};
+    if (from==to) return {nullptr,0.0};
+    forward.reset(n);
+    backward.reset(n);
+    forward.dist[from]=0;
+    forward.touched.append(from);
+    forward.push(0.0,from);
+    backward.dist[to]=0;
+    backward.touched.append(to);
+    backward.push(0.0,to);
+
+    qreal best=infinity;
+    int meet=-1;
+    while (!forward.queue.empty() || !backward.queue.empty()) {
+        // the direction with the smallest key, stop when both keys exceed the best path
+        const bool isForward=backward.queue.empty() ||
+                             (!forward.queue.empty() && forward.queue.front().first<=backward.queue.front().first);
+        Search &search=isForward?forward:backward;
+        const Search &other=isForward?backward:forward;
+        if (search.queue.front().first>=best) break;
+        const Entry e=search.pop();
+        const int u=e.second;
+        if (e.first>search.dist[u]) continue;
+        if (e.first+other.dist[u]<best) {
+            best=e.first+other.dist[u];
+            meet=u;
+        }
+        for (int k=upStart[u]; k<upStart[u+1]; k++) {
+            const int a=upArcs[k];
+            const int v=otherNode(a,u);
+            const qreal d=e.first+arcs[a].weight;
+            if (d<search.dist[v]) {
+                if (search.dist[v]==infinity) search.touched.append(v);
+                search.dist[v]=d;
+                search.parent[v]=a;
+                search.push(d,v);
+            }
+        }
+    }
+    if (meet<0) return {nullptr,infinity};
+
+    // first arc of the path from "from"
+    int arc;
+    if (meet==from) {
+        arc=backward.parent[from];
+    } else {
+        int x=meet;
+        while (true) {
+            arc=forward.parent[x];
+            const int y=otherNode(arc,x);
+            if (y==from) break;
+            x=y;
+        }
+    }
+    return {firstLink(arc,from),best};
+}
@@ -0,0 +1,103 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include <QHash>
+#include <utility>
+#include <vector>
+
+class Server;
+class Link;
+class QIODevice;
+
+/**
+ * @brief The ContractionHierarchy class answers shortest path queries on the
+ * graph of the servers (links weighted by Link::getDistance()) without the n×n
+ * routing table.
+ * Preprocessing contracts the servers one by one, in the order of the edge
+ * difference, and adds shortcuts when no witness path exists. A query is a
+ * bidirectional Dijkstra on the upward arcs only, it settles a few hundred nodes
+ * even on very large maps. Shortcuts keep their two sub-arcs so the first
+ * Link of the path is found by unpacking.
+ * The preprocessed graph is saved with the world cache, see save() and load().
+ * The buffers of the preprocessing and of the queries are kept: building again
+ * the hierarchy of the same graph does not allocate.
+ * @warning queries use internal buffers: one query at a time.
+ */
+class ContractionHierarchy {
+public:
+    /**
+     * @brief build preprocesses the graph.
+     * @param servers nodes, the id of a server is its index
+     * @param links edges of the graph
+     */
+    void build(const QList<Server> &servers,const QList<Link*> &links);
+    /**
+     * @brief save writes the arcs, ranks and upward arc ranges, a link is stored as its index.
+     * @param device destination, at the position of the hierarchy
+     * @param linkIndex index of each link in the list given to load()
+     */
+    void save(QIODevice &device,const QHash<const Link*,qint32> &linkIndex) const;
+    /**
+     * @brief load restores a hierarchy written by save(), without preprocessing.
+     * @param data bytes written by save()
+     * @param size number of bytes written by save()
+     * @param links links of the graph, in the order of the indices given to save()
+     * @return false if the data is invalid, the hierarchy is then empty.
+     */
+    bool load(const uchar *data,qint64 size,const QList<Link*> &links);
+    /**
+     * @brief route gives the first link and the length of the shortest path.
+     * @param from id of the start server
+     * @param to id of the target server
+     * @return (nullptr,0) if from==to, (nullptr,infinity) if to is unreachable.
+     */
+    QPair<Link*,qreal> route(int from,int to) const;
+    qreal distance(int from,int to) const { return route(from,to).second; }
+    Link* firstHop(int from,int to) const { return route(from,to).first; }
+
+    int getNodeCount() const { return rank.size(); }
+    int getShortcutCount() const { return shortcutCount; }
+private:
+    struct Arc {
+        int node1,node2;
+        qreal weight;
+        Link *link; ///< nullptr for a shortcut
+        int child1,child2; ///< sub-arcs of a shortcut, child1 contains node1
+    };
+    struct Search {
+        using Entry=std::pair<qreal,int>;
+        QVector<qreal> dist;
+        QVector<int> parent; ///< arc toward the source
+        QVector<int> touched;
+        std::vector<Entry> queue; ///< binary heap of (distance,node), smallest on top
+        void reset(int n);
+        void push(qreal d,int u);
+        Entry pop();
+    };
+    int contractNode(int v,bool simulate);
+    void clear();
+    Link* firstLink(int arc,int from) const;
+    int otherNode(int arc,int node) const {
+        return arcs[arc].node1==node?arcs[arc].node2:arcs[arc].node1;
+    }
+
+    QVector<Arc> arcs;
+    QVector<int> rank; ///< contraction order of each node
+    QVector<int> upStart; ///< upward arcs of node u: upArcs[upStart[u]..upStart[u+1][
+    QVector<int> upArcs;
+    int shortcutCount=0;
+    // preprocessing only, kept for the next build()
+    QVector<QVector<int>> adjacency;
+    QVector<bool> contracted;
+    QVector<int> contractedNeighbours; ///< then the fill position of each node in upArcs
+    QVector<QPair<int,int>> neighbours; ///< (node, arc) of the node being contracted
+    std::vector<std::pair<int,int>> order; ///< binary heap of (priority,node), smallest on top
+    Search witness;
+    // query buffers
+    mutable Search forward,backward;
+};
+
+#endif // CONTRACTIONHIERARCHY_H
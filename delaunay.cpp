@@ -0,0 +1,314 @@
+#include "delaunay.h"
+#include <QMutex>
+#include <QThread>
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <future>
+#include <vector>
+
+namespace {
+
+const int parallelMinSites=20000; ///< smaller sub-problems are solved in the current thread
+
+/*************************************************************************
+ * Quad-edge structure (Guibas & Stolfi 1985)
+ *************************************************************************/
+
+struct QuadEdge;
+
+struct Edge {
+    int num; ///< index in the quad-edge (0..3)
+    Edge *next; ///< Onext
+    int org; ///< origin vertex (primal edges only)
+
+    Edge* rot() { return num<3?this+1:this-3; }
+    Edge* invRot() { return num>0?this-1:this+3; }
+    Edge* sym() { return num<2?this+2:this-2; }
+    Edge* onext() { return next; }
+    Edge* oprev() { return rot()->onext()->rot(); }
+    Edge* lnext() { return invRot()->onext()->rot(); }
+    Edge* rprev() { return sym()->onext(); }
+    int dest() { return sym()->org; }
+    QuadEdge* quad();
+};
+
+struct QuadEdge {
+    Edge e[4];
+    bool deleted=false;
+};
+
+QuadEdge* Edge::quad() {
+    return reinterpret_cast<QuadEdge*>(this-num);
+}
+
+/**
+ * @brief Edges of a sub-problem, allocated by blocks that keep their addresses.
+ * The blocks stay allocated after reset(), for the next build.
+ */
+class EdgePool {
+public:
+    EdgePool()=default;
+    ~EdgePool() {
+        for (QuadEdge *block:blocks) delete[] block;
+    }
+    EdgePool(const EdgePool&)=delete;
+    EdgePool& operator=(const EdgePool&)=delete;
+    QuadEdge& add() {
+        if (used==qsizetype(blocks.size())*blockSize) blocks.push_back(new QuadEdge[blockSize]);
+        QuadEdge &q=blocks[used/blockSize][used%blockSize];
+        q.deleted=false;
+        used++;
+        return q;
+    }
+    QuadEdge& operator[](qsizetype i) { return blocks[i/blockSize][i%blockSize]; }
+    qsizetype size() const { return used; }
+    void reset() { used=0; }
+private:
+    static const int blockSize=1024;
+    std::vector<QuadEdge*> blocks;
+    qsizetype used=0;
+};
+
+/**
+ * @brief Edge pools of the sub-problems, the first one is the root; a deque keeps
+ * their addresses.
+ */
+using EdgePools=std::deque<EdgePool>;
+
+class DivideAndConquer {
+public:
+    DivideAndConquer(const QVector<Vector2D> &p_pts,EdgePools &p_pools):pts(p_pts),pools(p_pools) {}
+    QPair<Edge*,Edge*> build(int lo,int hi,EdgePool &pool,int depth);
+    struct Tri { int a,b,c; };
+    void triangles(QVector<Triangle> &res,QVector<Tri> &tris);
+private:
+    Edge* makeEdge(EdgePool &pool,int org,int dest) {
+        QuadEdge &q=pool.add();
+        for (int i=0; i<4; i++) q.e[i].num=i;
+        q.e[0].next=&q.e[0];
+        q.e[1].next=&q.e[3];
+        q.e[2].next=&q.e[2];
+        q.e[3].next=&q.e[1];
+        q.e[0].org=org;
+        q.e[2].org=dest;
+        q.e[1].org=q.e[3].org=-1;
+        return &q.e[0];
+    }
+    static void splice(Edge *a,Edge *b) {
+        Edge *alpha=a->onext()->rot();
+        Edge *beta=b->onext()->rot();
+        std::swap(a->next,b->next);
+        std::swap(alpha->next,beta->next);
+    }
+    Edge* connect(EdgePool &pool,Edge *a,Edge *b) {
+        Edge *e=makeEdge(pool,a->dest(),b->org);
+        splice(e,a->lnext());
+        splice(e->sym(),b);
+        return e;
+    }
+    static void deleteEdge(Edge *e) {
+        splice(e,e->oprev());
+        splice(e->sym(),e->sym()->oprev());
+        e->quad()->deleted=true;
+    }
+    EdgePool& newPool() {
+        QMutexLocker lock(&poolsMutex);
+        // the pools of the previous build are reused first
+        if (poolsUsed==int(pools.size())) pools.emplace_back();
+        EdgePool &pool=pools[poolsUsed++];
+        pool.reset();
+        return pool;
+    }
+    bool ccw(int a,int b,int c) const {
+        const double ax=pts[a].x,ay=pts[a].y;
+        return (double(pts[b].x)-ax)*(double(pts[c].y)-ay)-(double(pts[b].y)-ay)*(double(pts[c].x)-ax)>0;
+    }
+    bool rightOf(int x,Edge *e) const { return ccw(x,e->dest(),e->org); }
+    bool leftOf(int x,Edge *e) const { return ccw(x,e->org,e->dest()); }
+    // same predicate as the incremental build, for the same diagonals between cocircular sites
+    bool inCircle(int a,int b,int c,int d) const { return inCircumcircle(pts[a],pts[b],pts[c],pts[d]); }
+
+    const QVector<Vector2D> &pts;
+    QMutex poolsMutex;
+    EdgePools &pools; ///< one pool per parallel task
+    int poolsUsed=0;
+public:
+    int maxParallelDepth=0;
+    EdgePool& rootPool() { return newPool(); }
+};
+
+/**
+ * @brief build triangulates the sorted sites [lo,hi[.
+ * @return the CCW convex hull edge out of the leftmost site and the CW
+ * convex hull edge out of the rightmost site.
+ */
+QPair<Edge*,Edge*> DivideAndConquer::build(int lo,int hi,EdgePool &pool,int depth) {
+    const int n=hi-lo;
+    if (n==2) {
+        Edge *a=makeEdge(pool,lo,lo+1);
+        return {a,a->sym()};
+    }
+    if (n==3) {
+        Edge *a=makeEdge(pool,lo,lo+1);
+        Edge *b=makeEdge(pool,lo+1,lo+2);
+        splice(a->sym(),b);
+        if (ccw(lo,lo+1,lo+2)) {
+            connect(pool,b,a);
+            return {a,b->sym()};
+        } else if (ccw(lo,lo+2,lo+1)) {
+            Edge *c=connect(pool,b,a);
+            return {c->sym(),c};
+        }
+        return {a,b->sym()}; // collinear
+    }
+    const int mid=lo+n/2;
+    QPair<Edge*,Edge*> left,right;
+    if (depth<maxParallelDepth && n>=parallelMinSites) {
+        // left half in a new thread, with its own pool of edges
+        EdgePool &leftPool=newPool();
+        auto future=std::async(std::launch::async,[this,lo,mid,&leftPool,depth] {
+            return build(lo,mid,leftPool,depth+1);
+        });
+        right=build(mid,hi,pool,depth+1);
+        left=future.get();
+    } else {
+        left=build(lo,mid,pool,depth+1);
+        right=build(mid,hi,pool,depth+1);
+    }
+    Edge *ldo=left.first,*ldi=left.second;
+    Edge *rdi=right.first,*rdo=right.second;
+
+    // lower common tangent of the two halves
+    while (true) {
+        if (leftOf(rdi->org,ldi)) ldi=ldi->lnext();
+        else if (rightOf(ldi->org,rdi)) rdi=rdi->rprev();
+        else break;
+    }
+    Edge *basel=connect(pool,rdi->sym(),ldi);
+    if (ldi->org==ldo->org) ldo=basel->sym();
+    if (rdi->org==rdo->org) rdo=basel;
+
+    // merge loop, from bottom to top
+    auto valid=[&](Edge *e) { return rightOf(e->dest(),basel); };
+    while (true) {
+        Edge *lcand=basel->sym()->onext();
+        if (valid(lcand)) {
+            while (inCircle(basel->dest(),basel->org,lcand->dest(),lcand->onext()->dest())) {
+                Edge *t=lcand->onext();
+                deleteEdge(lcand);
+                lcand=t;
+            }
+        }
+        Edge *rcand=basel->oprev();
+        if (valid(rcand)) {
+            while (inCircle(basel->dest(),basel->org,rcand->dest(),rcand->oprev()->dest())) {
+                Edge *t=rcand->oprev();
+                deleteEdge(rcand);
+                rcand=t;
+            }
+        }
+        const bool lvalid=valid(lcand),rvalid=valid(rcand);
+        if (!lvalid && !rvalid) break;
+        if (!lvalid || (rvalid && inCircle(lcand->dest(),lcand->org,rcand->org,rcand->dest()))) {
+            basel=connect(pool,rcand,basel->sym());
+        } else {
+            basel=connect(pool,basel->sym(),lcand->sym());
+        }
+    }
+    return {ldo,rdo};
+}
+
+void DivideAndConquer::triangles(QVector<Triangle> &res,QVector<Tri> &tris) {
+    tris.clear();
+    for (int p=0; p<poolsUsed; p++) {
+        EdgePool &pool=pools[p];
+        for (qsizetype i=0; i<pool.size(); i++) {
+            QuadEdge &q=pool[i];
+            if (q.deleted) continue;
+            for (int k=0; k<=2; k+=2) {
+                Edge *e=&q.e[k];
+                Edge *e1=e->lnext();
+                Edge *e2=e1->lnext();
+                // left face is a CCW triangle, reported once from its smallest vertex
+                if (e2->lnext()==e && e->org<e1->org && e->org<e2->org && ccw(e->org,e1->org,e2->org)) {
+                    tris.append({e->org,e1->org,e2->org});
+                }
+            }
+        }
+    }
+    // canonical order, independent of the pools filled by the threads
+    std::sort(tris.begin(),tris.end(),[](const Tri &u,const Tri &v) {
+        return u.a!=v.a?u.a<v.a:(u.b!=v.b?u.b<v.b:u.c<v.c);
+    });
+    res.clear();
+    res.reserve(tris.size());
+    for (auto &t:tris) {
+        res.append(Triangle(pts[t.a],pts[t.b],pts[t.c]));
+    }
+}
+
+} // namespace
+
+struct DelaunayBuilder::Buffers {
+    QVector<Vector2D> sorted;
+    EdgePools pools;
+    QVector<DivideAndConquer::Tri> tris;
+};
+
+DelaunayBuilder::DelaunayBuilder():buffers(new Buffers) {
+}
+
+DelaunayBuilder::~DelaunayBuilder() {
+    delete buffers;
+}
+
+void DelaunayBuilder::build(const QVector<Vector2D> &points,QVector<Triangle> &res) {
+    QVector<Vector2D> &sorted=buffers->sorted;
+    // copied element by element: an assignment would share the array and the sort would detach it
+    sorted.clear();
+    for (const Vector2D &p:points) sorted.push_back(p);
+    std::sort(sorted.begin(),sorted.end(),[](const Vector2D &u,const Vector2D &v) {
+        return u.x!=v.x?u.x<v.x:u.y<v.y;
+    });
+    sorted.erase(std::unique(sorted.begin(),sorted.end()),sorted.end());
+
+    res.clear();
+    if (sorted.size()<3) return;
+    DivideAndConquer dc(sorted,buffers->pools);
+    // about one thread per core at the top of the recursion
+    int cores=QThread::idealThreadCount();
+    while (cores>1) {
+        dc.maxParallelDepth++;
+        cores>>=1;
+    }
+    dc.build(0,sorted.size(),dc.rootPool(),0);
+    dc.triangles(res,buffers->tris);
+}
+
+QVector<Triangle> delaunayDivideAndConquer(const QVector<Vector2D> &points) {
+    DelaunayBuilder builder;
+    QVector<Triangle> res;
+    builder.build(points,res);
+    return res;
+}
+
+bool sameTriangles(const QVector<Triangle> &a,const QVector<Triangle> &b) {
+    if (a.size()!=b.size()) return false;
+    // each triangle as its 3 vertices rotated to start with the smallest one
+    using Key=std::array<float,6>;
+    auto keys=[](const QVector<Triangle> &tab) {
+        QVector<Key> res;
+        res.reserve(tab.size());
+        for (auto &t:tab) {
+            int m=0;
+            for (int i=1; i<3; i++) {
+                if (t[i].x<t[m].x || (t[i].x==t[m].x && t[i].y<t[m].y)) m=i;
+            }
+            res.append({t[m].x,t[m].y,t[(m+1)%3].x,t[(m+1)%3].y,t[(m+2)%3].x,t[(m+2)%3].y});
+        }
+        std::sort(res.begin(),res.end());
+        return res;
+    };
+    return keys(a)==keys(b);
+}
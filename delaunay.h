@@ -0,0 +1,46 @@
+#ifndef DELAUNAY_H
+#define DELAUNAY_H
+
+#include <QVector>
+#include <polygon.h>
+
+/**
+ * @brief delaunayDivideAndConquer computes the Delaunay triangulation of a set of
+ * points with the Guibas-Stolfi divide and conquer algorithm (quad-edge structure).
+ * Points are sorted by x then y, each half is triangulated recursively, the upper
+ * levels of the recursion run in parallel, then halves are merged.
+ * Complexity O(n log n).
+ * @param points sites (duplicates are ignored)
+ * @return CCW triangles, in a canonical order that does not depend on the threads.
+ */
+QVector<Triangle> delaunayDivideAndConquer(const QVector<Vector2D> &points);
+
+/**
+ * @brief The DelaunayBuilder class runs delaunayDivideAndConquer() with buffers kept
+ * between the builds: sorted sites, edges and triangles. A new build of a map of the
+ * same size does not allocate, except the threads of the maps of 20000 sites or more.
+ */
+class DelaunayBuilder {
+public:
+    DelaunayBuilder();
+    ~DelaunayBuilder();
+    DelaunayBuilder(const DelaunayBuilder&)=delete;
+    DelaunayBuilder& operator=(const DelaunayBuilder&)=delete;
+    /**
+     * @brief build triangulates the points, same result as delaunayDivideAndConquer().
+     * @param res CCW triangles, the previous content is replaced
+     */
+    void build(const QVector<Vector2D> &points,QVector<Triangle> &res);
+private:
+    struct Buffers;
+    Buffers *buffers;
+};
+
+/**
+ * @brief sameTriangles compares two triangulations whatever the order of the
+ * triangles and of their vertices.
+ * @return true if both contain the same triangles.
+ */
+bool sameTriangles(const QVector<Triangle> &a,const QVector<Triangle> &b);
+
+#endif // DELAUNAY_H
@@ -0,0 +1,288 @@
+#include "dispatcher.h"
+#include "serveranddrone.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <trace.h>
+
+void Dispatcher::reset(QList<Drone> *p_drones,QList<Server> *p_servers,const QVector<QVector<float>> *p_distances) {
+    drones=p_drones;
+    servers=p_servers;
+    distances=(p_distances && !p_distances->isEmpty())?p_distances:nullptr;
+    const int nServers=servers->size();
+    pending.clear();
+    tasks.fill(Task(),drones->size());
+    // the flights to the targets of the scenario are not missions
+    for (auto &d:*drones) d.delivering=false;
+    nearest=QVector<QVector<qint32>>(nServers);
+    idleAt=QVector<QVector<int>>(nServers);
+    idleIndex.fill(-1,nServers);
+    idleServers.clear();
+    lastStep=-1;
+    takeMetrics();
+}
+
+void Dispatcher::submit(const Mission &mission) {
+    const int n=servers?servers->size():0;
+    if (mission.pickup<0 || mission.pickup>=n || mission.dropoff<0 || mission.dropoff>=n) return;
+    pending.push_back(mission);
+    submitted++;
+}
+
+int Dispatcher::generate(int count,qint64 now,QRandomGenerator &rng) {
+    const int n=servers?servers->size():0;
+    if (n==0) return 0;
+    // failed servers are drawn again, a few times at most
+    auto randomServer=[&]() {
+        for (int k=0; k<16; k++) {
+            const qint32 s=qint32(rng.bounded(n));
+            if (!(*servers)[s].failed) return s;
+        }
+        return qint32(-1);
+    };
+    int generated=0;
+    for (int i=0; i<count; i++) {
+        const qint32 pickup=randomServer();
+        const qint32 dropoff=randomServer();
+        if (pickup<0 || dropoff<0) continue;
+        submit({pickup,dropoff,now});
+        generated++;
+    }
+    return generated;
+}
+
+qreal Dispatcher::cost(int a,int b) const {
+    if (distances) return (*distances)[a][b];
+    const QPointF d=(*servers)[a].position-(*servers)[b].position;
+    return sqrt(d.x()*d.x()+d.y()*d.y());
+}
+
+const QVector<qint32>& Dispatcher::nearestServers(int s) {
+    QVector<qint32> &order=nearest[s];
+    if (order.isEmpty()) {
+        order.resize(servers->size());
+        std::iota(order.begin(),order.end(),0);
+        std::stable_sort(order.begin(),order.end(),[this,s](qint32 a,qint32 b) {
+            return cost(s,a)<cost(s,b);
+        });
+    }
+    return order;
+}
+
+const QVector<int>& Dispatcher::step(qint64 now) {
+    TRACE_SCOPE("dispatch");
+    changed.clear();
+    if (drones==nullptr) return changed;
+    const int n=drones->size();
+    if (tasks.size()!=n) tasks.resize(n);
+
+    // missions in progress
+    idle.clear();
+    int busy=0;
+    for (int i=0; i<n; i++) {
+        Drone &drone=(*drones)[i];
+        Task &task=tasks[i];
+        Server *here=drone.getConnectedTo();
+        const bool stopped=drone.isIdle();
+        if (task.state==Free) {
+            // available once it has reached its target (the scenario one at start)
+            if (stopped && (drone.target==nullptr || here==drone.target) && !here->failed) idle.append({i,here->id});
+            continue;
+        }
+        busy++;
+        if (!stopped) continue;
+        const Mission &m=task.mission;
+        const Server *goal=&(*servers)[task.state==ToPickup?m.pickup:m.dropoff];
+        if (here!=goal) {
+            // no route: the mission is dropped, another drone would not reach the goal
+            // either, and the drone waits for a new mission where it is
+            dropped++;
+            task.state=Free;
+            drone.target=here;
+            busy--;
+            if (!here->failed) idle.append({i,here->id});
+            continue;
+        }
+        if (task.state==ToPickup && m.dropoff!=m.pickup) {
+            task.state=ToDropoff;
+            drone.target=&(*servers)[m.dropoff];
+            drone.delivering=true;
+            changed.append(i);
+            continue;
+        }
+        completed++;
+        deliveryTime+=now-m.created;
+        task.state=Free;
+        busy--;
+        idle.append({i,here->id});
+    }
+    if (lastStep>=0 && now>lastStep) {
+        busyTime+=qreal(busy)*(now-lastStep);
+        observedTime+=qint64(n)*(now-lastStep);
+    }
+    lastStep=now;
+
+    // new missions chained by the idle drones
+    assign(now,idle,assignments);
+    for (auto &a:assignments) {
+        Drone &drone=(*drones)[a.first];
+        tasks[a.first]={ToPickup,a.second};
+        drone.target=&(*servers)[a.second.pickup];
+        // the pickup leg is empty, unless the parcel stays in the same room
+        drone.delivering=a.second.dropoff==a.second.pickup;
+        changed.append(a.first);
+    }
+    return changed;
+}
+
+int Dispatcher::assign(qint64 now,const QVector<QPair<int,int>> &p_idle,QVector<QPair<int,Mission>> &result) {
+    result.clear();
+    if (pending.empty() || p_idle.isEmpty()) return 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (auto &p:p_idle) {
+        if (idleIndex[p.second]<0) {
+            idleIndex[p.second]=idleServers.size();
+            idleServers.append(p.second);
+        }
+        idleAt[p.second].append(p.first);
+    }
+
+    if (!distances) buildIdleGrid();
+
+    int count=0;
+    while (!pending.empty() && !idleServers.isEmpty() && count<batchSize) {
+        if ((count&63)==63 && timer.nsecsElapsed()>budget) break;
+        const Mission m=pending.front();
+        if ((*servers)[m.pickup].failed || (*servers)[m.dropoff].failed) {
+            pending.pop_front();
+            dropped++;
+            continue;
+        }
+        int best=idleIndex[m.pickup]>=0?m.pickup:-1;
+        if (best<0 && !distances) {
+            best=nearestIdleServer((*servers)[m.pickup].position);
+        } else if (best<0) {
+            // nearest servers first, as long as it is cheaper than a scan of the idle servers
+            int visited=0;
+            for (qint32 s:nearestServers(m.pickup)) {
+                if (idleIndex[s]>=0) {
+                    best=s;
+                    break;
+                }
+                if (++visited>idleServers.size()) break;
+            }
+        }
+        if (best<0) {
+            qreal bestCost=std::numeric_limits<qreal>::infinity();
+            for (qint32 s:idleServers) {
+                const qreal c=cost(s,m.pickup);
+                if (c<bestCost) {
+                    bestCost=c;
+                    best=s;
+                }
+            }
+        }
+        QVector<int> &bucket=idleAt[best];
+        result.append({bucket.takeLast(),m});
+        if (bucket.isEmpty()) { // swap-remove the server from the idle list
+            const int k=idleIndex[best];
+            idleServers[k]=idleServers.last();
+            idleIndex[idleServers[k]]=k;
+            idleServers.removeLast();
+            idleIndex[best]=-1;
+        }
+        pending.pop_front();
+        queueLatency+=now-m.created;
+        maxQueueLatency=qMax(maxQueueLatency,now-m.created);
+        count++;
+    }
+
+    // the buckets are emptied for the next step
+    for (qint32 s:idleServers) {
+        idleAt[s].clear();
+        idleIndex[s]=-1;
+    }
+    idleServers.clear();
+    assigned+=count;
+    assignCost+=timer.nsecsElapsed();
+    return count;
+}
+
+void Dispatcher::buildIdleGrid() {
+    qreal x0=std::numeric_limits<qreal>::max(),y0=x0,x1=-x0,y1=-x0;
+    for (qint32 s:idleServers) {
+        const QPointF &p=(*servers)[s].position;
+        x0=qMin(x0,p.x());
+        y0=qMin(y0,p.y());
+        x1=qMax(x1,p.x());
+        y1=qMax(y1,p.y());
+    }
+    // about one server per cell
+    const qreal side=qMax(qMax(x1-x0,y1-y0),qreal(1));
+    gridCellSize=side/std::ceil(std::sqrt(qreal(idleServers.size())));
+    gridX0=x0;
+    gridY0=y0;
+    gridWidth=int((x1-x0)/gridCellSize)+1;
+    gridHeight=int((y1-y0)/gridCellSize)+1;
+    if (grid.size()<gridWidth*gridHeight) grid.resize(gridWidth*gridHeight);
+    for (int i=0; i<gridWidth*gridHeight; i++) grid[i].clear();
+    for (qint32 s:idleServers) {
+        const QPointF &p=(*servers)[s].position;
+        grid[int((p.y()-y0)/gridCellSize)*gridWidth+int((p.x()-x0)/gridCellSize)].append(s);
+    }
+}
+
+int Dispatcher::nearestIdleServer(const QPointF &p) const {
+    const int cx=qBound(0,int(std::floor((p.x()-gridX0)/gridCellSize)),gridWidth-1);
+    const int cy=qBound(0,int(std::floor((p.y()-gridY0)/gridCellSize)),gridHeight-1);
+    int best=-1;
+    qreal bestD2=std::numeric_limits<qreal>::infinity();
+    auto visit=[&](int x,int y) {
+        for (qint32 s:grid[y*gridWidth+x]) {
+            if (idleIndex[s]<0) continue; // no more idle drone
+            const QPointF d=(*servers)[s].position-p;
+            const qreal d2=d.x()*d.x()+d.y()*d.y();
+            if (d2<bestD2) {
+                bestD2=d2;
+                best=s;
+            }
+        }
+    };
+    const int maxRing=qMax(gridWidth,gridHeight);
+    for (int r=0; r<=maxRing; r++) {
+        // the cells of ring r are at least (r-1) cells away
+        if (best>=0 && (r-1)*gridCellSize>std::sqrt(bestD2)) break;
+        for (int y=cy-r; y<=cy+r; y++) {
+            if (y<0 || y>=gridHeight) continue;
+            const bool border=(y==cy-r || y==cy+r);
+            for (int x=cx-r; x<=cx+r; x+=(border || r==0)?1:2*r) {
+                if (x>=0 && x<gridWidth) visit(x,y);
+            }
+        }
+    }
+    return best;
+}
+
+DispatchMetrics Dispatcher::takeMetrics() {
+    DispatchMetrics m;
+    m.submitted=submitted;
+    m.assigned=assigned;
+    m.completed=completed;
+    m.dropped=dropped;
+    m.pending=int(pending.size());
+    m.meanQueueLatency=assigned>0?qreal(queueLatency)/assigned:0;
+    m.maxQueueLatency=maxQueueLatency;
+    m.meanDeliveryTime=completed>0?qreal(deliveryTime)/completed:0;
+    m.utilisation=observedTime>0?busyTime/observedTime:0;
+    m.assignCost=assignCost;
+    submitted=assigned=completed=dropped=0;
+    queueLatency=maxQueueLatency=deliveryTime=0;
+    busyTime=0;
+    observedTime=0;
+    assignCost=0;
+    return m;
+}
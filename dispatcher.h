@@ -0,0 +1,137 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include <QPointF>
+#include <deque>
+
+class Server;
+class Drone;
+class QRandomGenerator;
+
+/**
+ * @brief A delivery: fly to the pickup server, then to the dropoff server.
+ */
+struct Mission {
+    qint32 pickup;
+    qint32 dropoff;
+    qint64 created; ///< simulation time of the submission (ms)
+};
+
+/**
+ * @brief Dispatch statistics since the previous call of Dispatcher::takeMetrics().
+ */
+struct DispatchMetrics {
+    int submitted=0;
+    int assigned=0;
+    int completed=0;
+    int dropped=0; ///< missions without route or with a failed server
+    int pending=0; ///< missions waiting in the queue now
+    qreal meanQueueLatency=0; ///< from submission to assignment (ms)
+    qint64 maxQueueLatency=0; ///< (ms)
+    qreal meanDeliveryTime=0; ///< from submission to dropoff (ms)
+    qreal utilisation=0; ///< mean part of the fleet flying a mission
+    qint64 assignCost=0; ///< wall time spent in the assignment (ns)
+};
+
+/**
+ * @brief The Dispatcher class feeds the drones with missions taken from a FIFO
+ * queue. At each step the drones that are idle receive a batch of missions: the
+ * oldest mission gets the idle drone nearest to its pickup (routing table
+ * distance, straight line on maps routed by a hierarchy), until the batch,
+ * the idle drones or the time budget are used up.
+ * Idle drones are kept in buckets by server; on table maps the servers are
+ * visited by increasing distance from the pickup (order sorted on first use),
+ * on the other maps the servers with idle drones are searched ring by ring in a
+ * uniform grid, so a mission usually costs a few bucket reads whatever the fleet size.
+ * A drone chains its missions: pickup, dropoff, then back to the idle pool; only
+ * its flights to a dropoff are deliveries (Drone::delivering).
+ * Missions whose servers have failed or that a drone cannot reach are dropped,
+ * the drones stopped in a failed server are not given missions.
+ */
+class Dispatcher {
+public:
+    /**
+     * @brief reset attaches the dispatcher to a world and clears the queue.
+     * @param p_drones the fleet
+     * @param p_servers servers of the map, the id of a server is its index
+     * @param p_distances routing table distances, empty on maps routed by a hierarchy
+     */
+    void reset(QList<Drone> *p_drones,QList<Server> *p_servers,const QVector<QVector<float>> *p_distances);
+    void setBatchSize(int n) { batchSize=n; }
+    /**
+     * @brief setBudget
+     * @param ns maximum wall time of the assignment of a step
+     */
+    void setBudget(qint64 ns) { budget=ns; }
+    void submit(const Mission &mission);
+    /**
+     * @brief generate submits random missions between random servers.
+     * @return number of missions submitted.
+     */
+    int generate(int count,qint64 now,QRandomGenerator &rng);
+    /**
+     * @brief step follows the missions in progress and assigns new missions to the idle drones.
+     * @param now simulation time (ms)
+     * @return indices of the drones whose target has changed.
+     */
+    const QVector<int>& step(qint64 now);
+    /**
+     * @brief assign matches pending missions with idle drones.
+     * @param now simulation time (ms)
+     * @param idle (drone,server) pairs of the available drones
+     * @param assignments (drone,mission) pairs, missions removed from the queue
+     * @return number of assignments.
+     */
+    int assign(qint64 now,const QVector<QPair<int,int>> &idle,QVector<QPair<int,Mission>> &assignments);
+    int getPendingCount() const { return int(pending.size()); }
+    DispatchMetrics takeMetrics();
+private:
+    enum State : char { Free, ToPickup, ToDropoff };
+    struct Task {
+        State state=Free;
+        Mission mission;
+    };
+    qreal cost(int a,int b) const;
+    const QVector<qint32>& nearestServers(int s);
+    void buildIdleGrid();
+    /**
+     * @brief nearestIdleServer finds the server with idle drones nearest to p in the grid.
+     */
+    int nearestIdleServer(const QPointF &p) const;
+
+    QList<Drone> *drones=nullptr;
+    QList<Server> *servers=nullptr;
+    const QVector<QVector<float>> *distances=nullptr;
+    int batchSize=4096;
+    qint64 budget=2000000;
+    std::deque<Mission> pending;
+    QVector<Task> tasks; ///< mission of each drone
+    QVector<QVector<qint32>> nearest; ///< servers by increasing distance, computed on demand
+    // buffers reused by the steps
+    QVector<QVector<int>> idleAt; ///< idle drones of each server
+    QVector<qint32> idleServers; ///< servers having idle drones
+    QVector<int> idleIndex; ///< position of a server in idleServers, -1 if none
+    QVector<QVector<qint32>> grid; ///< servers with idle drones by cell (maps without table)
+    qreal gridX0=0,gridY0=0,gridCellSize=1;
+    int gridWidth=0,gridHeight=0;
+    QVector<QPair<int,int>> idle;
+    QVector<QPair<int,Mission>> assignments;
+    QVector<int> changed;
+    // metrics since the last takeMetrics()
+    qint64 lastStep=-1;
+    int submitted=0;
+    int assigned=0;
+    int completed=0;
+    int dropped=0;
+    qint64 queueLatency=0;
+    qint64 maxQueueLatency=0;
+    qint64 deliveryTime=0;
+    qreal busyTime=0; ///< sum of busy drones x step duration
+    qint64 observedTime=0;
+    qint64 assignCost=0;
+};
+
+#endif // DISPATCHER_H
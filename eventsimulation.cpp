@@ -0,0 +1,107 @@
+#include "eventsimulation.h"
+
+void EventSimulation::reset(QList<Drone> *p_drones,QList<Server> *p_servers) {
+    drones=p_drones;
+    servers=p_servers;
+    now=0;
+    const int n=drones->size();
+    active.resize(n);
+    for (int i=0; i<n; i++) active[i]=i;
+    states.fill(Active,n);
+    cruises.resize(n);
+    generations.fill(0,n);
+    events=std::priority_queue<Event>();
+    cruising.clear();
+    cruisingSlot.fill(-1,n);
+    nbParked=0;
+    nbEvents=nbSteps=0;
+}
+
+void EventSimulation::wake(int i) {
+    if (states[i]==Active) return;
+    if (states[i]==Cruising) {
+        Drone &drone=(*drones)[i];
+        drone.position=cruises[i].start+(now-cruises[i].startTime)*cruises[i].velocity;
+        endCruise(i);
+    } else {
+        nbParked--;
+    }
+    generations[i]++; // cancels the pending event
+    states[i]=Active;
+    active.append(i);
+    nbEvents++;
+}
+
+bool EventSimulation::isCruising(const Drone &drone,qreal dt,qreal &duration) const {
+    if (drone.separation!=Vector2D(0,0)) return false;
+    const Vector2D speed=drone.getSpeed();
+    const double v=speed.length();
+    if (v<speedMax*(1.0-1e-6)) return false;
+    const Vector2D dir=drone.destination-drone.position;
+    const double d=dir.length();
+    // the motion is a straight line at speedMax until the slow down zone
+    if (d-slowDownDistance<2.0*dt*speedMax) return false;
+    if (fabs(speed^dir)>1e-4*v*d || speed*dir<=0) return false;
+    duration=(d-slowDownDistance)/v;
+    return true;
+}
+
+void EventSimulation::advance(qreal dt,bool syncCruising) {
+    const qreal t0=now;
+    const qreal t1=now+dt;
+
+    // drones whose cruise ends during this tick are stepped again
+    while (!events.empty() && events.top().time<=t1) {
+        const Event e=events.top();
+        events.pop();
+        if (e.generation!=generations[e.drone] || states[e.drone]!=Cruising) continue;
+        const Cruise &c=cruises[e.drone];
+        (*drones)[e.drone].position=c.start+(t0-c.startTime)*c.velocity;
+        states[e.drone]=Active;
+        active.append(e.drone);
+        endCruise(e.drone);
+        nbEvents++;
+    }
+
+    nextActive.clear();
+    for (int i:active) {
+        Drone &drone=(*drones)[i];
+        drone.overflownArea(*servers);
+        drone.move(dt);
+        nbSteps++;
+        qreal duration;
+        if (drone.isIdle()) {
+            states[i]=Parked;
+            nbParked++;
+            nbEvents++;
+        } else if (isCruising(drone,dt,duration)) {
+            states[i]=Cruising;
+            cruises[i]={drone.position,drone.getSpeed(),t1};
+            events.push({t1+duration,i,++generations[i]});
+            cruisingSlot[i]=cruising.size();
+            cruising.append(i);
+            nbEvents++;
+        } else {
+            nextActive.append(i);
+        }
+    }
+    active.swap(nextActive);
+    now=t1;
+    if (syncCruising) syncPositions();
+}
+
+void EventSimulation::syncPositions() {
+    for (int i:cruising) {
+        (*drones)[i].position=cruises[i].start+(now-cruises[i].startTime)*cruises[i].velocity;
+    }
+}
+
+void EventSimulation::endCruise(int i) {
+    // the last cruising drone takes the place of the drone
+    const int slot=cruisingSlot[i];
+    const int last=cruising.last();
+    cruising[slot]=last;
+    cruisingSlot[last]=slot;
+    cruising.removeLast();
+    cruisingSlot[i]=-1;
+}
@@ -0,0 +1,87 @@
+#ifndef EVENTSIMULATION_H
+#define EVENTSIMULATION_H
+
+#include <QVector>
+#include <queue>
+#include <serveranddrone.h>
+
+/**
+ * @brief The EventSimulation class moves the drones with an event queue instead
+ * of stepping every drone at every tick.
+ * - Parked drones (idle at their target or without route) leave the active set
+ *   until wake() is called.
+ * - Drones cruising at speedMax in straight line toward their destination are
+ *   not integrated: the time when they enter the slow down zone of the next
+ *   waypoint (door or server) is computed and they are stepped again only then.
+ * Only the active drones are stepped with Drone::move(), so the cost of a tick
+ * depends on the number of active drones and events, not on the fleet size.
+ * @warning drone separation is not applied in this mode.
+ */
+class EventSimulation {
+public:
+    /**
+     * @brief reset attaches the simulation to a set of drones, all drones are active.
+     * @param p_drones drones to move (must stay alive during the simulation)
+     * @param p_servers servers of the map
+     */
+    void reset(QList<Drone> *p_drones,QList<Server> *p_servers);
+    /**
+     * @brief advance moves the simulation time forward.
+     * @param dt time step in Drone::move() units
+     * @param syncCruising if true, positions of cruising drones are updated for display
+     */
+    void advance(qreal dt,bool syncCruising=true);
+    /**
+     * @brief wake puts a drone back in the active set (its target has changed).
+     * @param i index of the drone
+     */
+    void wake(int i);
+    /**
+     * @brief syncPositions computes the current position of the cruising drones,
+     * its cost depends on the number of cruising drones only.
+     */
+    void syncPositions();
+
+    qreal getTime() const { return now; }
+    int getActiveCount() const { return active.size(); }
+    int getCruisingCount() const { return cruising.size(); }
+    int getParkedCount() const { return nbParked; }
+    qint64 getEventCount() const { return nbEvents; }
+    qint64 getStepCount() const { return nbSteps; }
+private:
+    enum State : char { Active, Cruising, Parked };
+    struct Event {
+        qreal time; ///< time of the end of the cruise
+        int drone;
+        int generation; ///< stale events are ignored
+        bool operator<(const Event &other) const { return time>other.time; } // min-heap
+    };
+    struct Cruise {
+        Vector2D start; ///< position at startTime
+        Vector2D velocity;
+        qreal startTime;
+    };
+    bool isCruising(const Drone &drone,qreal dt,qreal &duration) const;
+    /**
+     * @brief endCruise removes a drone from the cruising drones.
+     * @param i index of the drone
+     */
+    void endCruise(int i);
+
+    QList<Drone> *drones=nullptr;
+    QList<Server> *servers=nullptr;
+    qreal now=0;
+    QVector<int> active; ///< indices of the drones stepped at each tick
+    QVector<int> nextActive; ///< buffer reused to build the next active set
+    QVector<State> states;
+    QVector<Cruise> cruises;
+    QVector<int> generations;
+    QVector<int> cruising; ///< indices of the cruising drones, in no order
+    QVector<int> cruisingSlot; ///< position of each drone in cruising, -1 if it is not cruising
+    std::priority_queue<Event> events;
+    int nbParked=0;
+    qint64 nbEvents=0;
+    qint64 nbSteps=0;
+};
+
+#endif // EVENTSIMULATION_H
@@ -0,0 +1,180 @@
+#include "failover.h"
+#include "serveranddrone.h"
+#include "contractionhierarchy.h"
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <trace.h>
+
+namespace {
+
+const qreal infinity=std::numeric_limits<qreal>::infinity();
+const int parallelMinServers=256; ///< the alternates of smaller maps cost less than a dispatch to the pool
+
+} // namespace
+
+void RoutingGraph::build(int nServers,const QList<Link*> &links) {
+    // the lists of the previous build keep their capacity
+    arcs.resize(nServers);
+    for (auto &list:arcs) list.clear();
+    nodes.resize(nServers);
+    std::iota(nodes.begin(),nodes.end(),0);
+    for (int i=0; i<links.size(); i++) {
+        Link *l=links[i];
+        if (!l->isUsable()) continue;
+        const int a=l->getNode1()->id;
+        const int b=l->getNode2()->id;
+        if (a==b || a<0 || b<0 || a>=nServers || b>=nServers) continue;
+        arcs[a].append({b,i,l->getDistance()});
+        arcs[b].append({a,i,l->getDistance()});
+    }
+}
+
+void loopFreeAlternates(const RoutingGraph &graph,const QVector<qreal> &dist,const QVector<qint32> &firstLinks,QVector<qint32> &backups) {
+    TRACE_SCOPE("loopFreeAlternates");
+    const qint64 n=graph.nodeCount();
+    backups.fill(-1,n*n);
+    auto alternates=[&](int s) {
+        const QVector<RoutingGraph::Arc> &arcs=graph.arcs[s];
+        for (qint64 t=0; t<n; t++) {
+            const qint32 primary=firstLinks[s*n+t];
+            if (t==s || primary<0) continue;
+            qint64 p=-1; // primary next server
+            for (auto &a:arcs) {
+                if (a.link==primary) {
+                    p=a.to;
+                    break;
+                }
+            }
+            const qreal here=dist[s*n+t];
+            qint32 best=-1;
+            qreal bestCost=infinity;
+            bool bestProtectsNode=false;
+            for (auto &a:arcs) {
+                if (a.link==primary) continue;
+                const qreal remaining=dist[a.to*n+t];
+                if (!(remaining<dist[a.to*n+s]+here)) continue; // its route comes back through s
+                const bool protectsNode=p>=0 && p!=t && a.to!=p && remaining<dist[a.to*n+p]+dist[p*n+t];
+                const qreal cost=a.weight+remaining;
+                if ((protectsNode && !bestProtectsNode) || (protectsNode==bestProtectsNode && cost<bestCost)) {
+                    best=a.link;
+                    bestCost=cost;
+                    bestProtectsNode=protectsNode;
+                }
+            }
+            backups[s*n+t]=best;
+        }
+    };
+    if (n<parallelMinServers) {
+        for (int s=0; s<n; s++) alternates(s);
+        return;
+    }
+    QtConcurrent::blockingMap(graph.nodes.cbegin(),graph.nodes.cend(),alternates);
+}
+
+int Failover::failLink(Link *link,QList<Drone> &drones) {
+    QElapsedTimer timer;
+    timer.start();
+    link->setFailed(true);
+    const int n=rerouteDrones(drones);
+    lastRerouteTime=timer.nsecsElapsed();
+    return n;
+}
+
+int Failover::failServer(Server *server,QList<Drone> &drones) {
+    QElapsedTimer timer;
+    timer.start();
+    server->failed=true;
+    const int n=rerouteDrones(drones);
+    lastRerouteTime=timer.nsecsElapsed();
+    return n;
+}
+
+void Failover::restoreAll(QList<Server> &servers,const QList<Link*> &links) {
+    for (auto &s:servers) s.failed=false;
+    for (Link *l:links) l->setFailed(false);
+}
+
+int Failover::rerouteDrones(QList<Drone> &drones) {
+    rerouted.clear();
+    for (int i=0; i<drones.size(); i++) {
+        if (drones[i].reroute()) rerouted.append(i);
+    }
+    return rerouted.size();
+}
+
+RoutingRepair::RoutingRepair(const QList<Server> &p_servers,const QList<Link*> &links,bool p_hierarchy):
+    servers(p_servers),hierarchy(p_hierarchy) {
+    if (hierarchy) {
+        for (Link *l:links) {
+            if (l->isUsable()) usableLinks.append(l);
+        }
+    } else {
+        graph.build(servers.size(),links);
+    }
+}
+
+RoutingRepair::~RoutingRepair() {
+    delete newRouter;
+}
+
+void RoutingRepair::run() {
+    TRACE_SCOPE("routingRepair");
+    if (hierarchy) {
+        newRouter=new ContractionHierarchy;
+        newRouter->build(servers,usableLinks);
+        return;
+    }
+    // Dijkstra from every server: O(n m log n), the sources are independent
+    const qint64 n=graph.nodeCount();
+    distances.fill(infinity,n*n);
+    firstLinks.fill(-1,n*n);
+    QtConcurrent::blockingMap(graph.nodes.cbegin(),graph.nodes.cend(),[&](int s) {
+        qreal *dist=distances.data()+s*n;
+        qint32 *first=firstLinks.data()+s*n;
+        using Entry=std::pair<qreal,int>;
+        std::priority_queue<Entry,std::vector<Entry>,std::greater<Entry>> queue;
+        dist[s]=0;
+        queue.push({0,s});
+        while (!queue.empty()) {
+            const auto [d,u]=queue.top();
+            queue.pop();
+            if (d>dist[u]) continue;
+            for (auto &a:graph.arcs[u]) {
+                const qreal alt=d+a.weight;
+                if (alt<dist[a.to]) {
+                    dist[a.to]=alt;
+                    first[a.to]=(u==s)?a.link:first[u];
+                    queue.push({alt,a.to});
+                }
+            }
+        }
+    });
+    loopFreeAlternates(graph,distances,firstLinks,backupLinks);
+}
+
+void RoutingRepair::apply(QList<Server> &p_servers,const QList<Link*> &links,QVector<QVector<float>> &distanceArray,ContractionHierarchy *&router) {
+    if (hierarchy) {
+        delete router;
+        router=newRouter;
+        newRouter=nullptr;
+        return;
+    }
+    const int n=graph.nodeCount();
+    if (p_servers.size()!=n) return;
+    distanceArray.resize(n);
+    for (int i=0; i<n; i++) {
+        Server &s=p_servers[i];
+        s.bestDistance.resize(n);
+        s.backupLink.resize(n);
+        distanceArray[i].resize(n);
+        for (int j=0; j<n; j++) {
+            const qint64 k=qint64(i)*n+j;
+            s.bestDistance[j]={firstLinks[k]>=0?links[firstLinks[k]]:nullptr,distances[k]};
+            s.backupLink[j]=backupLinks[k]>=0?links[backupLinks[k]]:nullptr;
+            distanceArray[i][j]=float(distances[k]);
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef FAILOVER_H
+#define FAILOVER_H
+
+#include <QList>
+#include <QVector>
+
+class Server;
+class Link;
+class Drone;
+class ContractionHierarchy;
+
+/**
+ * @brief The RoutingGraph struct is a copy of the usable links, the routes can be
+ * computed from it on a worker thread while the simulation goes on.
+ */
+struct RoutingGraph {
+    struct Arc {
+        qint32 to; ///< id of the neighbour server
+        qint32 link; ///< index of the link in the list given to build()
+        qreal weight;
+    };
+    QVector<QVector<Arc>> arcs; ///< arcs leaving each server
+    QVector<int> nodes; ///< ids 0..n-1, the sources dispatched to the pool
+
+    /**
+     * @brief build copies the links that are not down, the arrays of the previous build are reused.
+     * @param nServers number of servers, the id of a server is its index
+     * @param links links of the world
+     */
+    void build(int nServers,const QList<Link*> &links);
+    int nodeCount() const { return arcs.size(); }
+};
+
+/**
+ * @brief loopFreeAlternates computes a backup first link for each (server,target).
+ * A neighbour n of s is an alternate for the target t if D(n,t) < D(n,s) + D(s,t):
+ * its own shortest path never comes back through s. Alternates that also avoid the
+ * primary next server p (D(n,t) < D(n,p) + D(p,t)) are preferred, so the backup
+ * survives the loss of the door or of the next server.
+ * @param graph graph of the primary routes
+ * @param dist shortest distances, n x n row major
+ * @param firstLinks primary first link of each (server,target), n x n, -1 if none
+ * @param backups the backup link index of each (server,target), -1 if none; the
+ * array is reused, the sources are computed in parallel from 256 servers
+ */
+void loopFreeAlternates(const RoutingGraph &graph,const QVector<qreal> &dist,const QVector<qint32> &firstLinks,QVector<qint32> &backups);
+
+/**
+ * @brief The Failover class takes servers and doors out of service. The drones
+ * flying to a door that goes down switch at once to the backup next hop (see
+ * Drone::route()); the exact routes are then recomputed by a RoutingRepair.
+ */
+class Failover {
+public:
+    /**
+     * @brief failLink puts a door out of service.
+     * @param link the link of the door
+     * @param drones drones to reroute
+     * @return number of drones rerouted.
+     */
+    int failLink(Link *link,QList<Drone> &drones);
+    /**
+     * @brief failServer puts a server and all its doors out of service.
+     * @param server the server
+     * @param drones drones to reroute
+     * @return number of drones rerouted.
+     */
+    int failServer(Server *server,QList<Drone> &drones);
+    /**
+     * @brief restoreAll puts every server and door back in service.
+     */
+    void restoreAll(QList<Server> &servers,const QList<Link*> &links);
+    /**
+     * @brief getLastRerouteTime
+     * @return duration of the last reroute of the drones (ns)
+     */
+    qint64 getLastRerouteTime() const { return lastRerouteTime; }
+    /**
+     * @brief getReroutedDrones
+     * @return indices of the drones rerouted by the last failure.
+     */
+    const QVector<int>& getReroutedDrones() const { return rerouted; }
+private:
+    int rerouteDrones(QList<Drone> &drones);
+
+    qint64 lastRerouteTime=0;
+    QVector<int> rerouted;
+};
+
+/**
+ * @brief The RoutingRepair class recomputes the exact routes without the elements
+ * that are down: routing table and backups (Dijkstra from every server, in
+ * parallel) or a new contraction hierarchy for the large maps.
+ * The constructor and apply() run in the thread of the simulation, run() on a
+ * worker thread; the links must stay alive until apply().
+ */
+class RoutingRepair {
+public:
+    /**
+     * @brief RoutingRepair takes a copy of the usable links.
+     * @param servers servers of the world
+     * @param links links of the world
+     * @param hierarchy true if the world is routed by a ContractionHierarchy
+     */
+    RoutingRepair(const QList<Server> &servers,const QList<Link*> &links,bool hierarchy);
+    ~RoutingRepair();
+    RoutingRepair(const RoutingRepair&)=delete;
+    RoutingRepair& operator=(const RoutingRepair&)=delete;
+    void run();
+    /**
+     * @brief apply installs the new routes.
+     * @param servers servers given to the constructor
+     * @param links links given to the constructor
+     * @param distanceArray distance table of the world
+     * @param router router of the world, replaced for the hierarchy (the previous one is deleted)
+     */
+    void apply(QList<Server> &servers,const QList<Link*> &links,QVector<QVector<float>> &distanceArray,ContractionHierarchy *&router);
+private:
+    const QList<Server> &servers;
+    bool hierarchy;
+    RoutingGraph graph;
+    QList<Link*> usableLinks;
+    QVector<qreal> distances;
+    QVector<qint32> firstLinks,backupLinks;
+    ContractionHierarchy *newRouter=nullptr;
+};
+
+#endif // FAILOVER_H
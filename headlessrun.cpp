@@ -0,0 +1,93 @@
+#include "headlessrun.h"
+#include "world.h"
+#include "dispatcher.h"
+#include "kpi.h"
+#include "simulationclock.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+namespace {
+
+const qint64 tickDuration=100000000; ///< missions and samples every 100 ms of simulation, as the ticks of the interface
+const QSize defaultWindowSize(1000,1000); ///< window of the scenarios without one
+
+const char usage[]="usage: --run <scenario> <minutes> [--kpi <file.csv|file.json>] [--missions <per minute>]\n";
+
+} // namespace
+
+int runHeadless(const QStringList &args) {
+    QTextStream out(stdout);
+    bool ok=args.size()>=2;
+    const double minutes=ok?args[1].toDouble(&ok):0;
+    QString kpiFile="kpi.csv";
+    double missionRate=0;
+    for (int i=2; ok && i<args.size(); i+=2) {
+        if (i+1>=args.size()) ok=false;
+        else if (args[i]=="--kpi") kpiFile=args[i+1];
+        else if (args[i]=="--missions") missionRate=args[i+1].toDouble(&ok);
+        else ok=false;
+    }
+    if (!ok || minutes<=0) {
+        out << usage;
+        return 1;
+    }
+
+    World world;
+    QElapsedTimer timer;
+    timer.start();
+    if (!world.build(args[0],QPoint(0,0),defaultWindowSize)) {
+        out << "cannot load " << args[0] << ": " << world.errorString() << "\n";
+        return 1;
+    }
+    out << world.servers.size() << " servers, " << world.drones.size() << " drones, loaded in "
+        << timer.elapsed() << " ms\n";
+    out.flush();
+    Drone::router=world.router;
+    Drone::roomGrid=world.roomGrid;
+    KpiCounters kpi;
+    kpi.reset(world.servers,world.drones,world.links,0);
+    Drone::kpi=&kpi;
+    Dispatcher dispatcher;
+    QRandomGenerator rng(42);
+    double missionCarry=0;
+    if (missionRate>0) dispatcher.reset(&world.drones,&world.servers,&world.distanceArray);
+
+    // no separation: a sub-step moves a drone by less than the capture distance of a waypoint
+    const qint64 subStep=qint64(minDistance/speedMax*nsPerMoveUnit);
+    const qint64 end=qint64(minutes*60e9);
+    timer.restart();
+    qint64 t=0;
+    while (t<end) {
+        const qint64 tickEnd=qMin(t+tickDuration,end);
+        while (t<tickEnd) {
+            const qint64 dt=qMin(subStep,tickEnd-t);
+            t+=dt;
+            kpi.setTime(t);
+            for (auto &drone:world.drones) {
+                drone.overflownArea(world.servers);
+                drone.move(qreal(dt)/nsPerMoveUnit);
+            }
+        }
+        if (missionRate>0) {
+            missionCarry+=missionRate*tickDuration/60e9;
+            const int count=int(missionCarry);
+            missionCarry-=count;
+            dispatcher.generate(count,t/1000000,rng);
+            dispatcher.step(t/1000000);
+        }
+        kpi.sample(world.drones);
+    }
+    const qint64 wall=timer.elapsed();
+    Drone::kpi=nullptr;
+    Drone::router=nullptr;
+    Drone::roomGrid=nullptr;
+
+    out << minutes << " simulated minutes in " << wall << " ms: " << kpi.getDeliveries() << " deliveries\n";
+    if (!kpi.save(kpiFile,world.servers,world.drones,world.links)) {
+        out << "cannot write " << kpiFile << "\n";
+        return 1;
+    }
+    out << "KPIs written to " << kpiFile << "\n";
+    return 0;
+}
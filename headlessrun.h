@@ -0,0 +1,17 @@
+#ifndef HEADLESSRUN_H
+#define HEADLESSRUN_H
+
+#include <QStringList>
+
+/**
+ * @brief runHeadless simulates a scenario without the interface, as fast as
+ * possible, and exports the KpiCounters at the end of the run
+ * (DronesAndRooms --run <scenario> <minutes> [--kpi <file>] [--missions <rate>]).
+ * @param args scenario file, simulated minutes and options:
+ * --kpi output file, .json or .csv (kpi.csv by default),
+ * --missions random missions submitted to a Dispatcher per simulated minute
+ * @return the exit code of the program.
+ */
+int runHeadless(const QStringList &args);
+
+#endif // HEADLESSRUN_H
@@ -0,0 +1,108 @@
+#include "hilbert.h"
+#include "serveranddrone.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const quint32 gridSide=65536;
+
+/**
+ * @brief boundingBox of a set of points (QRectF::united() ignores the empty rectangles of single points).
+ */
+QRectF boundingBox(const QVector<QPointF> &points) {
+    qreal x0=points[0].x(),y0=points[0].y(),x1=x0,y1=y0;
+    for (auto &p:points) {
+        x0=qMin(x0,p.x());
+        y0=qMin(y0,p.y());
+        x1=qMax(x1,p.x());
+        y1=qMax(y1,p.y());
+    }
+    return QRectF(QPointF(x0,y0),QPointF(x1,y1));
+}
+
+/**
+ * @brief order gives the indices of the keys sorted by increasing key (stable).
+ */
+QVector<int> order(const QVector<quint32> &keys) {
+    QVector<int> perm(keys.size());
+    std::iota(perm.begin(),perm.end(),0);
+    std::stable_sort(perm.begin(),perm.end(),[&keys](int a,int b) { return keys[a]<keys[b]; });
+    return perm;
+}
+
+} // namespace
+
+quint32 hilbertIndex(quint32 x,quint32 y) {
+    quint32 d=0;
+    for (quint32 s=gridSide/2; s>0; s/=2) {
+        const quint32 rx=(x&s)?1:0;
+        const quint32 ry=(y&s)?1:0;
+        d+=s*s*((3*rx)^ry);
+        // rotation of the quadrant, so that the curve enters and leaves it by its sides
+        if (ry==0) {
+            if (rx==1) {
+                x=gridSide-1-x;
+                y=gridSide-1-y;
+            }
+            std::swap(x,y);
+        }
+    }
+    return d;
+}
+
+HilbertCurve::HilbertCurve(const QRectF &box):
+    x0(box.left()),y0(box.top()) {
+    const qreal side=qMax(box.width(),box.height());
+    scale=side>0?(gridSide-1)/side:1;
+}
+
+quint32 HilbertCurve::index(qreal x,qreal y) const {
+    const quint32 cx=quint32(qBound(qreal(0),(x-x0)*scale,qreal(gridSide-1)));
+    const quint32 cy=quint32(qBound(qreal(0),(y-y0)*scale,qreal(gridSide-1)));
+    return hilbertIndex(cx,cy);
+}
+
+void sortServersAlongHilbert(QList<Server> &servers,QList<Drone> &drones) {
+    const int n=servers.size();
+    if (n<2) return;
+    QVector<QPointF> positions(n);
+    for (int i=0; i<n; i++) positions[i]=servers[i].position;
+    const HilbertCurve curve(boundingBox(positions));
+    QVector<quint32> keys(n);
+    for (int i=0; i<n; i++) keys[i]=curve.index(positions[i].x(),positions[i].y());
+    const QVector<int> perm=order(keys);
+
+    QVector<int> targets(drones.size());
+    for (int i=0; i<drones.size(); i++) targets[i]=drones[i].target?drones[i].target->id:-1;
+    QVector<int> newIndex(n);
+    QList<Server> sorted;
+    sorted.reserve(n);
+    for (int k=0; k<n; k++) {
+        sorted.append(std::move(servers[perm[k]]));
+        sorted.last().id=k;
+        newIndex[perm[k]]=k;
+    }
+    servers.swap(sorted);
+    for (int i=0; i<drones.size(); i++) {
+        if (targets[i]>=0 && targets[i]<n) drones[i].target=&servers[newIndex[targets[i]]];
+    }
+}
+
+void sortTrianglesAlongHilbert(QVector<Triangle> &triangles) {
+    const int n=triangles.size();
+    if (n<2) return;
+    QVector<QPointF> centroids(n);
+    for (int i=0; i<n; i++) {
+        const Triangle &t=triangles[i];
+        centroids[i]=QPointF((t[0].x+t[1].x+t[2].x)/3.0,(t[0].y+t[1].y+t[2].y)/3.0);
+    }
+    const HilbertCurve curve(boundingBox(centroids));
+    QVector<quint32> keys(n);
+    for (int i=0; i<n; i++) keys[i]=curve.index(centroids[i].x(),centroids[i].y());
+    const QVector<int> perm=order(keys);
+    QVector<Triangle> sorted;
+    sorted.reserve(n);
+    for (int k:perm) sorted.append(triangles[k]);
+    triangles.swap(sorted);
+}
@@ -0,0 +1,46 @@
+#ifndef HILBERT_H
+#define HILBERT_H
+
+#include <QList>
+#include <QRectF>
+#include <QVector>
+
+class Server;
+class Drone;
+class Triangle;
+
+/**
+ * @brief hilbertIndex gives the rank of a cell along the Hilbert curve filling a
+ * 65536 x 65536 grid: cells close on the curve are close in the plane, so data
+ * sorted by this rank keeps spatial neighbours close in memory.
+ * @param x,y coordinates of the cell in [0,65535]
+ */
+quint32 hilbertIndex(quint32 x,quint32 y);
+
+/**
+ * @brief The HilbertCurve class scales the positions of a box to the grid of hilbertIndex().
+ */
+class HilbertCurve {
+public:
+    explicit HilbertCurve(const QRectF &box);
+    quint32 index(qreal x,qreal y) const;
+private:
+    qreal x0,y0;
+    qreal scale;
+};
+
+/**
+ * @brief sortServersAlongHilbert sorts the servers of a scenario by the Hilbert rank
+ * of their position. The ids are set to the new indices and the targets of the
+ * drones follow their server. Called before the cells, links and routes are computed.
+ * @param servers servers whose id is their index
+ * @param drones drones targeting these servers
+ */
+void sortServersAlongHilbert(QList<Server> &servers,QList<Drone> &drones);
+
+/**
+ * @brief sortTrianglesAlongHilbert sorts triangles by the Hilbert rank of their centroid.
+ */
+void sortTrianglesAlongHilbert(QVector<Triangle> &triangles);
+
+#endif // HILBERT_H
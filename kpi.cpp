@@ -0,0 +1,167 @@
+#include "kpi.h"
+#include "serveranddrone.h"
+#include "simulationclock.h"
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+
+namespace {
+
+const qint64 nsPerMinute=60000000000LL;
+
+QString csvField(const QString &s) {
+    if (!s.contains(',') && !s.contains('"')) return s;
+    return '"'+QString(s).replace("\"","\"\"")+'"';
+}
+
+inline double seconds(double ns) {
+    return ns*1e-9;
+}
+
+} // namespace
+
+void KpiCounters::reset(const QList<Server> &servers,QList<Drone> &drones,const QList<Link*> &links,qint64 now) {
+    start=time=now;
+    deliveries.store(0,std::memory_order_relaxed);
+    minuteStart=0;
+    minutes.clear();
+    roomVisits=std::vector<std::atomic<qint64>>(servers.size());
+    roomDwell=std::vector<std::atomic<qint64>>(servers.size());
+    linkCrossings.resize(links.size());
+    for (int i=0; i<links.size(); i++) linkCrossings[i]=links[i]->getCrossings();
+    for (auto &d:drones) d.kpiStats=DroneKpi();
+}
+
+void KpiCounters::beginTrip(DroneKpi &stats,const Server *target,double distance) const {
+    stats.tripTarget=target;
+    stats.tripStart=time;
+    stats.tripBound=qint64(distance/speedMax*nsPerMoveUnit);
+}
+
+void KpiCounters::endTrip(DroneKpi &stats,bool delivery) {
+    const qint64 duration=time-stats.tripStart;
+    stats.tripTarget=nullptr;
+    if (!delivery) return;
+    stats.trips++;
+    stats.tripTime+=duration;
+    stats.boundTime+=stats.tripBound;
+    if (stats.tripBound>0) stats.maxStretch=qMax(stats.maxStretch,double(duration)/stats.tripBound);
+    deliveries.fetch_add(1,std::memory_order_relaxed);
+}
+
+void KpiCounters::leaveRoom(DroneKpi &stats,int room) {
+    // the first room is entered before the start of the measure
+    if (stats.roomEnter>=0 && room>=0 && size_t(room)<roomDwell.size()) {
+        roomVisits[room].fetch_add(1,std::memory_order_relaxed);
+        roomDwell[room].fetch_add(time-stats.roomEnter,std::memory_order_relaxed);
+    }
+    stats.roomEnter=time;
+}
+
+void KpiCounters::sample(const QList<Drone> &drones) {
+    if (time-start<(minutes.size()+1)*nsPerMinute) return;
+    int idle=0;
+    for (auto &d:drones) {
+        if (d.isIdle()) idle++;
+    }
+    const qint64 total=getDeliveries();
+    while (time-start>=(minutes.size()+1)*nsPerMinute) {
+        // the deliveries of a long step are given to its last minute
+        minutes.append({total-minuteStart,int(drones.size())-idle,idle});
+        minuteStart=total;
+    }
+}
+
+bool KpiCounters::save(const QString &filename,const QList<Server> &servers,const QList<Drone> &drones,const QList<Link*> &links) const {
+    const double simulated=double(time-start)/nsPerMinute;
+    const qint64 total=getDeliveries();
+    qint64 tripTime=0,boundTime=0;
+    for (auto &d:drones) {
+        tripTime+=d.kpiStats.tripTime;
+        boundTime+=d.kpiStats.boundTime;
+    }
+    const double stretch=boundTime>0?double(tripTime)/boundTime:0;
+
+    QSaveFile out(filename);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    if (QFileInfo(filename).suffix().compare("json",Qt::CaseInsensitive)==0) {
+        QJsonObject root;
+        root["simulatedMinutes"]=simulated;
+        root["deliveries"]=total;
+        root["deliveriesPerMinute"]=simulated>0?total/simulated:0;
+        root["meanStretch"]=stretch;
+        QJsonArray tabMinutes;
+        for (int i=0; i<minutes.size(); i++) {
+            tabMinutes.append(QJsonObject{{"minute",i+1},{"deliveries",minutes[i].deliveries},
+                                          {"active",minutes[i].active},{"idle",minutes[i].idle}});
+        }
+        root["minutes"]=tabMinutes;
+        QJsonArray tabDrones;
+        for (auto &d:drones) {
+            const DroneKpi &s=d.kpiStats;
+            tabDrones.append(QJsonObject{{"name",d.name},{"trips",s.trips},
+                                         {"meanTripTime",s.trips>0?seconds(s.tripTime)/s.trips:0},
+                                         {"meanLowerBound",s.trips>0?seconds(s.boundTime)/s.trips:0},
+                                         {"stretch",s.boundTime>0?double(s.tripTime)/s.boundTime:0},
+                                         {"maxStretch",s.maxStretch}});
+        }
+        root["drones"]=tabDrones;
+        QJsonArray tabDoors;
+        for (int i=0; i<links.size(); i++) {
+            Link *l=links[i];
+            const int base=i<linkCrossings.size()?linkCrossings[i]:0;
+            tabDoors.append(QJsonObject{{"room1",l->getNode1()->name},{"room2",l->getNode2()->name},
+                                        {"crossings",l->getCrossings()-base}});
+        }
+        root["doors"]=tabDoors;
+        QJsonArray tabRooms;
+        for (int i=0; i<servers.size() && size_t(i)<roomVisits.size(); i++) {
+            const qint64 visits=roomVisits[i].load(std::memory_order_relaxed);
+            const qint64 dwell=roomDwell[i].load(std::memory_order_relaxed);
+            tabRooms.append(QJsonObject{{"name",servers[i].name},{"visits",visits},
+                                        {"meanDwell",visits>0?seconds(dwell)/visits:0}});
+        }
+        root["rooms"]=tabRooms;
+        out.write(QJsonDocument(root).toJson());
+        return out.commit();
+    }
+
+    QTextStream csv(&out);
+    csv << "# summary\n"
+        << "simulated minutes,deliveries,deliveries per minute,mean stretch\n"
+        << simulated << "," << total << "," << (simulated>0?total/simulated:0) << "," << stretch << "\n\n";
+    csv << "# deliveries per minute\n"
+        << "minute,deliveries,active drones,idle drones\n";
+    for (int i=0; i<minutes.size(); i++) {
+        csv << i+1 << "," << minutes[i].deliveries << "," << minutes[i].active << "," << minutes[i].idle << "\n";
+    }
+    csv << "\n# drones\n"
+        << "drone,trips,mean trip time (s),mean lower bound (s),stretch,max stretch\n";
+    for (auto &d:drones) {
+        const DroneKpi &s=d.kpiStats;
+        csv << csvField(d.name) << "," << s.trips << ","
+            << (s.trips>0?seconds(s.tripTime)/s.trips:0) << ","
+            << (s.trips>0?seconds(s.boundTime)/s.trips:0) << ","
+            << (s.boundTime>0?double(s.tripTime)/s.boundTime:0) << "," << s.maxStretch << "\n";
+    }
+    csv << "\n# doors\n"
+        << "room 1,room 2,crossings\n";
+    for (int i=0; i<links.size(); i++) {
+        Link *l=links[i];
+        const int base=i<linkCrossings.size()?linkCrossings[i]:0;
+        csv << csvField(l->getNode1()->name) << "," << csvField(l->getNode2()->name) << ","
+            << l->getCrossings()-base << "\n";
+    }
+    csv << "\n# rooms\n"
+        << "room,visits,mean dwell (s)\n";
+    for (int i=0; i<servers.size() && size_t(i)<roomVisits.size(); i++) {
+        const qint64 visits=roomVisits[i].load(std::memory_order_relaxed);
+        const qint64 dwell=roomDwell[i].load(std::memory_order_relaxed);
+        csv << csvField(servers[i].name) << "," << visits << "," << (visits>0?seconds(dwell)/visits:0) << "\n";
+    }
+    csv.flush();
+    return out.commit();
+}
@@ -0,0 +1,98 @@
+#ifndef KPI_H
+#define KPI_H
+
+#include <QList>
+#include <QVector>
+#include <atomic>
+#include <vector>
+
+class Server;
+class Link;
+class Drone;
+
+/**
+ * @brief Trip counters of one drone. They are only written by the Drone::move()
+ * of their drone, so they need no synchronisation whatever the thread moving it.
+ */
+struct DroneKpi {
+    const Server *tripTarget=nullptr; ///< target of the trip in progress, null if none
+    qint64 tripStart=0; ///< (ns)
+    qint64 tripBound=0; ///< flight along the bestDistance route at speedMax (ns)
+    qint64 roomEnter=-1; ///< arrival in the current room (ns), -1 until the first door
+    int trips=0; ///< trips completed, deliveries only
+    qint64 tripTime=0; ///< sum of the durations of the completed trips (ns)
+    qint64 boundTime=0; ///< sum of their lower bounds (ns)
+    double maxStretch=0; ///< worst trip duration / lower bound
+};
+
+/**
+ * @brief The KpiCounters class measures how well a map and a routing policy perform:
+ * deliveries per simulated minute, trip time against the bestDistance lower bound,
+ * door crossings, room dwell times and active/idle drones.
+ * It is attached to the drones by Drone::kpi and fed by Drone::move(): trips are
+ * counted in the DroneKpi of each drone, deliveries and room dwells in relaxed
+ * atomics, door crossings by Link::cross(). Nothing is counted while Drone::kpi is null.
+ * A delivery is a trip completed: a drone reaching its target server. With the
+ * Dispatcher, only the dropoff legs are deliveries: the pickup legs are flown empty,
+ * they are neither counted nor mixed in the trip times (see Drone::delivering).
+ */
+class KpiCounters {
+public:
+    /**
+     * @brief reset clears the counters, of the drones too.
+     * @param servers servers of the world, the id of a server is its index
+     * @param drones the fleet
+     * @param links links of the world, their crossings are counted from now
+     * @param now simulation time (ns)
+     */
+    void reset(const QList<Server> &servers,QList<Drone> &drones,const QList<Link*> &links,qint64 now);
+    /**
+     * @brief setTime gives the simulation time of the next moves.
+     * @param ns simulation time at the end of the sub-step
+     */
+    void setTime(qint64 ns) { time=ns; }
+    qint64 getTime() const { return time; }
+    /**
+     * @brief beginTrip starts a trip when a drone leaves a server for a new target.
+     * @param distance length of the shortest route to the target
+     */
+    void beginTrip(DroneKpi &stats,const Server *target,double distance) const;
+    /**
+     * @brief endTrip completes the trip of a drone that has reached its target.
+     * @param delivery false for a flight to a pickup: the trip is not counted
+     */
+    void endTrip(DroneKpi &stats,bool delivery);
+    /**
+     * @brief leaveRoom records the dwell of a drone crossing a door.
+     * @param room id of the server of the room left
+     */
+    void leaveRoom(DroneKpi &stats,int room);
+    /**
+     * @brief sample closes the simulated minutes elapsed since the previous call.
+     * Cheap between two minutes: call it after each step.
+     */
+    void sample(const QList<Drone> &drones);
+    qint64 getDeliveries() const { return deliveries.load(std::memory_order_relaxed); }
+    /**
+     * @brief save exports the counters.
+     * @param filename JSON if the suffix is .json, else CSV (one table per section)
+     * @return false if the file cannot be written.
+     */
+    bool save(const QString &filename,const QList<Server> &servers,const QList<Drone> &drones,const QList<Link*> &links) const;
+private:
+    struct Minute {
+        qint64 deliveries;
+        int active;
+        int idle;
+    };
+    qint64 start=0;
+    qint64 time=0;
+    std::atomic<qint64> deliveries{0};
+    qint64 minuteStart=0; ///< deliveries at the start of the current minute
+    QVector<Minute> minutes;
+    std::vector<std::atomic<qint64>> roomVisits; ///< by server id
+    std::vector<std::atomic<qint64>> roomDwell; ///< sum of the dwells (ns)
+    QVector<int> linkCrossings; ///< crossings of each link at reset()
+};
+
+#endif // KPI_H
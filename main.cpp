@@ -1,10 +1,23 @@
 #include "mainwindow.h"
+#include "headlessrun.h"
+#include "trajectoryquery.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    const QStringList args = a.arguments();
+    // DronesAndRooms --query <log> <command>: queries on a recorded trajectory log
+    const int query = args.indexOf("--query");
+    if (query >= 0) {
+        return runTrajectoryQuery(args.mid(query + 1));
+    }
+    // DronesAndRooms --run <scenario> <minutes>: simulation without the interface, KPIs exported at the end
+    const int run = args.indexOf("--run");
+    if (run >= 0) {
+        return runHeadless(args.mid(run + 1));
+    }
     MainWindow w;
     w.show();
     return a.exec();
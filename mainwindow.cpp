@@ -1,446 +1,621 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <canvas.h>
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
-#include <QFile>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <trianglemesh.h>
+#include <QInputDialog>
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <trace.h>
+
+namespace {
+
+const int simulationInterval=100; ///< period of the simulation ticks (ms)
+const qreal simulationBudget=0.75; ///< part of a tick the sub-steps may use, the rest is left to the display
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    ui->canvas->setTelemetry(&telemetry);
     // load initial simple case
     loadJson("../../../json/simple.json");
 }
 
 MainWindow::~MainWindow()
 {
+    cancelLoading();
+    cancelRepair();
+    stopRecording();
+    stopReplay();
+    delete sharedWorld;
+    delete spareWorld;
+    Drone::router = nullptr;
+    delete router;
+    Drone::roomGrid = nullptr;
+    delete roomGrid;
     delete ui;
 }
 
 bool MainWindow::loadJson(const QString& title) {
-    QFile file(title);
-    // --- RESET previous case (VERY IMPORTANT) ---
-    ui->canvas->servers.clear();
-    ui->canvas->drones.clear();
-
-    // If you store Link* pointers, delete them to avoid leaks
-    qDeleteAll(ui->canvas->links);
-    ui->canvas->links.clear();
-
-    // Also clear any other cached stuff you keep (optional)
-    ui->canvas->repaint();
-
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Impossible d'ouvrir le fichier:" << title;
-        return false;
-    }
+    // a previous load is replaced by this one
+    cancelLoading();
+
+    // the build runs on a pool thread, the current world keeps animating
+    const QPoint origin = ui->canvas->getOrigin();
+    const QSize size = ui->canvas->getSize();
+    const bool hilbert = spatialOrder;
+    // the world of the previous scenario is built again: its buffers are reused
+    World *world = spareWorld != nullptr ? spareWorld : new World;
+    spareWorld = nullptr;
+    QFuture<World*> future = QtConcurrent::run([world, title, origin, size, hilbert](QPromise<World*> &promise) {
+        promise.setProgressRange(0, 100);
+        world->spatialOrder = hilbert;
+        world->build(title, origin, size, [&promise](int percent, const char *stage) {
+            promise.setProgressValueAndText(percent, QString::fromLatin1(stage));
+            return !promise.isCanceled();
+        });
+        if (promise.isCanceled() || !promise.addResult(world)) delete world;
+    });
+
+    loadProgress = new QProgressDialog("Loading " + QFileInfo(title).fileName(), "Cancel", 0, 100, this);
+    loadProgress->setWindowModality(Qt::NonModal);
+    loadProgress->setMinimumDuration(500);
+    loadWatcher = new QFutureWatcher<World*>(this);
+    connect(loadWatcher, &QFutureWatcher<World*>::progressValueChanged, loadProgress, &QProgressDialog::setValue);
+    connect(loadWatcher, &QFutureWatcher<World*>::progressTextChanged, loadProgress, &QProgressDialog::setLabelText);
+    connect(loadProgress, &QProgressDialog::canceled, loadWatcher, &QFutureWatcher<World*>::cancel);
+    connect(loadWatcher, &QFutureWatcher<World*>::finished, this, &MainWindow::worldLoaded);
+    loadWatcher->setFuture(future);
+    return true;
+}
 
-    QByteArray data = file.readAll();
-    file.close();
+void MainWindow::cancelLoading() {
+    if (loadWatcher == nullptr) return;
+    loadWatcher->disconnect(this);
+    loadWatcher->cancel();
+    loadWatcher->waitForFinished();
+    QFuture<World*> future = loadWatcher->future();
+    if (future.resultCount() > 0) delete future.result();
+    delete loadWatcher;
+    loadWatcher = nullptr;
+    delete loadProgress;
+    loadProgress = nullptr;
+}
 
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-    if (error.error != QJsonParseError::NoError) {
-        qWarning() << "Erreur JSON:" << error.errorString();
-        return false;
+void MainWindow::worldLoaded() {
+    QFuture<World*> future = loadWatcher->future();
+    World *world = future.resultCount() > 0 ? future.result() : nullptr;
+    loadWatcher->deleteLater();
+    loadWatcher = nullptr;
+    loadProgress->deleteLater();
+    loadProgress = nullptr;
+    if (world == nullptr) {
+        statusBar()->showMessage("Loading canceled");
+        return;
     }
-    if (!doc.isObject()) {
-        qWarning() << "Le document JSON n'est pas un objet.";
-        return false;
+    if (!world->errorString().isEmpty()) {
+        qWarning() << "Erreur JSON:" << world->errorString();
+        QMessageBox::warning(this, "Load", "Cannot load the scenario: " + world->errorString());
+        delete world;
+        return;
     }
 
-    QJsonObject root = doc.object();
+    TRACE_SCOPE("swapWorld");
+    // the repair reads the links of the current scenario
+    cancelRepair();
+    // logs are tied to the drones of the current scenario
+    stopRecording();
+    stopReplay();
+    // swap keeps the addresses of servers and links used by the drones,
+    // the previous scenario stays in the world object, rebuilt by the next load
+    if (world->hasWindow) {
+        qCDebug(lcBuild) << "Window.origine =" << world->windowOrigin;
+        qCDebug(lcBuild) << "Window.size    =" << world->windowSize;
+        ui->canvas->setWindow(world->windowOrigin, world->windowSize);
+    }
+    ui->canvas->servers.swap(world->servers);
+    ui->canvas->drones.swap(world->drones);
+    ui->canvas->links.swap(world->links);
+    distanceArray.swap(world->distanceArray);
+    std::swap(router, world->router);
+    Drone::router = router;
+    std::swap(roomGrid, world->roomGrid);
+    Drone::roomGrid = roomGrid;
+    // the scenario may ask for the Hilbert order without the action
+    droneHash.setHilbertOrder(spatialOrder || world->spatialOrder);
+    delete spareWorld;
+    spareWorld = world;
+    qCDebug(lcBuild) << "Servers:" << ui->canvas->servers.size() << "Drones:" << ui->canvas->drones.size();
+
+    if (eventDriven) eventSim.reset(&ui->canvas->drones, &ui->canvas->servers);
+    if (dispatching) dispatcher.reset(&ui->canvas->drones, &ui->canvas->servers, &distanceArray);
+    telemetry.reset(ui->canvas->drones.size());
+    telemetry.publish(lastStepTime, ui->canvas->drones);
+    if (sharedWorld) on_actionShare_world_triggered(true);
+    ui->canvas->invalidateStaticLayer();
+    ui->canvas->update();
+}
 
-    // --- Window ---
-    if (root.contains("window") && root["window"].isObject()) {
-        QJsonObject win = root["window"].toObject();
+void MainWindow::update() {
+    TRACE_SCOPE("simulationStep");
+    simClock.beginTick();
 
-        auto origin = win.value("origine").toString().split(",");
-        auto size   = win.value("size").toString().split(",");
-        QPoint wOrigin={origin[0].toInt(),origin[1].toInt()};
-        QSize wSize={size[0].toInt(),size[1].toInt()};
-        qDebug() << "Window.origine =" << wOrigin;
-        qDebug() << "Window.size    =" << wSize;
-        ui->canvas->setWindow(wOrigin,wSize);
+    if (replay) { // drones are driven by the log, no simulation
+        replayStep();
+        simSteps++;
+        return;
     }
-
-    // --- Servers ---
-    if (root.contains("servers") && root["servers"].isArray()) {
-        int num=0;
-        QJsonArray arr = root["servers"].toArray();
-        for (const QJsonValue &v : arr) {
-            if (!v.isObject()) continue;
-            QJsonObject obj = v.toObject();
-            Server s;
-            s.name = obj.value("name").toString();
-            QString pos = obj.value("position").toString();
-            auto parts = pos.split(',');
-            if (parts.size() == 2)
-                s.position = QPoint(parts[0].toInt(), parts[1].toInt());
-            s.color = QColor(obj.value("color").toString());
-            s.id=num++;
-            ui->canvas->servers.append(s);
-            qDebug() << "Server:" << s.id << "," << s.name << s.position << s.color;
+    // the scaled elapsed time is split in sub-steps short enough to never jump over a door
+    const qint64 tickStart = simClock.getTime();
+    qint64 dt;
+    int n = 0;
+    while (simClock.nextSubStep(dt)) {
+        const qreal moveDt = qreal(dt) / nsPerMoveUnit;
+        if (eventDriven) {
+            // only active drones and cruise ends are processed
+            eventSim.advance(moveDt, false);
+        } else {
+            if (separationEnabled) {
+                TRACE_SCOPE("separation");
+                Drone::updateSeparation(ui->canvas->drones, droneHash);
+            }
+            for (auto &drone : ui->canvas->drones) {
+                drone.overflownArea(ui->canvas->servers);
+                drone.move(moveDt);
+            }
         }
+        simClock.endSubStep();
+        n++;
     }
-
-    // --- Drones ---
-    if (root.contains("drones") && root["drones"].isArray()) {
-        QJsonArray arr = root["drones"].toArray();
-
-        for (const QJsonValue &v : arr) {
-            if (!v.isObject()) continue;
-            QJsonObject obj = v.toObject();
-           Drone d;
-            d.name = obj.value("name").toString();
-            QString pos = obj.value("position").toString();
-            auto parts = pos.split(',');
-            if (parts.size() == 2)
-                d.position = Vector2D(parts[0].toInt(), parts[1].toInt());
-            QString name = obj.value("target").toString();
-            // search name in server list
-            d.target=nullptr;
-            auto it=ui->canvas->servers.begin();
-            while (it!=ui->canvas->servers.end() && it->name!=name) it++;
-            if (it!=ui->canvas->servers.end()) {
-                d.target=&(*it);
-                qDebug() << "Drone:" << d.name << "(" << d.position.x << "," << d.position.y << ") →" << d.target->name;
-            } else {
-                qDebug() << "error in JsonFile: bad destination name: " << name;
-            }
-            ui->canvas->drones.append(d);
+    if (n == 0) return; // paused
+    if (eventDriven) eventSim.syncPositions();
+    lastStepTime = simClock.getTime() / 1000000;
+    if (dispatching) {
+        // missions arrive at a constant rate of simulated time
+        missionCarry += missionRate * (simClock.getTime() - tickStart) / 60e9;
+        const int count = int(missionCarry);
+        missionCarry -= count;
+        dispatcher.generate(count, lastStepTime, missionRng);
+        for (int i : dispatcher.step(lastStepTime)) {
+            if (eventDriven) eventSim.wake(i);
         }
     }
-
-    createVoronoiMap();
-    createServersLinks();
-    fillDistanceArray();
-    return true;
+    // consumers (canvas, recorder, metrics) read the published frames at their own pace
+    telemetry.publish(lastStepTime, ui->canvas->drones);
+    if (sharedWorld) sharedWorld->publishDrones(lastStepTime, ui->canvas->drones);
+    simSteps++;
+    // no repaint here: the display is refreshed by render() at its own rate
 }
 
-void MainWindow::createVoronoiMap() {
-    TriangleMesh mesh(ui->canvas->servers);
-    mesh.setBox(ui->canvas->getOrigin(),ui->canvas->getSize());
-
-    auto triangles = mesh.getTriangles();
-    auto m_servor = ui->canvas->servers.begin();
-    QVector<const Triangle*> tabTri;
-    while (m_servor!=ui->canvas->servers.end()) {
-        // for all vertices of the mesh
-        const Vector2D vert((*m_servor).position.x(),(*m_servor).position.y());
-        auto mt_it = triangles->begin();
-        tabTri.clear(); // tabTri: list of triangles containing m_vert
-        while (mt_it!=triangles->end()) {
-            if ((*mt_it).hasVertex(vert)) {
-                tabTri.push_back(&(*mt_it));
+void MainWindow::render() {
+    // position of the frame between the two last simulation steps
+    qreal alpha = qreal(simClock.getWallTime() - simClock.getTickTime()) / (timer->interval() * 1e6);
+    ui->canvas->setInterpolation(qBound(0.0, alpha, 1.0));
+    ui->canvas->update(); // coalesced by Qt, never blocks the simulation
+    drainRecorder();
+
+    // metrics sink: drones that moved between two consecutive frames
+    while (metricsReader.next(metricsFrame)) {
+        if (metricsPrevious.number + 1 == metricsFrame.number &&
+            metricsPrevious.drones.size() == metricsFrame.drones.size()) {
+            movingDrones = 0;
+            for (int i = 0; i < metricsFrame.drones.size(); i++) {
+                const DroneSample &a = metricsPrevious.drones[i], &b = metricsFrame.drones[i];
+                if (a.x != b.x || a.y != b.y) movingDrones++;
             }
-            mt_it++;
         }
-        // find left border
-        auto first = tabTri.begin();
-        auto tt_it = tabTri.begin();
-        bool found=false;
-        while (tt_it!=tabTri.end() && !found) {
-            auto comp_it = tabTri.begin();
-            while (comp_it!=tabTri.end() && (*tt_it)->getNextVertex(vert)!=(*comp_it)->getPrevVertex(vert)) {
-                comp_it++;
-            }
-            if (comp_it==tabTri.end()) {
-                first=tt_it;
-                found=true;
-            }
-            tt_it++;
-        }
-        // create polygon
-
-        //poly->setColor((*m_servor)->color);
-        tt_it=first;
-        if (found && mesh.isInWindow((*tt_it)->getCenter().x,(*tt_it)->getCenter().y)) { // add a point for the left border
-            Vector2D V = (*first)->nextEdgeNormal(vert);
-            float k;
-            if (V.x > 0) { // (circumCenter+k V).x=width
-                k = (mesh.getWindowXmax() - (*first)->getCenter().x) / float(V.x);
-            } else {
-                k = (mesh.getWindowXmin()-(*first)->getCenter().x) / float(V.x);
-            }
-            if (V.y > 0) { // (circumCenter+k V).y=height
-                k = fmin(k, (mesh.getWindowYmax() - (*first)->getCenter().y) / float(V.y));
-            } else {
-                k = fmin(k, (mesh.getWindowYmin()-(*first)->getCenter().y) / float(V.y));
-            }
-            m_servor->area.addVertex(Vector2D((*first)->getCenter() + k * V));
-            Vector2D pt = (*first)->getCenter() + k * V;
+        std::swap(metricsPrevious, metricsFrame);
+    }
+
+    const qint64 pacing = pacingTimer.elapsed();
+    if (pacing >= 1000) {
+        const int frames = ui->canvas->takeFrameCount();
+        QString msg = QString("sim %1 Hz | render %2 Hz")
+                          .arg(simSteps * 1000.0 / pacing, 0, 'f', 1)
+                          .arg(frames * 1000.0 / pacing, 0, 'f', 1);
+        if (eventDriven) {
+            msg += QString(" | active %1 cruising %2 parked %3")
+                       .arg(eventSim.getActiveCount())
+                       .arg(eventSim.getCruisingCount())
+                       .arg(eventSim.getParkedCount());
         }
-        auto comp_it = first;
-        do {
-            m_servor->area.addVertex((*tt_it)->getCenter());
-            // search triangle on right of tt_it
-            comp_it = tabTri.begin();
-            while (comp_it!=tabTri.end() && (*tt_it)->getPrevVertex(vert)!=(*comp_it)->getNextVertex(vert)) {
-                comp_it++;
-            }
-            if (comp_it!=tabTri.end()) tt_it = comp_it;
-        } while (tt_it!=first && comp_it!=tabTri.end());
-        if (found && mesh.isInWindow((*tt_it)->getCenter())) { // add a point for the right border
-            Vector2D V = (*tt_it)->previousEdgeNormal(vert);
-            float k;
-            if (V.x > 0) { // (circumCenter+k V).x=width
-                k = (mesh.getWindowXmax() - (*tt_it)->getCenter().x) / float(V.x);
-            } else {
-                k = (mesh.getWindowXmin()-(*tt_it)->getCenter().x) / float(V.x);
-            }
-            if (V.y > 0) { // (circumCenter+k V).y=height
-                k = fmin(k, (mesh.getWindowYmax() - (*tt_it)->getCenter().y) / float(V.y));
-            } else {
-                k = fmin(k, (mesh.getWindowYmin()-(*tt_it)->getCenter().y) / float(V.y));
-            }
-            m_servor->area.addVertex(Vector2D((*tt_it)->getCenter() + k * V));
-            Vector2D pt = (*tt_it)->getCenter() + k * V;
+        msg += QString(" | moving %1 | telemetry dropped %2")
+                   .arg(movingDrones)
+                   .arg(telemetry.getDroppedFrames());
+        const SimulationMetrics m = simClock.takeMetrics();
+        msg += QString(" | x%1 | %2 sub-steps, %3 us (max %4 us)")
+                   .arg(simClock.getScale() < 0 ? QString("max") : QString::number(simClock.getScale()))
+                   .arg(m.steps)
+                   .arg(m.meanCost / 1000)
+                   .arg(m.maxCost / 1000);
+        if (m.lagged > 0) msg += QString(" | lag %1 s").arg(m.lagged / 1e9, 0, 'f', 2);
+        if (dispatching) {
+            const DispatchMetrics d = dispatcher.takeMetrics();
+            msg += QString(" | missions %1 pending, %2 done, %3 dropped, wait %4 s, utilisation %5%")
+                       .arg(d.pending)
+                       .arg(d.completed)
+                       .arg(d.dropped)
+                       .arg(d.meanQueueLatency / 1000.0, 0, 'f', 1)
+                       .arg(100.0 * d.utilisation, 0, 'f', 0);
         }
-        m_servor->area.clip(mesh.getWindowXmin(),mesh.getWindowYmin(),mesh.getWindowXmax(),mesh.getWindowYmax());
-        m_servor->area.triangulate();
+        statusBar()->showMessage(msg);
+        simSteps = 0;
+        pacingTimer.restart();
+    }
+}
 
-        m_servor++;
+void MainWindow::on_actionLoad_triggered() {
+    QString filename = QFileDialog::getOpenFileName(this,"Load scenario","","JSON scenario (*.json)");
+    if (filename.isEmpty()) return;
+    loadJson(filename);
+}
+
+
+void MainWindow::on_actionShow_graph_triggered(bool checked) {
+    ui->canvas->showGraph=checked;
+    ui->canvas->invalidateStaticLayer();
+    ui->canvas->repaint();
+}
+
+
+void MainWindow::on_actionMove_drones_triggered() {
+    if (timer==nullptr) {
+        timer = new QTimer(this);
+        timer->setInterval(simulationInterval);
+        connect(timer,SIGNAL(timeout()),this,SLOT(update()));
+
+        renderTimer = new QTimer(this);
+        renderTimer->setInterval(16); // ~60 Hz
+        renderTimer->setTimerType(Qt::PreciseTimer);
+        connect(renderTimer,SIGNAL(timeout()),this,SLOT(render()));
     }
+    timer->start();
+    renderTimer->start();
+
+    // a sub-step moves a drone by less than the capture distance of a waypoint
+    const qreal maxSpeed = speedMax * (1.0 + separationStrength);
+    simClock.setMaxSubStep(qint64(minDistance / maxSpeed * nsPerMoveUnit));
+    simClock.setBudget(qint64(simulationInterval * simulationBudget * 1e6));
+    simClock.start();
+    lastStepTime = 0;
+    pacingTimer.start();
+    simSteps = 0;
 }
 
-void MainWindow::createServersLinks()
-{
-    /***********************************************************************
-     ******************
-     ******************
-     * Exercise 2 — Graph Creation (Neighbors)
-     *
-     * Goal:
-     *   Connect servers with a Link if their Voronoi polygons share a common edge.
-     *
-     * Neighbor criterion:
-     *   Two servers i and j are neighbors if polygon(i) and polygon(j)
-     *   contain an identical edge segment (same endpoints, possibly reversed).
-     *
-     * Output:
-     *   - ui->canvas->links contains all created Link*
-     *   - each Server.links adjacency list is filled
-     *
-     * Complexity:
-     *   For n servers and ~v edges per polygon:
-     *     O(n^2 * v^2) edge comparisons (acceptable for small n).
-     ***********************************************************************/
-
-    // Clean existing links (avoid duplicates and memory leaks if reloading JSON)
-    for (auto *l : ui->canvas->links) delete l;
-    ui->canvas->links.clear();
-
-    // Clear adjacency lists
-    for (auto &s : ui->canvas->servers) s.links.clear();
-
-    // Small epsilon-based comparison for points (floating geometry)
-    auto samePoint = [](const Vector2D &a, const Vector2D &b) -> bool {
-        const double eps2 = 1e-6;
-        return a.distance2(b) <= eps2;
-    };
-
-    const int n = ui->canvas->servers.size();
-
-    // Compare each pair of servers only once (i < j)
-    for (int i = 0; i < n; ++i) {
-        for (int j = i + 1; j < n; ++j) {
-
-            Polygon &polyA = ui->canvas->servers[i].area;
-            Polygon &polyB = ui->canvas->servers[j].area;
-
-            bool foundCommonEdge = false;
-            QPair<Vector2D, Vector2D> commonEdge;
-
-            // Compare edges of polygon A with edges of polygon B
-            for (int ea = 0; ea < polyA.nbVertices() && !foundCommonEdge; ++ea) {
-                const auto eA = polyA.getEdge(ea); // (P_k, P_{k+1})
-
-                for (int eb = 0; eb < polyB.nbVertices() && !foundCommonEdge; ++eb) {
-                    const auto eB = polyB.getEdge(eb);
-
-                    // Same edge if endpoints match in same order or reversed order
-                    const bool sameDir =
-                        samePoint(eA.first,  eB.first)  && samePoint(eA.second, eB.second);
-                    const bool oppDir  =
-                        samePoint(eA.first,  eB.second) && samePoint(eA.second, eB.first);
-
-                    if (sameDir || oppDir) {
-                        commonEdge = eA;
-                        foundCommonEdge = true;
-                    }
-                }
-            }
 
-            // If polygons share an edge => create a Link between the two servers
-            if (foundCommonEdge) {
-                Link *link = new Link(&ui->canvas->servers[i],
-                                      &ui->canvas->servers[j],
-                                      commonEdge);
+void MainWindow::setTimeScale(qreal scale) {
+    simClock.setScale(scale);
+    ui->actionPause->setChecked(scale == 0);
+    ui->actionReal_time->setChecked(scale == 1);
+    ui->actionSpeed_x100->setChecked(scale == 100);
+    ui->actionSpeed_max->setChecked(scale < 0);
+}
+
 
-                ui->canvas->links.append(link);
-                ui->canvas->servers[i].links.append(link);
-                ui->canvas->servers[j].links.append(link);
-            }
-        }
+void MainWindow::on_actionPause_triggered() {
+    setTimeScale(0);
+}
+
+
+void MainWindow::on_actionReal_time_triggered() {
+    setTimeScale(1);
+}
+
+
+void MainWindow::on_actionSpeed_x100_triggered() {
+    setTimeScale(100);
+}
+
+
+void MainWindow::on_actionSpeed_max_triggered() {
+    setTimeScale(scaleMax);
+}
+
+
+void MainWindow::on_actionSeparation_triggered(bool checked) {
+    separationEnabled = checked;
+    if (!checked) {
+        for (auto &drone : ui->canvas->drones) drone.separation = Vector2D(0, 0);
     }
 }
 
-void MainWindow::fillDistanceArray()
-{
-    /***********************************************************************
-     * Exercise 2 — All-Pairs Shortest Paths + Routing Table
-     *
-     * Goal:
-     *   Compute the shortest path distance between every pair of servers,
-     *   and store for each source server i and target j:
-     *     - total shortest distance
-     *     - first Link to take (first hop) to reach j from i
-     *
-     * Data structures:
-     *   - distanceArray[i][j] : shortest distance value (for debug/UI)
-     *   - servers[i].bestDistance[j] = { firstLink, totalDistance }
-     *
-     * Algorithm:
-     *   Floyd–Warshall (all-pairs shortest paths)
-     *
-     * Complexity:
-     *   O(n^3), where n = number of servers
-     ***********************************************************************/
-
-    const int nServers = ui->canvas->servers.size();
-    const qreal INF = 1e18;
-
-    // Prepare distanceArray
-    distanceArray.resize(nServers);
-    for (int i = 0; i < nServers; ++i)
-        distanceArray[i].resize(nServers);
-
-    // Initialize bestDistance for every server
-    for (auto &s : ui->canvas->servers) {
-        s.bestDistance.resize(nServers);
-        for (int j = 0; j < nServers; ++j)
-            s.bestDistance[j] = { nullptr, 0.0 };
+
+void MainWindow::on_actionEvent_driven_triggered(bool checked) {
+    eventDriven = checked;
+    if (checked) {
+        for (auto &drone : ui->canvas->drones) drone.separation = Vector2D(0, 0);
+        eventSim.reset(&ui->canvas->drones, &ui->canvas->servers);
+    }
+}
+
+
+void MainWindow::on_actionCongestion_routing_triggered(bool checked) {
+    Drone::congestionRouting = checked;
+}
+
+
+void MainWindow::on_actionSpatial_order_triggered(bool checked) {
+    spatialOrder = checked;
+    droneHash.setHilbertOrder(checked);
+    statusBar()->showMessage("The servers and triangles are sorted when the next scenario is loaded");
+}
+
+
+void MainWindow::on_actionDoor_throughput_triggered() {
+    // doors sorted by number of crossings
+    QList<Link*> doors = ui->canvas->links;
+    std::sort(doors.begin(), doors.end(), [](Link *a, Link *b) {
+        return a->getCrossings() > b->getCrossings();
+    });
+    const double minutes = simClock.getTime() / 60e9; // simulated time
+    QString report;
+    int total = 0;
+    for (Link *l : doors) total += l->getCrossings();
+    report += QString("%1 crossings in %2 min\n\n").arg(total).arg(minutes, 0, 'f', 1);
+    for (int i = 0; i < doors.size() && i < 20; i++) {
+        Link *l = doors[i];
+        report += QString("%1 - %2: %3 crossings (%4/min), %5 on the way\n")
+                      .arg(l->getNode1()->name, l->getNode2()->name)
+                      .arg(l->getCrossings())
+                      .arg(minutes > 0 ? l->getCrossings() / minutes : 0.0, 0, 'f', 1)
+                      .arg(l->getOccupancy());
     }
+    QMessageBox::information(this, "Door throughput", report);
+}
 
-    // dist matrix + next-hop matrix
-    QVector<QVector<qreal>> dist(nServers, QVector<qreal>(nServers, INF));
-    QVector<QVector<int>>   next(nServers, QVector<int>(nServers, -1));
 
-    // Distance from a node to itself is 0
-    for (int i = 0; i < nServers; ++i) {
-        dist[i][i] = 0.0;
-        next[i][i] = i;
+void MainWindow::on_actionFail_server_triggered() {
+    QStringList names;
+    QList<Server*> candidates;
+    for (auto &s : ui->canvas->servers) {
+        if (s.failed) continue;
+        names.append(s.name);
+        candidates.append(&s);
     }
+    if (names.isEmpty()) return;
+    bool ok;
+    const QString name = QInputDialog::getItem(this, "Fail server", "Server:", names, 0, false, &ok);
+    if (!ok) return;
+    Server *server = candidates[names.indexOf(name)];
+    showReroute(server->name, failover.failServer(server, ui->canvas->drones));
+}
 
-    // Initialize with direct edges from Links
+
+void MainWindow::on_actionFail_door_triggered() {
+    QStringList names;
+    QList<Link*> candidates;
     for (Link *l : ui->canvas->links) {
-        const int a = l->getNode1()->id;
-        const int b = l->getNode2()->id;
-        const qreal w = l->getDistance();
-
-        // Keep smallest edge if duplicates exist
-        if (w < dist[a][b]) {
-            dist[a][b] = w;
-            dist[b][a] = w;
-            next[a][b] = b;
-            next[b][a] = a;
-        }
+        if (!l->isUsable()) continue;
+        names.append(l->getNode1()->name + " - " + l->getNode2()->name);
+        candidates.append(l);
     }
+    if (names.isEmpty()) return;
+    bool ok;
+    const QString name = QInputDialog::getItem(this, "Fail door", "Door:", names, 0, false, &ok);
+    if (!ok) return;
+    showReroute("door " + name, failover.failLink(candidates[names.indexOf(name)], ui->canvas->drones));
+}
 
-    // Floyd–Warshall: try improving dist[i][j] using intermediate k
-    for (int k = 0; k < nServers; ++k) {
-        for (int i = 0; i < nServers; ++i) {
-            for (int j = 0; j < nServers; ++j) {
-                const qreal alt = dist[i][k] + dist[k][j];
-                if (alt < dist[i][j]) {
-                    dist[i][j] = alt;
-                    // First hop from i to j becomes the first hop from i to k
-                    next[i][j] = next[i][k];
-                }
-            }
-        }
+
+void MainWindow::on_actionRestore_routes_triggered() {
+    failover.restoreAll(ui->canvas->servers, ui->canvas->links);
+    ui->canvas->invalidateStaticLayer();
+    startRepair();
+}
+
+
+void MainWindow::on_actionContinuous_delivery_triggered(bool checked) {
+    if (!checked) {
+        dispatching = false;
+        return;
     }
+    bool ok;
+    const double rate = QInputDialog::getDouble(this, "Continuous delivery", "Missions per simulated minute:",
+                                                qMax(1, int(ui->canvas->drones.size())), 0, 1e7, 1, &ok);
+    if (!ok) {
+        ui->actionContinuous_delivery->setChecked(false);
+        return;
+    }
+    missionRate = rate;
+    missionCarry = 0;
+    dispatcher.reset(&ui->canvas->drones, &ui->canvas->servers, &distanceArray);
+    dispatching = true;
+}
 
-    // Build distanceArray + routing table bestDistance
-    for (int i = 0; i < nServers; ++i) {
-        for (int j = 0; j < nServers; ++j) {
 
-            distanceArray[i][j] = (dist[i][j] >= INF) ? float(INF) : float(dist[i][j]);
+void MainWindow::showReroute(const QString &element, int nDrones) {
+    if (eventDriven) {
+        for (int i : failover.getReroutedDrones()) eventSim.wake(i);
+    }
+    ui->canvas->invalidateStaticLayer();
+    ui->canvas->update();
+    statusBar()->showMessage(QString("%1 down: %2 drones rerouted in %3 us, repairing the routes")
+                                 .arg(element)
+                                 .arg(nDrones)
+                                 .arg(failover.getLastRerouteTime() / 1000.0, 0, 'f', 1));
+    startRepair();
+}
 
-            // Same node: no hop needed
-            if (i == j) {
-                ui->canvas->servers[i].bestDistance[j] = { nullptr, 0.0 };
-                continue;
-            }
 
-            // Unreachable target
-            if (dist[i][j] >= INF || next[i][j] == -1) {
-                ui->canvas->servers[i].bestDistance[j] = { nullptr, dist[i][j] };
-                continue;
-            }
+void MainWindow::startRepair() {
+    if (repair) { // started again with the current failures when it ends
+        repairAgain = true;
+        return;
+    }
+    repairAgain = false;
+    repair = new RoutingRepair(ui->canvas->servers, ui->canvas->links, router != nullptr);
+    repairWatcher = new QFutureWatcher<void>(this);
+    connect(repairWatcher, &QFutureWatcher<void>::finished, this, &MainWindow::routingRepaired);
+    RoutingRepair *r = repair;
+    repairWatcher->setFuture(QtConcurrent::run([r]() { r->run(); }));
+}
 
-            // The next matrix tells the next node ID (first hop) from i toward j
-            const int firstHop = next[i][j];
-
-            // Find the actual Link* that connects i to firstHop
-            Link *firstLink = nullptr;
-            for (Link *l : ui->canvas->servers[i].links) {
-                const int n1 = l->getNode1()->id;
-                const int n2 = l->getNode2()->id;
-                if ((n1 == i && n2 == firstHop) || (n2 == i && n1 == firstHop)) {
-                    firstLink = l;
-                    break;
-                }
-            }
 
-            // Store routing decision + shortest total distance
-            ui->canvas->servers[i].bestDistance[j] = { firstLink, dist[i][j] };
+void MainWindow::cancelRepair() {
+    if (repair == nullptr) return;
+    repairWatcher->disconnect(this);
+    repairWatcher->waitForFinished();
+    repairWatcher->deleteLater();
+    repairWatcher = nullptr;
+    delete repair;
+    repair = nullptr;
+    repairAgain = false;
+}
+
+
+void MainWindow::routingRepaired() {
+    QElapsedTimer timer;
+    timer.start();
+    repair->apply(ui->canvas->servers, ui->canvas->links, distanceArray, router);
+    Drone::router = router;
+    delete repair;
+    repair = nullptr;
+    repairWatcher->deleteLater();
+    repairWatcher = nullptr;
+    // stopped drones look for a route again
+    if (eventDriven) eventSim.reset(&ui->canvas->drones, &ui->canvas->servers);
+    statusBar()->showMessage(QString("Routes repaired (installed in %1 ms)").arg(timer.elapsed()));
+    if (repairAgain) startRepair();
+}
+
+
+void MainWindow::stopRecording() {
+    if (recorder==nullptr) return;
+    drainRecorder();
+    delete recorderReader;
+    recorderReader = nullptr;
+    recorder->close();
+    if (!recorderIndex.save(TrajectoryIndex::indexFileOf(recordFile), recorder->getFrameCount())) {
+        qWarning() << "Cannot write the index of" << recordFile;
+    }
+    statusBar()->showMessage(QString("Recording stopped: %1 frames").arg(recorder->getFrameCount()));
+    delete recorder;
+    recorder = nullptr;
+    ui->actionRecord->setChecked(false);
+}
+
+
+void MainWindow::drainRecorder() {
+    if (recorder==nullptr) return;
+    while (recorderReader->next(recorderFrame)) {
+        recorder->writeFrame(recorderFrame.time - recordStart, recorderFrame.drones);
+        recorderIndex.addFrame(recorderFrame.time - recordStart, recorderFrame.drones);
+    }
+}
+
+
+void MainWindow::stopReplay() {
+    delete replay;
+    replay = nullptr;
+}
+
+
+void MainWindow::replayStep() {
+    qint64 frameTime;
+    if (replay->readUntil(replayClock.elapsed() + replayOffset, frameTime, replaySamples)) {
+        auto &drones = ui->canvas->drones;
+        const int n = qMin(drones.size(), replaySamples.size());
+        for (int i = 0; i < n; i++) {
+            drones[i].position = Vector2D(replaySamples[i].x, replaySamples[i].y);
+            drones[i].azimut = replaySamples[i].azimut;
         }
+        lastStepTime = frameTime;
+        telemetry.publish(lastStepTime, drones);
+        if (sharedWorld) sharedWorld->publishDrones(lastStepTime, drones);
+    }
+    if (replay->atEnd()) {
+        stopReplay();
+        statusBar()->showMessage("End of replay");
     }
+}
+
 
-    // Debug print: complete all-pairs table
-    qDebug() << "---- All-pairs shortest distances (Floyd–Warshall) ----";
-    for (int i = 0; i < nServers; ++i) {
-        QString line = QString("from %1: ").arg(i);
-        for (int j = 0; j < nServers; ++j)
-            line += QString(" %1").arg(dist[i][j], 0, 'f', 1);
-        qDebug().noquote() << line;
+void MainWindow::on_actionRecord_triggered(bool checked) {
+    if (!checked) {
+        stopRecording();
+        return;
     }
+    QString filename = QFileDialog::getSaveFileName(this,"Record trajectories","run.drtr","Drone trajectories (*.drtr)");
+    recorder = new TrajectoryWriter;
+    if (filename.isEmpty() || !recorder->open(filename, ui->canvas->drones.size())) {
+        delete recorder;
+        recorder = nullptr;
+        ui->actionRecord->setChecked(false);
+        return;
+    }
+    recordFile = filename;
+    recorderIndex.start(ui->canvas->drones.size());
+    recordStart = lastStepTime;
+    recorderReader = new TelemetryReader(&telemetry);
 }
 
-void MainWindow::update() {
-    static int last = elapsedTimer.elapsed();
-    int current = elapsedTimer.elapsed();
-    int dt = current - last;
-    last = current;
-
-    for (auto &drone : ui->canvas->drones) {
-        drone.overflownArea(ui->canvas->servers);
-        drone.move(dt / 25.0);
+
+void MainWindow::on_actionReplay_triggered() {
+    QString filename = QFileDialog::getOpenFileName(this,"Replay trajectories","","Drone trajectories (*.drtr)");
+    if (filename.isEmpty()) return;
+    stopRecording();
+    stopReplay();
+    replay = new TrajectoryReader;
+    if (!replay->open(filename) || replay->getDroneCount() != ui->canvas->drones.size()) {
+        QMessageBox::warning(this,"Replay","This log does not match the drones of the current scenario.");
+        stopReplay();
+        return;
     }
-    ui->canvas->repaint();
+    if (timer==nullptr || !timer->isActive()) on_actionMove_drones_triggered();
+    replayClock.start();
+    replayOffset = 0;
 }
 
-void MainWindow::on_actionShow_graph_triggered(bool checked) {
-    ui->canvas->showGraph=checked;
-    ui->canvas->repaint();
+
+void MainWindow::on_actionSeek_replay_triggered() {
+    if (replay==nullptr) return;
+    bool ok;
+    double t = QInputDialog::getDouble(this,"Seek replay","Time (s):",
+                                       (replayClock.elapsed() + replayOffset) / 1000.0,
+                                       0, replay->getDuration() / 1000.0, 1, &ok);
+    if (!ok || replay==nullptr) return;
+    const qint64 ms = qint64(t * 1000.0);
+    replay->seekTime(ms);
+    replayOffset = ms - replayClock.elapsed();
+    replayStep();
 }
 
 
-void MainWindow::on_actionMove_drones_triggered() {
-    timer = new QTimer(this);
-    timer->setInterval(100);
-    connect(timer,SIGNAL(timeout()),this,SLOT(update()));
-    timer->start();
+void MainWindow::on_actionShare_world_triggered(bool checked) {
+    if (!checked) {
+        delete sharedWorld;
+        sharedWorld = nullptr;
+        return;
+    }
+    if (sharedWorld == nullptr) sharedWorld = new SharedWorldWriter;
+    if (!sharedWorld->publishWorld(sharedWorldDefaultName, ui->canvas->getOrigin(), ui->canvas->getSize(),
+                                   ui->canvas->servers, ui->canvas->drones)) {
+        delete sharedWorld;
+        sharedWorld = nullptr;
+        ui->actionShare_world->setChecked(false);
+        QMessageBox::warning(this, "Share world", "Cannot create the shared memory segment.");
+        return;
+    }
+    statusBar()->showMessage(QString("World shared as %1").arg(QString::fromLatin1(sharedWorldDefaultName)));
+}
+
 
-    elapsedTimer.start();
+void MainWindow::on_actionTracing_triggered(bool checked) {
+    Trace::setEnabled(checked);
+    ui->canvas->update();
+}
+
+
+void MainWindow::on_actionExport_trace_triggered() {
+    QString filename = QFileDialog::getSaveFileName(this,"Export trace","trace.json","Chrome trace (*.json)");
+    if (filename.isEmpty()) return;
+    if (!Trace::exportChromeTrace(filename)) {
+        QMessageBox::warning(this,"Export trace","Cannot write "+filename);
+    }
 }
 
 
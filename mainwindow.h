@@ -4,6 +4,19 @@
 #include <QMainWindow>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <simulationclock.h>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <trajectory.h>
+#include <trajectoryindex.h>
+#include <spatialhash.h>
+#include <eventsimulation.h>
+#include <world.h>
+#include <telemetry.h>
+#include <sharedworld.h>
+#include <failover.h>
+#include <dispatcher.h>
+#include <QRandomGenerator>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -21,31 +34,140 @@ public:
 
 private slots:
     void update();
+    void render();
+    void worldLoaded();
+    void routingRepaired();
+
+    void on_actionLoad_triggered();
 
     void on_actionShow_graph_triggered(bool checked);
 
     void on_actionMove_drones_triggered();
 
+    void on_actionPause_triggered();
+
+    void on_actionReal_time_triggered();
+
+    void on_actionSpeed_x100_triggered();
+
+    void on_actionSpeed_max_triggered();
+
+    void on_actionSeparation_triggered(bool checked);
+
+    void on_actionEvent_driven_triggered(bool checked);
+
+    void on_actionCongestion_routing_triggered(bool checked);
+    void on_actionSpatial_order_triggered(bool checked);
+
+    void on_actionDoor_throughput_triggered();
+
+    void on_actionFail_server_triggered();
+
+    void on_actionFail_door_triggered();
+
+    void on_actionRestore_routes_triggered();
+
+    void on_actionContinuous_delivery_triggered(bool checked);
+
+    void on_actionRecord_triggered(bool checked);
+
+    void on_actionReplay_triggered();
+
+    void on_actionSeek_replay_triggered();
+
+    void on_actionShare_world_triggered(bool checked);
+
+    void on_actionTracing_triggered(bool checked);
+
+    void on_actionExport_trace_triggered();
+
     void on_actionQuit_triggered();
 
     void on_actionCredits_triggered();
 
 private:
     /**
-     * @brief loadJson
-     * @param title
-     * @return
+     * @brief loadJson starts building the scenario on a background thread,
+     * the world is swapped into the canvas by worldLoaded().
+     * @param title JSON scenario
+     * @return true if the load has been started.
      */
     bool loadJson(const QString& title);
-    void createVoronoiMap();
-    void createServersLinks();
-    void fillDistanceArray();
+    /**
+     * @brief cancelLoading stops the current background load and discards its world.
+     */
+    void cancelLoading();
+    /**
+     * @brief setTimeScale changes the speed of the simulation and checks the matching action.
+     * @param scale 0 to pause, scaleMax for the maximum speed
+     */
+    void setTimeScale(qreal scale);
+    /**
+     * @brief startRepair recomputes the routes without the failed elements on a worker thread.
+     */
+    void startRepair();
+    void cancelRepair();
+    /**
+     * @brief showReroute wakes the rerouted drones and reports the reroute time.
+     */
+    void showReroute(const QString &element,int nDrones);
+    void stopRecording();
+    void stopReplay();
+    void replayStep();
+    /**
+     * @brief drainRecorder writes the frames published since the last call in the log.
+     */
+    void drainRecorder();
 
     Ui::MainWindow *ui;
     QVector<QVector<float>> distanceArray;
+    ContractionHierarchy *router=nullptr; ///< next hops of the large maps, see Drone::router
+    RoomGrid *roomGrid=nullptr; ///< location of the drones, see Drone::roomGrid
+    // background loading of a scenario
+    QFutureWatcher<World*> *loadWatcher=nullptr;
+    World *spareWorld=nullptr; ///< previous scenario after a load, its buffers are reused by the next one
+    QProgressDialog *loadProgress=nullptr;
+    // failures and background repair of the routes
+    Failover failover;
+    RoutingRepair *repair=nullptr;
+    QFutureWatcher<void> *repairWatcher=nullptr;
+    bool repairAgain=false; ///< the failures have changed during the repair
+    // continuous delivery
+    Dispatcher dispatcher;
+    bool dispatching=false;
+    qreal missionRate=0; ///< missions submitted per simulated minute
+    qreal missionCarry=0; ///< fraction of mission not yet submitted
+    QRandomGenerator missionRng{42};
 
     // to animate drones
-    QTimer *timer;
-    QElapsedTimer elapsedTimer;
+    QTimer *timer=nullptr; ///< simulation steps
+    QTimer *renderTimer=nullptr; ///< display refresh, independent of the simulation
+    SimulationClock simClock; ///< simulation time, scaled and split in sub-steps
+    qint64 lastStepTime=0; ///< simulation time of the last published state (ms)
+    // frame pacing counter
+    QElapsedTimer pacingTimer;
+    int simSteps=0;
+    bool separationEnabled=false; ///< drone-drone avoidance
+    SpatialHash droneHash; ///< neighbours of the drones, rebuilt at each step
+    bool spatialOrder=false; ///< Hilbert order of the servers, triangles and separation queries
+    bool eventDriven=false; ///< drones moved by eventSim instead of a full step
+    EventSimulation eventSim;
+    // drone states published after each step, read by the canvas, the recorder and the metrics
+    TelemetryRing telemetry;
+    TelemetryReader metricsReader{&telemetry};
+    TelemetryFrame metricsFrame,metricsPrevious;
+    int movingDrones=0;
+    SharedWorldWriter *sharedWorld=nullptr; ///< export for the external viewers, null if disabled
+    // trajectory recording and replay
+    TrajectoryWriter *recorder=nullptr;
+    TrajectoryIndexBuilder recorderIndex; ///< index of the log, built along the recording
+    QString recordFile;
+    TelemetryReader *recorderReader=nullptr;
+    TelemetryFrame recorderFrame;
+    qint64 recordStart=0; ///< simulation time at the start of the recording (ms)
+    TrajectoryReader *replay=nullptr; ///< not null in replay mode
+    QElapsedTimer replayClock;
+    qint64 replayOffset=0; ///< replay time - replayClock time (ms)
+    QVector<DroneSample> replaySamples;
 };
 #endif // MAINWINDOW_H
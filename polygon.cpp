@@ -1,23 +1,61 @@
 #include "polygon.h"
 #include <QDebug>
-#include <QStack>
-
-bool polarComparison(Vector2D P1,Vector2D P2) {
-    double a1 = asin(P1.y/sqrt(P1.x*P1.x+P1.y*P1.y));
-    if (P1.x<0.0) a1=M_PI-a1;
-    double a2 = asin(P2.y/sqrt(P2.x*P2.x+P2.y*P2.y));
-    if (P2.x<0.0) a2=M_PI-a2;
-    return a1<a2;
+#include <QVarLengthArray>
+#include <numeric>
+
+bool inCircumcircle(const Vector2D &a,const Vector2D &b,const Vector2D &c,const Vector2D &d) {
+    if (d==a || d==b || d==c) return false;
+    {
+        // usual case: the sign is far above the rounding errors
+        const double adx=a.x-double(d.x),ady=a.y-double(d.y);
+        const double bdx=b.x-double(d.x),bdy=b.y-double(d.y);
+        const double cdx=c.x-double(d.x),cdy=c.y-double(d.y);
+        const double ad=adx*adx+ady*ady,bd=bdx*bdx+bdy*bdy,cd=cdx*cdx+cdy*cdy;
+        const double det=ad*(bdx*cdy-bdy*cdx)+bd*(ady*cdx-adx*cdy)+cd*(adx*bdy-ady*bdx);
+        const double bound=1e-12*(ad*(fabs(bdx*cdy)+fabs(bdy*cdx))+bd*(fabs(ady*cdx)+fabs(adx*cdy))+cd*(fabs(adx*bdy)+fabs(ady*bdx)));
+        if (det>bound) return true;
+        if (det<-bound) return false;
+    }
+    // the 4 sites in (x,y) order: the result only depends on the set of sites and the parity
+    const Vector2D *q[4]={&a,&b,&c,&d};
+    bool odd=false;
+    for (int i=1; i<4; i++) {
+        for (int j=i; j>0 && (q[j]->x!=q[j-1]->x?q[j]->x<q[j-1]->x:q[j]->y<q[j-1]->y); j--) {
+            std::swap(q[j],q[j-1]);
+            odd=!odd;
+        }
+    }
+    auto orient=[](const Vector2D *u,const Vector2D *v,const Vector2D *w) {
+        return (double(v->x)-u->x)*(double(w->y)-u->y)-(double(v->y)-u->y)*(double(w->x)-u->x);
+    };
+    const double dx=q[3]->x,dy=q[3]->y;
+    const double adx=q[0]->x-dx,ady=q[0]->y-dy;
+    const double bdx=q[1]->x-dx,bdy=q[1]->y-dy;
+    const double cdx=q[2]->x-dx,cdy=q[2]->y-dy;
+    const double ad=adx*adx+ady*ady,bd=bdx*bdx+bdy*bdy,cd=cdx*cdx+cdy*cdy;
+    double det=ad*(bdx*cdy-bdy*cdx)+bd*(ady*cdx-adx*cdy)+cd*(adx*bdy-ady*bdx);
+    // cocircular sites: each lifted site is raised by an infinitesimal, the largest for the
+    // first site, the sign is given by the derivative of the first site that changes it
+    if (det==0) det=orient(q[3],q[1],q[2]);
+    if (det==0) det=orient(q[3],q[2],q[0]);
+    if (det==0) det=orient(q[3],q[0],q[1]);
+    if (det==0) det=-orient(q[0],q[1],q[2]);
+    return odd?det<0:det>0;
 }
 
 Polygon::Polygon(QVector<Vector2D> &points) {
+    QVector<Vector2D> work;
+    setConvexHull(points,work);
+}
+
+void Polygon::setConvexHull(QVector<Vector2D> &points,QVector<Vector2D> &work) {
     assert(points.size()>3);
     auto p=points.begin();
     auto pymin=points.begin();
 
-    // find point with minimal y and swap with first point
+    // find point with minimal y (then minimal x) and swap with first point
     while (p!=points.end()) {
-        if (p->y<pymin->y) {
+        if (p->y<pymin->y || (p->y==pymin->y && p->x<pymin->x)) {
             pymin=p;
         }
         p++;
@@ -25,45 +63,41 @@ Polygon::Polygon(QVector<Vector2D> &points) {
     // swap
     if (pymin!=points.begin()) std::iter_swap(points.begin(), pymin);
 
-    Vector2D origin(points.begin()->x,points.begin()->y);
-    // copy points in a set of points relative to points[0]
-    QVector<Vector2D> pointsRelative;
+    const Vector2D origin=points.first();
+    work.clear();
     for (auto pOrig:points) {
-        pointsRelative.push_back(Vector2D(pOrig.x-origin.x,pOrig.y-origin.y));
+        work.push_back(pOrig);
     }
 
-    // sorting point with angular criteria
-    std::sort(pointsRelative.begin()+1,
-              pointsRelative.end(),polarComparison);
-
-    QStack<Vector2D*> CHstack;
-    Vector2D *top_1,*top;
-    CHstack.push(&pointsRelative[0]);
-    CHstack.push(&pointsRelative[1]);
-    CHstack.push(&pointsRelative[2]);
-
-    auto pi=pointsRelative.begin()+3;
-    while (pi!=pointsRelative.end()) {
-        top = CHstack.top();
-        CHstack.pop();
-        top_1 = CHstack.top();
-        CHstack.push(top);
-        while (!isOnTheLeft(&(*pi),top_1,top)) {
-            CHstack.pop();
-            // update values of top and top_1
-            top = CHstack.top();
-            CHstack.pop();
-            top_1 = CHstack.top();
-            CHstack.push(top);
+    // sorting point with angular criteria around the origin, the nearest first on a same ray;
+    // the differences are computed in double, the vertices keep their exact coordinates
+    auto cross=[](const Vector2D &A,const Vector2D &B,const Vector2D &P) {
+        return (double(B.x)-A.x)*(double(P.y)-A.y)-(double(B.y)-A.y)*(double(P.x)-A.x);
+    };
+    std::sort(work.begin()+1,work.end(),[&origin,&cross](const Vector2D &P1,const Vector2D &P2) {
+        const double c=cross(origin,P1,P2);
+        if (c!=0) return c>0;
+        const double d1=(double(P1.x)-origin.x)*(double(P1.x)-origin.x)+(double(P1.y)-origin.y)*(double(P1.y)-origin.y);
+        const double d2=(double(P2.x)-origin.x)*(double(P2.x)-origin.x)+(double(P2.y)-origin.y)*(double(P2.y)-origin.y);
+        return d1<d2;
+    });
+
+    // Graham scan, the stack is the beginning of the work array;
+    // collinear points are not kept, they are inserted in the triangles of the hull
+    int top=1;
+    for (int i=1; i<work.size(); i++) {
+        const Vector2D pi=work[i];
+        while (top>=2 && cross(work[top-2],work[top-1],pi)<=0) {
+            top--;
         }
-        CHstack.push(&(*pi));
-        pi++;
+        work[top++]=pi;
     }
 
-    // get stack points to create current polygon
-    while (!CHstack.empty()) {
-        tabPts.push_front(*(CHstack.top())+origin);
-        CHstack.pop();
+    // stack points from the bottom create the current polygon
+    tabPts.clear();
+    triangles.clear();
+    for (int i=0; i<top; i++) {
+        tabPts.push_back(work[i]);
     }
     tabPts.push_back(tabPts[0]);// polygon propriety (N+1 vertices with P_N=P_0)
     triangulate();
@@ -90,15 +124,14 @@ void Polygon::draw(QPainter &painter) const {
     pen.setWidth(3);
     ///< use the drawPolygon method of QPainter
     auto N=tabPts.size();
-    QPoint *points=new QPoint[N];
+    QVarLengthArray<QPoint,64> points(N); // on the stack for usual cells
     for (int i=0; i<N; i++) {
         points[i].setX(tabPts[i].x);
         points[i].setY(tabPts[i].y);
     }
     painter.setPen(pen);
 
-    painter.drawPolygon(points,N,Qt::OddEvenFill);
-    delete [] points;
+    painter.drawPolygon(points.constData(),int(N),Qt::OddEvenFill);
 
     /***********************************************************************
      * Exercise 1 — Doors (Geometry)
@@ -160,33 +193,37 @@ QPair<Vector2D,Vector2D> Polygon::getBoundingBox() const {
     return QPair<Vector2D,Vector2D>(min,max);
 }
 
+void Polygon::restore(const QVector<Vector2D> &points,const QVector<Triangle> &p_triangles) {
+    tabPts.clear();
+    for (auto &pt:points) tabPts.push_back(pt);
+    if (!tabPts.empty()) tabPts.push_back(tabPts[0]);
+    triangles.clear();
+    for (auto &t:p_triangles) triangles.push_back(t);
+}
+
 void Polygon::triangulate() {
-    /// @todo write the code
-    /// 1. Copy the poly polygon in a temporary version (tmp)
-    Polygon tmp(*this);
-    QList<Vector2D*> pointListPtr;
+    /// 1. Work on the indices of the remaining vertices (on the stack for the usual cells)
+    auto N=nbVertices();
+    QVarLengthArray<int,64> remaining(N);
+    std::iota(remaining.begin(),remaining.end(),0);
 
     /// 2. search a first consecutive group of three vertices that check:
     /// - CCW oriented
     /// - does not contain any other vertex
     int i=0;
-    auto N=tmp.nbVertices();
     while (N>=3) {
-        Triangle t(tmp[i%N],tmp[(i+1)%N],tmp[(i+2)%N]);
-        // fill the list (pointListPtr) with all the vertices of the polygon
-        // but the vertices of the triangle.
-        pointListPtr.clear();
-        for (int j=0; j<N; j++) {
-            if (j!=i && j!=(i+1)%N && j!=(i+2)%N) {
-                pointListPtr.push_back(&(tmp.tabPts[j]));
-            }
+        const int i1=(i+1)%N,i2=(i+2)%N;
+        Triangle t(tabPts[remaining[i%N]],tabPts[remaining[i1]],tabPts[remaining[i2]]);
+        bool isEar=t.isCCW();
+        for (int j=0; j<N && isEar; j++) {
+            if (j!=i && j!=i1 && j!=i2 && t.contains(tabPts[remaining[j]])) isEar=false;
         }
 
-        if (t.isCCW() && !t.containsOneOf(pointListPtr)) {
+        if (isEar) {
             /// 3. add the triangle in the list
             triangles.push_back(t);
-            /// 4. remove middle vertex from the tmp polygon
-            tmp.remove((i+1)%N);
+            /// 4. remove middle vertex from the remaining ones
+            remaining.remove(i1);
             N--;
         } else {
             i=(i+1)%N;
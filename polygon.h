@@ -11,6 +11,71 @@
 #include <QPainter>
 #include <QDebug>
 
+/**
+ * @brief Read-only view of contiguous elements owned by another object,
+ * valid until the owner is modified. Nothing is copied nor allocated.
+ */
+template <typename T>
+class ConstSpan {
+public:
+    ConstSpan(const T *p_data,int p_size):ptr(p_data),count(p_size) {}
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr+count; }
+    const T& operator[](int i) const { return ptr[i]; }
+    const T* data() const { return ptr; }
+    int size() const { return count; }
+    bool isEmpty() const { return count==0; }
+private:
+    const T *ptr;
+    int count;
+};
+
+/**
+ * @brief Edge P_iP_{i+1} of a closed line of vertices, refers to its two vertices.
+ */
+struct EdgeView {
+    const Vector2D &first;
+    const Vector2D &second;
+    QPair<Vector2D,Vector2D> toPair() const { return {first,second}; }
+};
+
+/**
+ * @brief The EdgeRange class iterates the edges of N+1 vertices whose last one
+ * closes the line (P_N=P_0), as stored by Polygon.
+ */
+class EdgeRange {
+public:
+    class Iterator {
+    public:
+        explicit Iterator(const Vector2D *p_p):p(p_p) {}
+        EdgeView operator*() const { return {p[0],p[1]}; }
+        Iterator& operator++() { p++; return *this; }
+        bool operator!=(const Iterator &it) const { return p!=it.p; }
+    private:
+        const Vector2D *p;
+    };
+    /**
+     * @param p_pts N+1 vertices
+     * @param p_nbEdges N
+     */
+    EdgeRange(const Vector2D *p_pts,int p_nbEdges):pts(p_pts),nbEdges(p_nbEdges) {}
+    Iterator begin() const { return Iterator(pts); }
+    Iterator end() const { return Iterator(pts+nbEdges); }
+    int size() const { return nbEdges; }
+private:
+    const Vector2D *pts;
+    int nbEdges;
+};
+
+/**
+ * @brief inCircumcircle tells if d is strictly inside the circumcircle of the CCW triangle abc.
+ * A site on the circle is decided by a symbolic perturbation of the sites ranked by (x,y),
+ * so the Delaunay builders choose the same diagonal between cocircular sites (exact for
+ * integer coordinates).
+ * @return false for a vertex of abc.
+ */
+bool inCircumcircle(const Vector2D &a,const Vector2D &b,const Vector2D &c,const Vector2D &d);
+
 /**
  * @brief The Triangle class stores 3 pointers to existing Vector2D vertices.
  * It is used by the Polygon class to create a set of internal triangles.
@@ -47,7 +112,13 @@ public:
      * @param i
      * @return vertex #i coordinates.
      */
-    Vector2D operator[](int i) const { return tabPts[i]; }
+    const Vector2D& operator[](int i) const { return tabPts[i]; }
+    ConstSpan<Vector2D> vertices() const { return {tabPts,3}; }
+    /**
+     * @brief edge gives the edge P_iP_{i+1} without copying its vertices.
+     * @param i the number of the edge (0..2)
+     */
+    EdgeView edge(int i) const { return {tabPts[i],tabPts[(i+1)%3]}; }
     /**
      * @brief isCCW: equivalent to check if the third point
      * is on the left of the first edge
@@ -147,21 +218,12 @@ public:
                (tabPts[1]==other.tabPts[0] || tabPts[1]==other.tabPts[1] || tabPts[1]==other.tabPts[2]) &&
                (tabPts[2]==other.tabPts[0] || tabPts[2]==other.tabPts[1] || tabPts[2]==other.tabPts[2]);
     }
+    /**
+     * @brief circleContains
+     * @return true if M is not strictly inside the circumcircle (the vertices are not inside).
+     */
     bool circleContains(const Vector2D&M) {
-        Matrix33 mat;
-        Vector2D A = tabPts[0];
-        Vector2D B = tabPts[1];
-        Vector2D C = tabPts[2];
-        mat.m[0][0] = (A.x - M.x);
-        mat.m[0][1] = (A.y - M.y);
-        mat.m[0][2] = (A.x*A.x-M.x*M.x)+(A.y*A.y-M.y*M.y);
-        mat.m[1][0] = (B.x - M.x);
-        mat.m[1][1] = (B.y - M.y);
-        mat.m[1][2] = (B.x*B.x-M.x*M.x)+(B.y*B.y-M.y*M.y);
-        mat.m[2][0] = (C.x - M.x);
-        mat.m[2][1] = (C.y - M.y);
-        mat.m[2][2] = (C.x*C.x-M.x*M.x)+(C.y*C.y-M.y*M.y);
-        return mat.determinant()<=0; // positive for outside points and equal for A,B,C
+        return !inCircumcircle(tabPts[0],tabPts[1],tabPts[2],M);
     }
     Vector2D getCenter() const {
         return circumCenter;
@@ -208,10 +270,23 @@ private:
     QVector<Triangle> triangles; ///< array of triangles for the triangulation process
 public:
     /**
-     * @brief Constructor of a polygon.
+     * @brief Constructor of the triangulated convex hull of a set of points.
      */
     Polygon(QVector<Vector2D> &points);
     Polygon() {}
+    /**
+     * @brief setConvexHull replaces the polygon by the triangulated convex hull of a set of points.
+     * @param points at least 4 points, the lowest one is moved to the front
+     * @param work buffer of the Graham scan, kept by the caller between the calls
+     */
+    void setConvexHull(QVector<Vector2D> &points,QVector<Vector2D> &work);
+    /**
+     * @brief clear removes the vertices and the triangles, their buffers are kept for the next use.
+     */
+    void clear() {
+        tabPts.clear();
+        triangles.clear();
+    }
     void remove(int i) {
         assert(i>=0 && i<tabPts.size()-1);
         tabPts.removeAt(i);
@@ -233,10 +308,25 @@ public:
     void addVertex(const Vector2D &v) {
         addVertex(v.x,v.y);
     }
-    QPair<Vector2D,Vector2D> getEdge(int i) {
+    QPair<Vector2D,Vector2D> getEdge(int i) const {
+        return edge(i).toPair();
+    }
+    /**
+     * @brief edge gives the edge P_iP_{i+1} without copying its vertices.
+     * @param i the number of the edge, modulo nbVertices()
+     */
+    EdgeView edge(int i) const {
         i=i%nbVertices();
         return {tabPts[i],tabPts[i+1]};
     }
+    /**
+     * @brief edges iterates the nbVertices() edges of the polygon in order.
+     */
+    EdgeRange edges() const { return EdgeRange(tabPts.constData(),nbVertices()); }
+    /**
+     * @brief vertices gives the N vertices without the duplicated last one.
+     */
+    ConstSpan<Vector2D> vertices() const { return {tabPts.constData(),nbVertices()}; }
     /**
      * @brief return the boundig box coordinates of the polygon
      * @return The first vector is the left bottom corner and the second vector is the right top corner of the box.
@@ -248,7 +338,7 @@ public:
      * @param n number of vertices in the array.
      * @return a read-only version of the array of vertices.
      */
-    Vector2D operator[](int i) const { return tabPts[i]; }
+    const Vector2D& operator[](int i) const { return tabPts[i]; }
     /**
      * @brief Draw the polygon.
      * @param painter Current painter context.
@@ -257,9 +347,17 @@ public:
      */
     void draw(QPainter &painter) const;
     /**
-     * @brief triangulate the polygon and store triangles in "triangles" array.
+     * @brief triangulate the polygon and add the triangles to the "triangles" array,
+     * without allocation for the usual cells (at most 64 vertices).
      */
     void triangulate();
+    /**
+     * @brief restore sets vertices and triangles computed before (cache of the cells),
+     * no clipping nor triangulation is done. They are copied in the current buffers.
+     * @param points the N vertices (first one not duplicated)
+     * @param p_triangles triangulation of the polygon
+     */
+    void restore(const QVector<Vector2D> &points,const QVector<Triangle> &p_triangles);
 
     /**
      * @brief isOnTheLeft
@@ -304,9 +402,10 @@ public:
         }
         return (itV!=tabPts.end());
     }
-    QVector<Triangle> getTriangles() {
+    const QVector<Triangle>& getTriangles() const {
         return triangles;
     }
+    ConstSpan<Triangle> triangleSpan() const { return {triangles.constData(),int(triangles.size())}; }
     /**
      * @brief area
      * @return the surface of a polygon
@@ -0,0 +1,283 @@
+#include "roomgrid.h"
+#include "serveranddrone.h"
+#include <QtConcurrent>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <trace.h>
+
+namespace {
+
+const qint32 noRoom=-1; ///< no server cell overlaps this raster cell
+const char gridMagic[4]={'D','R','R','G'};
+const quint32 gridFormatVersion=1;
+const qint64 parallelMinCells=1<<16; ///< smaller rasters cost less than a dispatch to the pool
+
+/**
+ * @brief Grid file: header, cells (nCols x nRows), boundaryStart (nBoundary+1)
+ * and candidates (nCandidates), all qint32.
+ */
+struct GridHeader {
+    char magic[4];
+    quint32 formatVersion;
+    quint32 nServers;
+    qint32 originX,originY;
+    float cellSize;
+    quint32 nCols,nRows;
+    quint32 nBoundary;
+    quint32 nCandidates;
+};
+
+enum Overlap { Outside, Crossing, Inside };
+
+/**
+ * @brief classify compares a raster cell with a convex polygon (separating axis theorem).
+ * @param pts vertices of the polygon, counter clockwise
+ * @param x0,y0,x1,y1 the raster cell
+ * @return Inside if the cell is in the interior of the polygon, Outside if they are separated.
+ */
+Overlap classify(const QVector<Vector2D> &pts,double x0,double y0,double x1,double y1) {
+    const double cx[4]={x0,x1,x1,x0};
+    const double cy[4]={y0,y0,y1,y1};
+    bool inside=true;
+    const int n=pts.size();
+    for (int i=0; i<n; i++) {
+        const Vector2D &a=pts[i];
+        const Vector2D &b=pts[(i+1)%n];
+        const double ex=b.x-a.x,ey=b.y-a.y;
+        int nLeft=0,nRight=0;
+        for (int k=0; k<4; k++) {
+            const double c=ex*(cy[k]-a.y)-ey*(cx[k]-a.x);
+            if (c>0) nLeft++;
+            else if (c<0) nRight++;
+        }
+        if (nRight==4) return Outside; // the edge separates the cell
+        if (nLeft<4) inside=false;
+    }
+    return inside?Inside:Crossing;
+}
+
+} // namespace
+
+RoomGrid::~RoomGrid() {
+    clear();
+}
+
+void RoomGrid::clear() {
+    delete file; // unmaps
+    file=nullptr;
+    tabCells.clear();
+    tabBoundaryStart.clear();
+    tabCandidates.clear();
+    cells=boundaryStart=candidates=nullptr;
+    nCols=nRows=nServers=nBoundary=0;
+    cellSize=0;
+}
+
+void RoomGrid::setOwnedData() {
+    cells=tabCells.constData();
+    boundaryStart=tabBoundaryStart.constData();
+    candidates=tabCandidates.constData();
+}
+
+void RoomGrid::build(const QList<Server> &servers,const QPoint &origin,const QSize &size,qreal p_cellSize) {
+    TRACE_SCOPE("roomGrid");
+    clear();
+    if (p_cellSize<=0 || size.isEmpty()) return;
+    gridOrigin=origin;
+    cellSize=p_cellSize;
+    nCols=int(std::ceil(size.width()/cellSize));
+    nRows=int(std::ceil(size.height()/cellSize));
+    nServers=servers.size();
+
+    // counter clockwise vertices of the cells, and servers overlapping each row;
+    // the arrays of the previous build keep their capacity
+    polygons.resize(nServers);
+    rowServers.resize(nRows);
+    for (auto &list:rowServers) list.clear();
+    columnRange.resize(nServers);
+    for (int i=0; i<nServers; i++) {
+        const Polygon &area=servers[i].area;
+        const int n=area.nbVertices();
+        QVector<Vector2D> &pts=polygons[i];
+        if (n<3) {
+            pts.clear();
+            columnRange[i]={0,-1};
+            continue;
+        }
+        pts.resize(n);
+        double xmin=area[0].x,xmax=xmin,ymin=area[0].y,ymax=ymin,doubleArea=0;
+        for (int k=0; k<n; k++) {
+            pts[k]=area[k];
+            const Vector2D &b=area[(k+1)%n];
+            doubleArea+=double(pts[k].x)*b.y-double(b.x)*pts[k].y;
+            xmin=qMin(xmin,double(pts[k].x));
+            xmax=qMax(xmax,double(pts[k].x));
+            ymin=qMin(ymin,double(pts[k].y));
+            ymax=qMax(ymax,double(pts[k].y));
+        }
+        if (doubleArea<0) std::reverse(pts.begin(),pts.end());
+        const int r0=qMax(0,int(std::floor((ymin-origin.y())/cellSize)));
+        const int r1=qMin(nRows-1,int(std::floor((ymax-origin.y())/cellSize)));
+        columnRange[i]={qMax(0,int(std::floor((xmin-origin.x())/cellSize))),
+                          qMin(nCols-1,int(std::floor((xmax-origin.x())/cellSize)))};
+        for (int r=r0; r<=r1; r++) rowServers[r].append(i);
+    }
+
+    // rows are independent, each one writes its own part of the raster
+    tabCells.resize(qint64(nCols)*nRows);
+    qint32 *raster=tabCells.data();
+    rowOverlaps.resize(nRows);
+    auto rasterizeRow=[&](int r) {
+        qint32 *row=raster+qint64(r)*nCols;
+        QVector<QPair<qint32,qint32>> &overlaps=rowOverlaps[r];
+        std::fill(row,row+nCols,noRoom);
+        overlaps.clear();
+        const double y0=origin.y()+r*cellSize,y1=y0+cellSize;
+        for (qint32 i:rowServers[r]) {
+            for (int c=columnRange[i].first; c<=columnRange[i].second; c++) {
+                const double x0=origin.x()+c*cellSize;
+                switch (classify(polygons[i],x0,y0,x0+cellSize,y1)) {
+                case Inside: row[c]=i; break;
+                case Crossing: overlaps.append({c,i}); break;
+                case Outside: break;
+                }
+            }
+        }
+        std::sort(overlaps.begin(),overlaps.end());
+    };
+    if (qint64(nCols)*nRows>=parallelMinCells) {
+        rowOrder.resize(nRows);
+        std::iota(rowOrder.begin(),rowOrder.end(),0);
+        QtConcurrent::blockingMap(rowOrder,rasterizeRow);
+    } else {
+        for (int r=0; r<nRows; r++) rasterizeRow(r);
+    }
+
+    // boundary cells numbered in raster order, candidates in server order
+    tabBoundaryStart.append(0);
+    for (int r=0; r<nRows; r++) {
+        const QVector<QPair<qint32,qint32>> &overlaps=rowOverlaps[r];
+        qint32 *dst=raster+qint64(r)*nCols;
+        for (int k=0; k<overlaps.size();) {
+            const int c=overlaps[k].first;
+            if (dst[c]!=noRoom) { // inside a cell: touching neighbours are ignored
+                while (k<overlaps.size() && overlaps[k].first==c) k++;
+                continue;
+            }
+            dst[c]=-2-nBoundary;
+            while (k<overlaps.size() && overlaps[k].first==c) {
+                tabCandidates.append(overlaps[k].second);
+                k++;
+            }
+            tabBoundaryStart.append(tabCandidates.size());
+            nBoundary++;
+        }
+    }
+    setOwnedData();
+}
+
+Server* RoomGrid::locate(const Vector2D &p,QList<Server> &servers) const {
+    const double fx=(p.x-gridOrigin.x())/cellSize;
+    const double fy=(p.y-gridOrigin.y())/cellSize;
+    if (cells==nullptr || !(fx>=0 && fx<nCols && fy>=0 && fy<nRows)) {
+        auto it=servers.begin();
+        while (it!=servers.end() && !it->area.contains(p)) {
+            it++;
+        }
+        return it!=servers.end()?&(*it):nullptr;
+    }
+    const qint32 v=cells[qint64(fy)*nCols+qint64(fx)];
+    if (v>=0) return &servers[v];
+    if (v==noRoom) return nullptr;
+    const int k=-2-v;
+    for (int j=boundaryStart[k]; j<boundaryStart[k+1]; j++) {
+        Server &s=servers[candidates[j]];
+        if (s.area.contains(p)) return &s;
+    }
+    return nullptr;
+}
+
+bool RoomGrid::save(const QString &path) const {
+    if (isEmpty()) return false;
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    GridHeader header;
+    memcpy(header.magic,gridMagic,4);
+    header.formatVersion=gridFormatVersion;
+    header.nServers=nServers;
+    header.originX=gridOrigin.x();
+    header.originY=gridOrigin.y();
+    header.cellSize=float(cellSize);
+    header.nCols=nCols;
+    header.nRows=nRows;
+    header.nBoundary=nBoundary;
+    header.nCandidates=boundaryStart[nBoundary];
+    out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    out.write(reinterpret_cast<const char*>(cells),qint64(nCols)*nRows*sizeof(qint32));
+    out.write(reinterpret_cast<const char*>(boundaryStart),(qint64(nBoundary)+1)*sizeof(qint32));
+    out.write(reinterpret_cast<const char*>(candidates),qint64(header.nCandidates)*sizeof(qint32));
+    return out.commit();
+}
+
+bool RoomGrid::map(const QString &path,int p_nServers,const QPoint &origin,const QSize &size,qreal p_cellSize) {
+    TRACE_SCOPE("mapRoomGrid");
+    clear();
+    QFile *in=new QFile(path);
+    GridHeader header;
+    const uchar *data=nullptr;
+    if (in->open(QIODevice::ReadOnly) && in->size()>=qint64(sizeof(header))) {
+        data=in->map(0,in->size());
+    }
+    if (data==nullptr) {
+        delete in;
+        return false;
+    }
+    memcpy(&header,data,sizeof(header));
+    const qint64 nCells=qint64(header.nCols)*header.nRows;
+    const qint64 expected=qint64(sizeof(header))+
+                          (nCells+header.nBoundary+1+qint64(header.nCandidates))*sizeof(qint32);
+    if (memcmp(header.magic,gridMagic,4)!=0 || header.formatVersion!=gridFormatVersion ||
+        header.nServers!=quint32(p_nServers) || header.originX!=origin.x() || header.originY!=origin.y() ||
+        header.cellSize!=float(p_cellSize) ||
+        header.nCols!=quint32(std::ceil(size.width()/p_cellSize)) ||
+        header.nRows!=quint32(std::ceil(size.height()/p_cellSize)) || in->size()!=expected) {
+        delete in;
+        return false;
+    }
+    // the offsets are multiples of 4: the tables are read in place
+    const qint32 *tabC=reinterpret_cast<const qint32*>(data+sizeof(header));
+    const qint32 *tabB=tabC+nCells;
+    const qint32 *tabK=tabB+header.nBoundary+1;
+
+    // a corrupted file must not index outside the servers
+    bool valid=tabB[0]==0 && tabB[header.nBoundary]==qint32(header.nCandidates);
+    for (quint32 k=0; valid && k<header.nBoundary; k++) valid=tabB[k]<=tabB[k+1];
+    for (quint32 j=0; valid && j<header.nCandidates; j++) valid=tabK[j]>=0 && tabK[j]<p_nServers;
+    for (qint64 i=0; valid && i<nCells; i++) {
+        valid=tabC[i]<p_nServers && tabC[i]>=-2-qint64(header.nBoundary)+1;
+    }
+    if (!valid) {
+        qWarning() << "Invalid room grid:" << path;
+        delete in;
+        return false;
+    }
+    file=in;
+    gridOrigin=origin;
+    cellSize=p_cellSize;
+    nCols=header.nCols;
+    nRows=header.nRows;
+    nServers=p_nServers;
+    nBoundary=header.nBoundary;
+    cells=tabC;
+    boundaryStart=tabB;
+    candidates=tabK;
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef ROOMGRID_H
+#define ROOMGRID_H
+
+#include <QList>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "vector2d.h"
+
+class Server;
+class QFile;
+
+/**
+ * @brief The RoomGrid class locates the server of a position with a raster of
+ * the window. A cell entirely inside a Voronoi cell stores the server id and is
+ * answered by a single array read; only the cells crossed by a boundary keep
+ * the short list of the servers overlapping them, tested exactly.
+ * The cells are classified with a separating axis test against the convex
+ * Voronoi cells, rows are built in parallel.
+ * The raster can be saved beside the world cache and mapped back without copy.
+ * A new build() of a grid of the same size reuses the arrays of the previous one.
+ * Positions outside the window fall back to a scan of all the servers.
+ */
+class RoomGrid {
+public:
+    RoomGrid()=default;
+    ~RoomGrid();
+    RoomGrid(const RoomGrid&)=delete;
+    RoomGrid& operator=(const RoomGrid&)=delete;
+
+    /**
+     * @brief build rasterizes the cells of the servers.
+     * @param servers servers with their Voronoi cell, the id of a server is its index
+     * @param origin window origin
+     * @param size window size
+     * @param p_cellSize side of a raster cell
+     */
+    void build(const QList<Server> &servers,const QPoint &origin,const QSize &size,qreal p_cellSize);
+    /**
+     * @brief save writes the raster in a file that map() can read.
+     * @return false on a write error.
+     */
+    bool save(const QString &path) const;
+    /**
+     * @brief map uses a raster saved by save(), the file stays mapped while the grid is used.
+     * @param path file written by save()
+     * @param nServers number of servers of the world
+     * @param origin window origin
+     * @param size window size
+     * @param p_cellSize expected cell size
+     * @return false if the file is missing or does not match the world.
+     */
+    bool map(const QString &path,int nServers,const QPoint &origin,const QSize &size,qreal p_cellSize);
+    void clear();
+    bool isEmpty() const { return nCols==0 || nRows==0; }
+    /**
+     * @brief locate finds the server whose cell contains a position.
+     * @param p position
+     * @param servers servers given to build()
+     * @return the first server containing p in the list order, nullptr if none.
+     */
+    Server* locate(const Vector2D &p,QList<Server> &servers) const;
+
+    int getColumns() const { return nCols; }
+    int getRows() const { return nRows; }
+    qreal getCellSize() const { return cellSize; }
+    int getBoundaryCellCount() const { return nBoundary; }
+private:
+    void setOwnedData();
+
+    QPoint gridOrigin;
+    qreal cellSize=0;
+    int nCols=0,nRows=0;
+    int nServers=0;
+    int nBoundary=0;
+    /**
+     * @brief cells: server id, noRoom, or -2-k for the k-th boundary cell
+     * whose candidates are candidates[boundaryStart[k]..boundaryStart[k+1]).
+     */
+    const qint32 *cells=nullptr;
+    const qint32 *boundaryStart=nullptr;
+    const qint32 *candidates=nullptr;
+    // storage of a built grid
+    QVector<qint32> tabCells,tabBoundaryStart,tabCandidates;
+    // buffers of build(), kept for the next one
+    QVector<QVector<Vector2D>> polygons; ///< counter clockwise vertices of each cell
+    QVector<QVector<qint32>> rowServers; ///< servers overlapping each row
+    QVector<QPair<int,int>> columnRange; ///< columns overlapped by each cell
+    QVector<QVector<QPair<qint32,qint32>>> rowOverlaps; ///< (column,server) of the crossed cells of each row
+    QVector<int> rowOrder; ///< rows given to the parallel rasterization
+    // storage of a mapped grid
+    QFile *file=nullptr;
+};
+
+#endif // ROOMGRID_H
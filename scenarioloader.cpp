@@ -0,0 +1,405 @@
+#include "scenarioloader.h"
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+/**
+ * @brief A string token of the JSON stream, pointing inside the source buffer.
+ */
+struct Token {
+    const char *b=nullptr; ///< first character after the opening quote
+    const char *e=nullptr; ///< closing quote
+    bool escaped=false; ///< true if the string contains escape sequences
+
+    bool equals(const char *str) const {
+        const char *p=b;
+        while (p!=e && *str!='\0' && *p==*str) {
+            p++;
+            str++;
+        }
+        return p==e && *str=='\0';
+    }
+    QString toString() const;
+    void assignTo(QString &str) const;
+};
+
+QString Token::toString() const {
+    if (!escaped) return QString::fromUtf8(b,int(e-b));
+    QByteArray res;
+    res.reserve(int(e-b));
+    const char *p=b;
+    while (p<e) {
+        if (*p!='\\' || p+1>=e) {
+            res.append(*p++);
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case 'n': res.append('\n'); p++; break;
+        case 't': res.append('\t'); p++; break;
+        case 'r': res.append('\r'); p++; break;
+        case 'b': res.append('\b'); p++; break;
+        case 'f': res.append('\f'); p++; break;
+        case 'u': {
+            // BMP code point only, encoded back in UTF-8
+            uint code=0;
+            int n=0;
+            p++;
+            while (n<4 && p<e && isxdigit(uchar(*p))) {
+                code = code*16+(isdigit(uchar(*p))?*p-'0':(tolower(*p)-'a'+10));
+                p++;
+                n++;
+            }
+            res.append(QString(QChar(ushort(code))).toUtf8());
+        } break;
+        default: res.append(*p++);
+        }
+    }
+    return QString::fromUtf8(res);
+}
+
+/**
+ * @brief assignTo sets str to the token, an ASCII token is written in the buffer of str.
+ */
+void Token::assignTo(QString &str) const {
+    const qsizetype len=e-b;
+    if (escaped || std::any_of(b,e,[](char c) { return uchar(c)>=0x80; })) {
+        str=toString();
+        return;
+    }
+    if (str==QLatin1String(b,len)) return;
+    str.resize(len);
+    QChar *dst=str.data();
+    for (qsizetype i=0; i<len; i++) dst[i]=QLatin1Char(b[i]);
+}
+
+/**
+ * @brief Pull parser reading JSON tokens one by one from a memory buffer.
+ * Values that are not needed are skipped without being decoded.
+ */
+class JsonStreamReader {
+public:
+    JsonStreamReader(const char *p_begin,const char *p_end):begin(p_begin),ptr(p_begin),end(p_end) {}
+
+    bool hasFailed() const { return failed; }
+    qint64 offset() const { return ptr-begin; }
+    void skipSpaces() {
+        while (ptr<end && (*ptr==' ' || *ptr=='\n' || *ptr=='\r' || *ptr=='\t')) ptr++;
+    }
+    char peek() {
+        skipSpaces();
+        return ptr<end?*ptr:'\0';
+    }
+    bool consume(char c) {
+        skipSpaces();
+        if (ptr<end && *ptr==c) {
+            ptr++;
+            return true;
+        }
+        return false;
+    }
+    bool expect(char c) {
+        if (!consume(c)) failed=true;
+        return !failed;
+    }
+    bool readString(Token &tok) {
+        if (!expect('"')) return false;
+        tok.b=ptr;
+        tok.escaped=false;
+        while (ptr<end && *ptr!='"') {
+            if (*ptr=='\\') {
+                tok.escaped=true;
+                ptr++;
+            }
+            ptr++;
+        }
+        if (ptr>=end) {
+            failed=true;
+            return false;
+        }
+        tok.e=ptr++;
+        return true;
+    }
+    /**
+     * @brief nextMember iterates the members of an object (after the '{').
+     * @param first must be true before the first call.
+     * @param key name of the member, the reader is placed on its value.
+     * @return false at the end of the object or in case of error.
+     */
+    bool nextMember(bool &first,Token &key) {
+        if (failed || consume('}')) return false;
+        if (!first && !expect(',')) return false;
+        first=false;
+        return readString(key) && expect(':');
+    }
+    /**
+     * @brief nextElement iterates the elements of an array (after the '[').
+     * @param first must be true before the first call.
+     * @return false at the end of the array or in case of error.
+     */
+    bool nextElement(bool &first) {
+        if (failed || consume(']')) return false;
+        if (!first && !expect(',')) return false;
+        first=false;
+        return true;
+    }
+    void skipValue() {
+        Token tok;
+        bool first=true;
+        switch (peek()) {
+        case '{':
+            ptr++;
+            while (nextMember(first,tok)) skipValue();
+            break;
+        case '[':
+            ptr++;
+            while (nextElement(first)) skipValue();
+            break;
+        case '"':
+            readString(tok);
+            break;
+        default: {
+            const char *start=ptr;
+            while (ptr<end && (isalnum(uchar(*ptr)) || *ptr=='-' || *ptr=='+' || *ptr=='.')) ptr++;
+            if (ptr==start) failed=true;
+        }
+        }
+    }
+private:
+    const char *begin;
+    const char *ptr;
+    const char *end;
+    bool failed=false;
+};
+
+/**
+ * @brief parseNumber reads a decimal number at p and moves p after it.
+ */
+bool parseNumber(const char *&p,const char *e,double &value) {
+    while (p<e && *p==' ') p++;
+    bool neg=false;
+    if (p<e && (*p=='-' || *p=='+')) {
+        neg=(*p=='-');
+        p++;
+    }
+    const char *start=p;
+    double v=0;
+    while (p<e && isdigit(uchar(*p))) {
+        v=v*10+(*p-'0');
+        p++;
+    }
+    if (p<e && *p=='.') {
+        p++;
+        double f=0.1;
+        while (p<e && isdigit(uchar(*p))) {
+            v+=f*(*p-'0');
+            f*=0.1;
+            p++;
+        }
+    }
+    if (p==start) return false;
+    value=neg?-v:v;
+    while (p<e && *p==' ') p++;
+    return true;
+}
+
+/**
+ * @brief parsePair decodes a "x,y" string token without creating a QString.
+ */
+bool parsePair(const Token &tok,double &x,double &y) {
+    const char *p=tok.b;
+    if (!parseNumber(p,tok.e,x) || p>=tok.e || *p!=',') return false;
+    p++;
+    return parseNumber(p,tok.e,y) && p==tok.e;
+}
+
+/**
+ * @brief parseColor decodes "#RRGGBB" directly, named colors use QColor.
+ */
+QColor parseColor(const Token &tok) {
+    auto hex=[](char c) {
+        return isdigit(uchar(c))?c-'0':(tolower(c)-'a'+10);
+    };
+    if (!tok.escaped && tok.e-tok.b==7 && *tok.b=='#') {
+        const char *p=tok.b+1;
+        int i=0;
+        while (i<6 && isxdigit(uchar(p[i]))) i++;
+        if (i==6) {
+            return QColor(hex(p[0])*16+hex(p[1]),hex(p[2])*16+hex(p[3]),hex(p[4])*16+hex(p[5]));
+        }
+    }
+    return QColor(tok.toString());
+}
+
+/**
+ * @brief nextSlot gives the item at index: appended, or recycled from the previous
+ * load, reset to its default value but keeping the buffer of its name.
+ */
+template<class T>
+T& nextSlot(QList<T> &list,int index) {
+    if (index==list.size()) {
+        list.append(T());
+        return list.last();
+    }
+    T &item=list[index];
+    QString name;
+    name.swap(item.name);
+    item=T();
+    name.resize(0);
+    item.name.swap(name);
+    return item;
+}
+
+} // namespace
+
+void ScenarioLoader::clear() {
+    error.clear();
+    hasWindow=false;
+    spatialOrder=false;
+}
+
+bool ScenarioLoader::load(const QString &filename) {
+    clear();
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "cannot open file "+filename;
+        return false;
+    }
+    // map the file instead of copying it, fallback on a read for special files
+    const qint64 size=file.size();
+    uchar *mem = size>0?file.map(0,size):nullptr;
+    if (mem) {
+        bool res=parse(reinterpret_cast<const char*>(mem),reinterpret_cast<const char*>(mem)+size);
+        file.unmap(mem);
+        return res;
+    }
+    QByteArray data=file.readAll();
+    return parse(data.constData(),data.constData()+data.size());
+}
+
+bool ScenarioLoader::parse(const char *begin,const char *end) {
+    clear();
+    // skip UTF-8 BOM
+    if (end-begin>=3 && uchar(begin[0])==0xEF && uchar(begin[1])==0xBB && uchar(begin[2])==0xBF) begin+=3;
+
+    JsonStreamReader reader(begin,end);
+    Token key,value;
+    double x,y;
+    int nServers=0,nDrones=0;
+    bool firstRoot=true;
+    if (!reader.expect('{')) {
+        error="the JSON document is not an object";
+        return false;
+    }
+    while (reader.nextMember(firstRoot,key)) {
+        if (key.equals("window") && reader.peek()=='{') {
+            // --- Window ---
+            reader.consume('{');
+            bool first=true;
+            while (reader.nextMember(first,key)) {
+                if (key.equals("origine") && reader.peek()=='"') {
+                    reader.readString(value);
+                    if (parsePair(value,x,y)) windowOrigin=QPoint(int(x),int(y));
+                } else if (key.equals("size") && reader.peek()=='"') {
+                    reader.readString(value);
+                    if (parsePair(value,x,y)) windowSize=QSize(int(x),int(y));
+                } else {
+                    reader.skipValue();
+                }
+            }
+            hasWindow=true;
+        } else if (key.equals("hilbert")) {
+            // --- Spatial order ---
+            spatialOrder=(reader.peek()=='t');
+            reader.skipValue();
+        } else if (key.equals("servers") && reader.peek()=='[') {
+            // --- Servers ---
+            reader.consume('[');
+            bool firstElt=true;
+            while (reader.nextElement(firstElt)) {
+                if (reader.peek()!='{') {
+                    reader.skipValue();
+                    continue;
+                }
+                reader.consume('{');
+                Server &s=nextSlot(servers,nServers);
+                bool first=true;
+                while (reader.nextMember(first,key)) {
+                    if (reader.peek()!='"') {
+                        reader.skipValue();
+                    } else {
+                        reader.readString(value);
+                        if (key.equals("name")) value.assignTo(s.name);
+                        else if (key.equals("position") && parsePair(value,x,y)) s.position=QPointF(x,y);
+                        else if (key.equals("color")) s.color=parseColor(value);
+                    }
+                }
+                s.id=nServers++;
+            }
+        } else if (key.equals("drones") && reader.peek()=='[') {
+            // --- Drones ---
+            reader.consume('[');
+            bool firstElt=true;
+            while (reader.nextElement(firstElt)) {
+                if (reader.peek()!='{') {
+                    reader.skipValue();
+                    continue;
+                }
+                reader.consume('{');
+                Drone &d=nextSlot(drones,nDrones);
+                d.target=nullptr;
+                if (nDrones==pendingTargets.size()) pendingTargets.append(QString());
+                QString &target=pendingTargets[nDrones];
+                target.resize(0);
+                bool first=true;
+                while (reader.nextMember(first,key)) {
+                    if (reader.peek()!='"') {
+                        reader.skipValue();
+                    } else {
+                        reader.readString(value);
+                        if (key.equals("name")) value.assignTo(d.name);
+                        else if (key.equals("position") && parsePair(value,x,y)) d.position=Vector2D(x,y);
+                        else if (key.equals("target")) value.assignTo(target);
+                    }
+                }
+                nDrones++;
+            }
+        } else {
+            reader.skipValue();
+        }
+    }
+    // the slots left over by a larger previous scenario
+    servers.resize(nServers);
+    drones.resize(nDrones);
+    pendingTargets.resize(nDrones);
+    if (reader.hasFailed()) {
+        error=QString("JSON syntax error at offset %1").arg(reader.offset());
+        return false;
+    }
+    resolveTargets();
+    return true;
+}
+
+void ScenarioLoader::resolveTargets() {
+    // servers are complete: their addresses do not change anymore,
+    // the first server of a name (lowest id) is the target
+    byName.resize(servers.size());
+    for (int i=0; i<servers.size(); i++) byName[i]=&servers[i];
+    std::sort(byName.begin(),byName.end(),[](const Server *a,const Server *b) {
+        const int c=a->name.compare(b->name);
+        return c<0 || (c==0 && a->id<b->id);
+    });
+    for (int i=0; i<drones.size(); i++) {
+        const QString &name=pendingTargets[i];
+        auto it=std::lower_bound(byName.cbegin(),byName.cend(),name,[](const Server *s,const QString &n) {
+            return s->name.compare(n)<0;
+        });
+        drones[i].target=(it!=byName.cend() && (*it)->name==name)?*it:nullptr;
+        if (drones[i].target==nullptr) {
+            qDebug() << "error in JsonFile: bad destination name: " << name;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SCENARIOLOADER_H
+#define SCENARIOLOADER_H
+
+#include <QPoint>
+#include <QSize>
+#include <serveranddrone.h>
+
+/**
+ * @brief The ScenarioLoader class reads the window/servers/drones JSON scenarios
+ * in streaming (SAX-like) mode.
+ * The file is mapped in memory and scanned once, without building a DOM.
+ * Positions and colors are decoded directly from the bytes of the file,
+ * only the names are converted to QString.
+ * The servers and drones of the previous load are reused: a reload of a scenario
+ * of the same size keeps their buffers, names included.
+ */
+class ScenarioLoader {
+public:
+    /**
+     * @brief load a scenario file.
+     * @param filename path of the JSON file
+     * @return true if the file has been parsed, else errorString() gives the reason.
+     */
+    bool load(const QString &filename);
+    /**
+     * @brief load a scenario from a memory buffer.
+     * @param begin first byte of the buffer
+     * @param end past-the-end byte of the buffer
+     * @return true if the buffer has been parsed.
+     */
+    bool parse(const char *begin,const char *end);
+    QString errorString() const { return error; }
+
+    bool hasWindow=false; ///< true if the "window" object was found
+    QPoint windowOrigin;
+    QSize windowSize;
+    bool spatialOrder=false; ///< "hilbert": true, servers and triangles sorted along a Hilbert curve
+    QList<Server> servers; ///< servers in file order (id = index), swap them to keep the buffers
+    QList<Drone> drones; ///< drones, targets point to the servers list
+private:
+    void clear();
+    void resolveTargets();
+
+    QString error;
+    QVector<QString> pendingTargets; ///< target name of each drone, resolved at the end of the parsing
+    QVector<Server*> byName; ///< servers sorted by name then id, see resolveTargets()
+};
+
+#endif // SCENARIOLOADER_H
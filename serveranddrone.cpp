@@ -1,19 +1,128 @@
 #include "serveranddrone.h"
+#include "spatialhash.h"
+#include "contractionhierarchy.h"
+#include "roomgrid.h"
 #include <QDebug>
+#include <limits>
 
-Link::Link(Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge):
-    node1(n1),node2(n2) {
+Link::Link(Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge) {
+    set(n1,n2,edge);
+}
+
+void Link::set(Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge) {
+    node1=n1;
+    node2=n2;
     Vector2D center=0.5*(edge.first+edge.second);
     distance = (center-Vector2D(n1->position.x(),n1->position.y())).length();
     distance += (center-Vector2D(n2->position.x(),n2->position.y())).length();
     edgeCenter=QPointF(center.x,center.y);
+    occupancy=0;
+    crossings.store(0,std::memory_order_relaxed);
+    failed=false;
 }
 
 void Link::draw(QPainter &painter) {
+    if (!isUsable()) { // out of service
+        painter.save();
+        QPen pen=painter.pen();
+        pen.setStyle(Qt::DashLine);
+        pen.setColor(Qt::red);
+        painter.setPen(pen);
+        painter.drawLine(node1->position,edgeCenter);
+        painter.drawLine(node2->position,edgeCenter);
+        painter.restore();
+        return;
+    }
     painter.drawLine(node1->position,edgeCenter);
     painter.drawLine(node2->position,edgeCenter);
 }
 
+bool Drone::congestionRouting=false;
+const ContractionHierarchy *Drone::router=nullptr;
+const RoomGrid *Drone::roomGrid=nullptr;
+KpiCounters *Drone::kpi=nullptr;
+
+QPair<Link*,qreal> Drone::route(const Server *from) const {
+    if (target->failed) return {nullptr,std::numeric_limits<qreal>::infinity()};
+    QPair<Link*,qreal> r;
+    if (router) {
+        r=router->route(from->id,target->id);
+    } else {
+        if (target->id<0 || target->id>=from->bestDistance.size()) return {nullptr,0.0};
+        r=from->bestDistance[target->id];
+    }
+    if (r.first==nullptr || r.first->isUsable()) return r;
+    return backupRoute(from,r.first);
+}
+
+QPair<Link*,qreal> Drone::backupRoute(const Server *from,const Link *primary) const {
+    const qreal infinity=std::numeric_limits<qreal>::infinity();
+    if (router==nullptr) { // precomputed with the routing table
+        Link *backup=target->id<from->backupLink.size()?from->backupLink[target->id]:nullptr;
+        if (backup==nullptr || !backup->isUsable()) return {nullptr,infinity};
+        const Server *next=backup->getOther(from);
+        return {backup,backup->getDistance()+next->bestDistance[target->id].second};
+    }
+    // large maps: same loop free condition, with the distances of the hierarchy
+    const qreal here=router->distance(from->id,target->id);
+    QPair<Link*,qreal> best(nullptr,infinity);
+    for (Link *l:from->links) {
+        if (l==primary || !l->isUsable()) continue;
+        const Server *next=l->getOther(from);
+        const qreal remaining=router->distance(next->id,target->id);
+        if (remaining>=router->distance(next->id,from->id)+here) continue; // would come back
+        if (l->getDistance()+remaining<best.second) best={l,l->getDistance()+remaining};
+    }
+    return best;
+}
+
+bool Drone::reroute() {
+    if (plannedLink==nullptr || plannedLink->isUsable()) return false;
+    plannedLink->release();
+    plannedLink=nullptr;
+    Link *next=nullptr;
+    if (connectedTo!=nullptr && target!=nullptr && connectedTo!=target) {
+        next=congestionRouting?chooseLink():route(connectedTo).first;
+    }
+    if (next!=nullptr) {
+        destination=next->getEdgeCenter();
+        plannedLink=next;
+        plannedLink->reserve();
+    } else if (connectedTo!=nullptr) {
+        // wait on the server, the route is asked again at each step
+        destination=Vector2D(connectedTo->position.x(),connectedTo->position.y());
+    }
+    return true;
+}
+
+/**
+ * Congestion-aware next hop: among the links leading to a server strictly
+ * closer to the target (so routes stay loop free), take the one minimizing
+ * link length + remaining distance + congestionWeight × occupancy of the door.
+ * Without congestion the result is the first link of the shortest path.
+ */
+Link* Drone::chooseLink() const {
+    const QPair<Link*,qreal> first=route(connectedTo);
+    const qreal here=first.second;
+    Link *best=first.first;
+    if (best==nullptr) return nullptr;
+    qreal bestCost=here+congestionWeight*best->getOccupancy();
+    for (Link *l:connectedTo->links) {
+        if (!l->isUsable()) continue;
+        Server *next=l->getOther(connectedTo);
+        const QPair<Link*,qreal> r=(next==target)?QPair<Link*,qreal>(nullptr,0.0):route(next);
+        if (next!=target && r.first==nullptr) continue; // unreachable
+        const qreal remaining=r.second;
+        if (remaining>=here) continue;
+        const qreal cost=l->getDistance()+remaining+congestionWeight*l->getOccupancy();
+        if (cost<bestCost) {
+            bestCost=cost;
+            best=l;
+        }
+    }
+    return best;
+}
+
 /* Motions of the drone to reach the "destination" position*/
 void Drone::move(qreal dt)
 {
@@ -34,7 +143,8 @@ void Drone::move(qreal dt)
      *
      * Dependencies:
      *   - connectedTo is the current associated server (set by overflownArea()).
-     *   - bestDistance[targetId].first provides the first Link* to follow.
+     *   - bestDistance[targetId].first (or the router of large maps) provides
+     *     the first Link* to follow.
      ***********************************************************************/
 
     // If the drone is not associated with any room/server yet, do nothing.
@@ -72,16 +182,21 @@ void Drone::move(qreal dt)
         if (target != nullptr && connectedTo == target) {
             destination = position;
             speed = Vector2D(0, 0);
-        } else if (target != nullptr &&
-                   target->id >= 0 &&
-                   target->id < connectedTo->bestDistance.size()) {
+            if (kpi && kpiStats.tripTarget == target) kpi->endTrip(kpiStats, delivering);
+        } else if (target != nullptr) {
 
             // Ask routing table: first link toward target
-            Link *nextLink = connectedTo->bestDistance[target->id].first;
+            Link *nextLink = congestionRouting ? chooseLink()
+                                               : route(connectedTo).first;
 
             if (nextLink != nullptr) {
+                // a new trip starts: its lower bound is the shortest route
+                if (kpi && kpiStats.tripTarget != target) kpi->beginTrip(kpiStats, target, route(connectedTo).second);
                 // Next destination becomes the "door center" toward the next room
                 destination = nextLink->getEdgeCenter();
+                if (plannedLink) plannedLink->release();
+                plannedLink = nextLink;
+                plannedLink->reserve();
             } else {
                 // No known path => stop safely
                 destination = position;
@@ -103,6 +218,12 @@ void Drone::move(qreal dt)
         }
 
         if (doorLink != nullptr) {
+            doorLink->cross();
+            if (kpi) kpi->leaveRoom(kpiStats, connectedTo->id);
+            if (plannedLink) {
+                plannedLink->release();
+                plannedLink = nullptr;
+            }
             // Switch to the other server of the link
             Server *a = doorLink->getNode1();
             Server *b = doorLink->getNode2();
@@ -122,6 +243,7 @@ void Drone::move(qreal dt)
     // If already at destination, stop
     if (d < 1e-9) {
         speed = Vector2D(0, 0);
+        position += (dt * separation); // parked drones still make room for the others
         return;
     }
 
@@ -139,7 +261,7 @@ void Drone::move(qreal dt)
     }
 
     // Update position
-    position += (dt * speed);
+    position += (dt * (speed + separation));
 
     // Update orientation for icon rotation
     const double sp = speed.length();
@@ -157,7 +279,34 @@ void Drone::move(qreal dt)
 
 
 
+void Drone::updateSeparation(QList<Drone> &drones,SpatialHash &hash) {
+    hash.build(drones,separationRadius);
+    const qreal maxSpeed=separationStrength*speedMax;
+    const QVector<int> &order=hash.getOrder(); // neighbours visited one after the other if enabled
+    for (int k=0; k<drones.size(); k++) {
+        const int i=order.isEmpty()?k:order[k];
+        Drone &drone=drones[i];
+        Vector2D push;
+        hash.forEachNeighbour(drone.position,separationRadius,[&](int j,double d2) {
+            if (j==i) return;
+            if (d2<1e-12) { // same position: deterministic direction per drone
+                push+=Vector2D(cos(i*2.39996),sin(i*2.39996));
+                return;
+            }
+            const double dist=sqrt(d2);
+            push+=((1.0-dist/separationRadius)/dist)*(drone.position-drones[j].position);
+        });
+        // the closer the neighbours, the stronger the push, up to maxSpeed
+        const double l=push.length();
+        drone.separation=(l>1.0)?(maxSpeed/l)*push:maxSpeed*push;
+    }
+}
+
 Server* Drone::overflownArea(QList<Server>& list) {
+    if (roomGrid) {
+        connectedTo=roomGrid->locate(position,list);
+        return connectedTo;
+    }
     auto it=list.begin();
     while (it!=list.end() && !it->area.contains(position)) {
         it++;
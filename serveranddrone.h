@@ -5,13 +5,21 @@
 #include <QColor>
 #include <QPainter>
 #include <polygon.h>
+#include <kpi.h>
+#include <atomic>
 
 const qreal accelation = 2.0; // unit/s²
 const qreal speedMax = 1.0; // unit/s
 const qreal speedLocal = 0.1; // unit/s
 const qreal slowDownDistance = 20;
 const qreal minDistance=5;
+const qreal separationRadius=30; ///< drones closer than this distance push each other
+const qreal separationStrength=0.5; ///< maximum avoidance speed, relative to speedMax
+const qreal congestionWeight=40; ///< extra distance per drone already flying to a door
 class Link;
+class SpatialHash;
+class ContractionHierarchy;
+class RoomGrid;
 
 class Server {
 public :
@@ -22,21 +30,52 @@ public :
     Polygon area;
     QList<Link*> links;
     QVector<QPair<Link*,qreal>> bestDistance;
+    QVector<Link*> backupLink; ///< loop free alternate of bestDistance[target].first, nullptr if none
+    bool failed=false; ///< out of service, see Failover
 };
 
 class Link {
 public:
     Link(Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge);
+    /**
+     * @brief set reuses the link for another door, its counters are cleared.
+     */
+    void set(Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge);
     void draw(QPainter &painter);
     Server* getNode1() { return node1; }
     Server* getNode2() { return node2; }
     qreal getDistance() const { return distance; }
     Vector2D getEdgeCenter() { return Vector2D(edgeCenter.x(),edgeCenter.y()); }
+    Server* getOther(const Server *s) { return s==node1?node2:node1; }
+    /**
+     * @brief reserve counts a drone flying to the door of this link.
+     */
+    void reserve() { occupancy++; }
+    /**
+     * @brief release removes a drone from the occupancy of the door.
+     */
+    void release() { if (occupancy>0) occupancy--; }
+    /**
+     * @brief cross counts a drone crossing the door (throughput, KpiCounters).
+     */
+    void cross() { crossings.fetch_add(1,std::memory_order_relaxed); }
+    int getOccupancy() const { return occupancy; }
+    int getCrossings() const { return crossings.load(std::memory_order_relaxed); }
+    void setFailed(bool state) { failed=state; }
+    bool isFailed() const { return failed; }
+    /**
+     * @brief isUsable
+     * @return false if the door or one of its servers is out of service.
+     */
+    bool isUsable() const { return !failed && !node1->failed && !node2->failed; }
 private:
     Server *node1;
     Server *node2;
     QPointF edgeCenter;
     qreal distance;
+    int occupancy=0; ///< number of drones flying to the door
+    std::atomic<int> crossings{0}; ///< number of drones that have crossed the door
+    bool failed=false; ///< door out of service
 };
 
 class Drone {
@@ -46,10 +85,53 @@ public :
     Server *target;
     qreal azimut=0;
     Vector2D destination;
+    Vector2D separation; ///< avoidance speed, set by updateSeparation() before move()
     void move(qreal dt);
     Server* overflownArea(QList<Server>& list);
+    /**
+     * @brief updateSeparation computes the avoidance speed of each drone from its
+     * neighbours closer than separationRadius, found in a spatial hash rebuilt here.
+     * @param drones all the drones
+     * @param hash spatial hash reused between ticks
+     */
+    static void updateSeparation(QList<Drone> &drones,SpatialHash &hash);
+    static bool congestionRouting; ///< next hops chosen with the door occupancy
+    static const ContractionHierarchy *router; ///< routing of the maps without bestDistance table
+    static const RoomGrid *roomGrid; ///< raster of the cells used by overflownArea(), null for a scan of the servers
+    static KpiCounters *kpi; ///< counters fed by move(), null when they are not measured
+    DroneKpi kpiStats; ///< trips of this drone, see KpiCounters
+    bool delivering=true; ///< the flight to target is a delivery, false on the way to a pickup of the Dispatcher
+    Server* getConnectedTo() const { return connectedTo; }
+    Vector2D getSpeed() const { return speed; }
+    /**
+     * @brief isIdle
+     * @return true if the drone is stopped on its final destination (target reached or no route).
+     */
+    bool isIdle() const {
+        return connectedTo!=nullptr && speed.x==0 && speed.y==0 && (destination-position).length()<1e-9;
+    }
+    /**
+     * @brief reroute replaces the planned door when it is out of service, by the
+     * backup next hop or else by the server of the current room.
+     * @return true if the destination has changed.
+     */
+    bool reroute();
 private:
-    Server *connectedTo;
+    Link* chooseLink() const;
+    /**
+     * @brief route gives the first link and the distance from a server to the target,
+     * from the bestDistance table or from the router when it is set.
+     */
+    QPair<Link*,qreal> route(const Server *from) const;
+    /**
+     * @brief backupRoute gives the loop free alternate used when the first link of the route is down.
+     * @param from current server
+     * @param primary first link of the shortest path
+     */
+    QPair<Link*,qreal> backupRoute(const Server *from,const Link *primary) const;
+
+    Server *connectedTo=nullptr;
+    Link *plannedLink=nullptr; ///< link of the door the drone is flying to
     Vector2D speed;
 };
 
@@ -0,0 +1,146 @@
+#include "sharedworld.h"
+#include "serveranddrone.h"
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+quint32 align64(quint64 offset) {
+    return quint32((offset+63)&~quint64(63));
+}
+
+} // namespace
+
+bool SharedWorldWriter::publishWorld(const QByteArray &p_name,const QPoint &origin,const QSize &windowSize,
+                                     const QList<Server> &servers,const QList<Drone> &drones) {
+    close();
+#ifdef Q_OS_UNIX
+    int nVertices=0;
+    for (auto &s:servers) nVertices+=s.area.nbVertices();
+    const quint32 serversOffset=align64(sizeof(SharedHeader));
+    const quint32 verticesOffset=align64(serversOffset+quint64(servers.size())*sizeof(SharedServer));
+    const quint32 dronesOffset=align64(verticesOffset+quint64(nVertices)*2*sizeof(float));
+    const quint64 segmentSize=dronesOffset+quint64(drones.size())*sizeof(SharedDrone);
+
+    // a new object: viewers still mapping a previous segment are not truncated
+    shm_unlink(p_name.constData());
+    const int fd=shm_open(p_name.constData(),O_CREAT|O_RDWR|O_EXCL,0644);
+    if (fd<0) {
+        qWarning() << "shm_open failed:" << p_name << strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd,off_t(segmentSize))!=0) {
+        qWarning() << "ftruncate failed:" << strerror(errno);
+        ::close(fd);
+        shm_unlink(p_name.constData());
+        return false;
+    }
+    void *ptr=mmap(nullptr,segmentSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    ::close(fd); // the mapping stays valid
+    if (ptr==MAP_FAILED) {
+        qWarning() << "mmap failed:" << strerror(errno);
+        shm_unlink(p_name.constData());
+        return false;
+    }
+    name=p_name;
+    memory=ptr;
+    size=segmentSize;
+    header=new (memory) SharedHeader;
+    header->obsolete.store(0,std::memory_order_relaxed);
+    header->reserved=0;
+    header->sequence.store(0,std::memory_order_relaxed);
+    header->generation=0;
+    header->segmentSize=segmentSize;
+    header->serversOffset=serversOffset;
+    header->verticesOffset=verticesOffset;
+    header->dronesOffset=dronesOffset;
+
+    beginWrite();
+    header->generation++;
+    header->time=0;
+    header->windowX=origin.x();
+    header->windowY=origin.y();
+    header->windowWidth=windowSize.width();
+    header->windowHeight=windowSize.height();
+    header->nServers=servers.size();
+    header->nVertices=nVertices;
+    header->nDrones=drones.size();
+    auto *tabServers=reinterpret_cast<SharedServer*>(static_cast<char*>(memory)+serversOffset);
+    auto *tabVertices=reinterpret_cast<float*>(static_cast<char*>(memory)+verticesOffset);
+    int first=0;
+    for (int i=0; i<servers.size(); i++) {
+        const Server &s=servers[i];
+        SharedServer &ss=tabServers[i];
+        ss.x=s.position.x();
+        ss.y=s.position.y();
+        ss.rgb=s.color.rgb()&0xFFFFFF;
+        ss.firstVertex=first;
+        ss.nVertices=s.area.nbVertices();
+        memset(ss.name,0,sizeof(ss.name));
+        const QByteArray utf8=s.name.toUtf8();
+        memcpy(ss.name,utf8.constData(),qMin(int(sizeof(ss.name))-1,int(utf8.size())));
+        for (int k=0; k<ss.nVertices; k++) {
+            tabVertices[2*(first+k)]=s.area[k].x;
+            tabVertices[2*(first+k)+1]=s.area[k].y;
+        }
+        first+=ss.nVertices;
+    }
+    endWrite();
+    publishDrones(0,drones);
+    // readers only accept the segment once it is complete
+    header->version=sharedWorldVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic=sharedWorldMagic;
+    return true;
+#else
+    Q_UNUSED(p_name);
+    Q_UNUSED(origin);
+    Q_UNUSED(windowSize);
+    Q_UNUSED(servers);
+    Q_UNUSED(drones);
+    qWarning() << "Shared memory export is only available on POSIX systems";
+    return false;
+#endif
+}
+
+void SharedWorldWriter::beginWrite() {
+    header->sequence.store(header->sequence.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedWorldWriter::endWrite() {
+    header->sequence.store(header->sequence.load(std::memory_order_relaxed)+1,std::memory_order_release);
+}
+
+void SharedWorldWriter::publishDrones(qint64 time,const QList<Drone> &drones) {
+    if (header==nullptr) return;
+    auto *tab=reinterpret_cast<SharedDrone*>(static_cast<char*>(memory)+header->dronesOffset);
+    const int n=qMin(int(drones.size()),header->nDrones);
+    beginWrite();
+    header->time=time;
+    for (int i=0; i<n; i++) {
+        const Drone &d=drones[i];
+        tab[i]={d.position.x,d.position.y,float(d.azimut),
+                d.getConnectedTo()?d.getConnectedTo()->id:-1,d.target?d.target->id:-1};
+    }
+    endWrite();
+}
+
+void SharedWorldWriter::close() {
+    if (header==nullptr) return;
+#ifdef Q_OS_UNIX
+    header->obsolete.store(1,std::memory_order_release);
+    munmap(memory,size);
+    shm_unlink(name.constData());
+#endif
+    header=nullptr;
+    memory=nullptr;
+    size=0;
+}
@@ -0,0 +1,99 @@
+#ifndef SHAREDWORLD_H
+#define SHAREDWORLD_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPoint>
+#include <QSize>
+#include <atomic>
+
+class Server;
+class Drone;
+
+/*************************************************************************
+ * Layout of the shared memory segment, read by external viewers:
+ * SharedHeader, nServers SharedServer, nVertices cell vertices (2 floats),
+ * nDrones SharedDrone. Offsets are given in the header.
+ *************************************************************************/
+
+const char sharedWorldDefaultName[]="/dronesandrooms";
+const quint32 sharedWorldMagic=0x4D535244; // "DRSM"
+const quint32 sharedWorldVersion=1;
+
+struct SharedHeader {
+    quint32 magic;
+    quint32 version;
+    std::atomic<quint32> obsolete; ///< 1 when the writer has removed this segment: readers open it again
+    quint32 reserved;
+    /**
+     * @brief sequence of the seqlock: odd while the writer updates the content,
+     * a reader keeps its copy only if the sequence is even and the same before and after.
+     */
+    std::atomic<quint64> sequence;
+    quint64 generation; ///< increased when the servers change
+    qint64 time; ///< simulation time of the drones (ms)
+    qint32 windowX,windowY,windowWidth,windowHeight;
+    qint32 nServers,nVertices,nDrones;
+    quint32 serversOffset,verticesOffset,dronesOffset;
+    quint64 segmentSize;
+};
+
+struct SharedServer {
+    float x,y;
+    quint32 rgb; ///< color as 0xRRGGBB
+    qint32 firstVertex,nVertices; ///< cell polygon in the vertices table
+    char name[28]; ///< zero terminated
+};
+
+struct SharedDrone {
+    float x,y;
+    float azimut; ///< degrees
+    qint32 server; ///< id of the current server, -1 if none
+    qint32 target; ///< id of the target server, -1 if none
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free,"the seqlock must be lock free between processes");
+
+/**
+ * @brief The SharedWorldWriter class exports the map and the drones in a POSIX
+ * shared memory segment for viewers running in other processes.
+ * The simulation writes the drones in place, inside a seqlock: it never waits
+ * for the readers and no copy of the table is made.
+ * @warning only available on POSIX systems (open() fails elsewhere).
+ */
+class SharedWorldWriter {
+public:
+    ~SharedWorldWriter() { close(); }
+    /**
+     * @brief publishWorld (re)creates the segment for a scenario and writes the servers and cells.
+     * @param name name of the segment (starts with '/')
+     * @param origin window origin
+     * @param windowSize window size
+     * @param servers servers of the map
+     * @param drones drones of the scenario
+     * @return false if the segment cannot be created.
+     */
+    bool publishWorld(const QByteArray &name,const QPoint &origin,const QSize &windowSize,
+                      const QList<Server> &servers,const QList<Drone> &drones);
+    /**
+     * @brief publishDrones writes the current state of the drones.
+     * @param time simulation time (ms)
+     * @param drones same drones as given to publishWorld()
+     */
+    void publishDrones(qint64 time,const QList<Drone> &drones);
+    /**
+     * @brief close marks the segment obsolete, unmaps and removes it.
+     */
+    void close();
+    bool isOpen() const { return header!=nullptr; }
+private:
+    void beginWrite();
+    void endWrite();
+
+    QByteArray name;
+    void *memory=nullptr;
+    quint64 size=0;
+    SharedHeader *header=nullptr;
+};
+
+#endif // SHAREDWORLD_H
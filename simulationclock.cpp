@@ -0,0 +1,61 @@
+#include "simulationclock.h"
+#include <limits>
+
+void SimulationClock::start() {
+    wallTimer.start();
+    time=0;
+    pending=0;
+    lastTick=0;
+    takeMetrics();
+}
+
+void SimulationClock::beginTick() {
+    if (!wallTimer.isValid()) start();
+    const qint64 now=wallTimer.nsecsElapsed();
+    const qint64 wallDt=now-lastTick;
+    lastTick=now;
+    tickSteps=0;
+    if (scale<0) { // as fast as possible: only the budget stops the tick
+        pending=std::numeric_limits<qint64>::max();
+    } else {
+        pending=qint64(wallDt*scale);
+    }
+}
+
+bool SimulationClock::nextSubStep(qint64 &dt) {
+    if (pending<=0) return false;
+    stepStart=wallTimer.nsecsElapsed();
+    if (tickSteps>0 && stepStart-lastTick>=budget) { // at least one sub-step per tick
+        if (scale>=0) lagged+=pending;
+        pending=0;
+        return false;
+    }
+    dt=qMin(pending,maxSubStep);
+    tickSteps++;
+    pending-=dt;
+    time+=dt;
+    simulated+=dt;
+    return true;
+}
+
+void SimulationClock::endSubStep() {
+    const qint64 cost=wallTimer.nsecsElapsed()-stepStart;
+    steps++;
+    totalCost+=cost;
+    if (cost>maxCost) maxCost=cost;
+}
+
+SimulationMetrics SimulationClock::takeMetrics() {
+    SimulationMetrics m;
+    m.steps=steps;
+    m.simulated=simulated;
+    m.meanCost=steps>0?totalCost/steps:0;
+    m.maxCost=maxCost;
+    m.lagged=lagged;
+    steps=0;
+    simulated=0;
+    totalCost=0;
+    maxCost=0;
+    lagged=0;
+    return m;
+}
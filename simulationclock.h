@@ -0,0 +1,113 @@
+#ifndef SIMULATIONCLOCK_H
+#define SIMULATIONCLOCK_H
+
+#include <QElapsedTimer>
+
+const qint64 nsPerMoveUnit=25000000; ///< one time unit of Drone::move() is 25 ms of simulation
+const qreal scaleMax=-1; ///< time scale of the "as fast as possible" mode
+
+/**
+ * @brief Cost of the sub-steps run since the previous call of SimulationClock::takeMetrics().
+ */
+struct SimulationMetrics {
+    int steps=0; ///< number of sub-steps
+    qint64 simulated=0; ///< simulation time covered by the sub-steps (ns)
+    qint64 meanCost=0; ///< mean wall time of a sub-step (ns)
+    qint64 maxCost=0; ///< longest sub-step (ns)
+    qint64 lagged=0; ///< simulation time dropped because the budget was exhausted (ns)
+};
+
+/**
+ * @brief The SimulationClock class drives the simulation time in nanoseconds.
+ * At each tick, the wall time elapsed since the previous tick is multiplied by
+ * the time scale and split in sub-steps no longer than the maximum sub-step, so
+ * a frame hitch or a high scale never produces a step that jumps over a door.
+ * The sub-steps of a tick stop when the wall budget is used: the time left is
+ * dropped (reported as lag) instead of building an ever growing backlog.
+ * Usage:
+ * @code
+ * clock.beginTick();
+ * qint64 dt;
+ * while (clock.nextSubStep(dt)) {
+ *     step(dt);
+ *     clock.endSubStep();
+ * }
+ * @endcode
+ */
+class SimulationClock {
+public:
+    /**
+     * @brief start resets the simulation time to 0.
+     */
+    void start();
+    bool isStarted() const { return wallTimer.isValid(); }
+    /**
+     * @brief setScale changes the speed of the simulation.
+     * @param p_scale 0 to pause, 1 for real time, scaleMax to run as fast as the budget allows
+     */
+    void setScale(qreal p_scale) { scale=p_scale; }
+    qreal getScale() const { return scale; }
+    /**
+     * @brief setMaxSubStep
+     * @param ns longest simulation time of a sub-step
+     */
+    void setMaxSubStep(qint64 ns) { maxSubStep=qMax(ns,qint64(1)); }
+    qint64 getMaxSubStep() const { return maxSubStep; }
+    /**
+     * @brief setBudget
+     * @param ns wall time allowed to the sub-steps of one tick
+     */
+    void setBudget(qint64 ns) { budget=ns; }
+    /**
+     * @brief beginTick adds the scaled wall time elapsed since the previous tick to the time to simulate.
+     */
+    void beginTick();
+    /**
+     * @brief nextSubStep gives the next sub-step of the current tick.
+     * @param dt duration of the sub-step (ns)
+     * @return false when the tick is complete or its budget is used.
+     */
+    bool nextSubStep(qint64 &dt);
+    /**
+     * @brief endSubStep records the cost of the sub-step given by nextSubStep().
+     */
+    void endSubStep();
+    /**
+     * @brief getTime
+     * @return simulation time at the end of the last sub-step (ns)
+     */
+    qint64 getTime() const { return time; }
+    /**
+     * @brief getTickTime
+     * @return wall time of the last tick (ns since start())
+     */
+    qint64 getTickTime() const { return lastTick; }
+    /**
+     * @brief getWallTime
+     * @return wall time since start() (ns)
+     */
+    qint64 getWallTime() const { return wallTimer.isValid()?wallTimer.nsecsElapsed():0; }
+    /**
+     * @brief takeMetrics
+     * @return the cost of the sub-steps since the previous call.
+     */
+    SimulationMetrics takeMetrics();
+private:
+    QElapsedTimer wallTimer;
+    qreal scale=1;
+    qint64 maxSubStep=nsPerMoveUnit;
+    qint64 budget=50000000;
+    qint64 time=0;
+    qint64 pending=0; ///< simulation time left in the current tick (ns)
+    qint64 lastTick=0;
+    qint64 stepStart=0;
+    int tickSteps=0;
+    // metrics since the last takeMetrics()
+    int steps=0;
+    qint64 simulated=0;
+    qint64 totalCost=0;
+    qint64 maxCost=0;
+    qint64 lagged=0;
+};
+
+#endif // SIMULATIONCLOCK_H
@@ -0,0 +1,91 @@
+#include "spatialhash.h"
+#include "serveranddrone.h"
+#include "hilbert.h"
+#include <algorithm>
+#include <numeric>
+
+void SpatialHash::build(const QVector<Vector2D> &points,qreal p_cellSize) {
+    cellSize=p_cellSize;
+    invCellSize=1.0/p_cellSize;
+    positions=points;
+    sortPoints();
+    if (hilbert) sortHilbert();
+}
+
+void SpatialHash::build(const QList<Drone> &drones,qreal p_cellSize) {
+    cellSize=p_cellSize;
+    invCellSize=1.0/p_cellSize;
+    positions.resize(drones.size());
+    for (int i=0; i<drones.size(); i++) {
+        positions[i]=drones[i].position;
+    }
+    sortPoints();
+    if (hilbert) sortHilbert();
+}
+
+void SpatialHash::sortPoints() {
+    const int n=positions.size();
+    // table size: power of 2 greater than 2n
+    quint32 tableSize=16;
+    while (tableSize<quint32(2*n)) tableSize<<=1;
+    mask=tableSize-1;
+
+    // counting sort of the points by bucket
+    QVector<int> pointBucket(n);
+    bucketStart.fill(0,int(tableSize)+1);
+    for (int i=0; i<n; i++) {
+        pointBucket[i]=bucket(cellCoord(positions[i].x),cellCoord(positions[i].y));
+        bucketStart[pointBucket[i]+1]++;
+    }
+    for (quint32 b=0; b<tableSize; b++) {
+        bucketStart[b+1]+=bucketStart[b];
+    }
+    sortedIndex.resize(n);
+    sortedPos.resize(n);
+    sortedCell.resize(n);
+    QVector<int> fill(bucketStart.begin(),bucketStart.end()-1);
+    for (int i=0; i<n; i++) {
+        const int k=fill[pointBucket[i]]++;
+        sortedIndex[k]=i;
+        sortedPos[k]=positions[i];
+        sortedCell[k]=cellKey(cellCoord(positions[i].x),cellCoord(positions[i].y));
+    }
+}
+
+void SpatialHash::sortHilbert() {
+    const int n=positions.size();
+    orderKey.resize(n);
+    for (int i=0; i<n; i++) {
+        // the cell coordinates wrap on the 65536 x 65536 grid of the curve
+        orderKey[i]=hilbertIndex(quint32(cellCoord(positions[i].x))&0xFFFF,quint32(cellCoord(positions[i].y))&0xFFFF);
+    }
+    auto before=[this](int a,int b) { return orderKey[a]<orderKey[b]; };
+    int unsorted=0;
+    if (order.size()==n) {
+        for (int k=1; k<n; k++) {
+            if (before(order[k],order[k-1])) unsorted++;
+        }
+    }
+    if (order.size()!=n || unsorted>n/16) { // new points or big moves: full sort
+        order.resize(n);
+        std::iota(order.begin(),order.end(),0);
+        std::sort(order.begin(),order.end(),before);
+        return;
+    }
+    for (int k=1; k<n; k++) {
+        const int v=order[k];
+        int j=k;
+        while (j>0 && before(v,order[j-1])) {
+            order[j]=order[j-1];
+            j--;
+        }
+        order[j]=v;
+    }
+}
+
+void SpatialHash::neighbours(const Vector2D &p,qreal radius,QVector<int> &result) const {
+    result.clear();
+    forEachNeighbour(p,radius,[&result](int i,double) {
+        result.append(i);
+    });
+}
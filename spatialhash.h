@@ -0,0 +1,104 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <QVector>
+#include <QList>
+#include "vector2d.h"
+
+class Drone;
+
+/**
+ * @brief The SpatialHash class is a uniform grid of square cells, hashed in a
+ * table of size O(n), rebuilt at each tick to find the neighbours of the drones.
+ * Points are sorted by cell (counting sort), so a query only reads the few cells
+ * overlapping the search disk.
+ */
+class SpatialHash {
+public:
+    /**
+     * @brief build indexes a set of points.
+     * @param points positions, their index in this array is returned by the queries
+     * @param p_cellSize side of a cell, should be close to the query radius
+     */
+    void build(const QVector<Vector2D> &points,qreal p_cellSize);
+    /**
+     * @brief build indexes the positions of the drones.
+     * @param drones list of drones
+     * @param p_cellSize side of a cell
+     */
+    void build(const QList<Drone> &drones,qreal p_cellSize);
+    /**
+     * @brief forEachNeighbour calls f(index,distance²) for each point at a distance lower than radius.
+     * @param p center of the search
+     * @param radius search distance
+     * @param f callback
+     */
+    template <typename F>
+    void forEachNeighbour(const Vector2D &p,qreal radius,F f) const;
+    /**
+     * @brief neighbours lists the points at a distance lower than radius.
+     * @param p center of the search
+     * @param radius search distance
+     * @param result indices of the points (cleared first)
+     */
+    void neighbours(const Vector2D &p,qreal radius,QVector<int> &result) const;
+    int size() const { return sortedIndex.size(); }
+    qreal getCellSize() const { return cellSize; }
+    /**
+     * @brief setHilbertOrder enables the order of the points along a Hilbert curve
+     * of the cells, computed by each build().
+     */
+    void setHilbertOrder(bool on) { hilbert=on; order.clear(); }
+    /**
+     * @brief getOrder gives the points sorted along the Hilbert curve of their cells,
+     * empty when the order is disabled. Queries made in this order read the same
+     * cells one after the other, which stay in cache.
+     * @return indices of the points.
+     */
+    const QVector<int>& getOrder() const { return order; }
+private:
+    void sortPoints();
+    /**
+     * @brief sortHilbert updates the order of the previous build: the points move
+     * little between two ticks, an insertion sort is then linear.
+     */
+    void sortHilbert();
+    static quint64 cellKey(int cx,int cy) { return (quint64(quint32(cx))<<32)|quint32(cy); }
+    int bucket(int cx,int cy) const {
+        return int((quint32(cx)*73856093u ^ quint32(cy)*19349663u)&mask);
+    }
+    int cellCoord(float v) const { return int(std::floor(v*invCellSize)); }
+
+    qreal cellSize=1.0;
+    qreal invCellSize=1.0;
+    quint32 mask=0;
+    QVector<Vector2D> positions; ///< unsorted input positions
+    QVector<int> bucketStart; ///< first entry of each bucket in sorted arrays (size tableSize+1)
+    QVector<int> sortedIndex; ///< input index of each sorted entry
+    QVector<Vector2D> sortedPos; ///< position of each sorted entry
+    QVector<quint64> sortedCell; ///< cell of each sorted entry (buckets may be shared)
+    bool hilbert=false;
+    QVector<int> order; ///< points along the Hilbert curve, kept between the builds
+    QVector<quint32> orderKey; ///< Hilbert rank of the cell of each point
+};
+
+template <typename F>
+void SpatialHash::forEachNeighbour(const Vector2D &p,qreal radius,F f) const {
+    if (sortedIndex.isEmpty()) return;
+    const double r2=radius*radius;
+    const int x0=cellCoord(p.x-radius),x1=cellCoord(p.x+radius);
+    const int y0=cellCoord(p.y-radius),y1=cellCoord(p.y+radius);
+    for (int cy=y0; cy<=y1; cy++) {
+        for (int cx=x0; cx<=x1; cx++) {
+            const int b=bucket(cx,cy);
+            const quint64 key=cellKey(cx,cy);
+            for (int k=bucketStart[b]; k<bucketStart[b+1]; k++) {
+                if (sortedCell[k]!=key) continue;
+                const double d2=p.distance2(sortedPos[k]);
+                if (d2<r2) f(sortedIndex[k],d2);
+            }
+        }
+    }
+}
+
+#endif // SPATIALHASH_H
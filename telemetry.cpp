@@ -0,0 +1,74 @@
+#include "telemetry.h"
+#include <cstring>
+
+TelemetryRing::TelemetryRing(int p_capacity):capacity(p_capacity),slots(new Slot[p_capacity]) {
+    Q_ASSERT(capacity>0 && (capacity&(capacity-1))==0);
+}
+
+void TelemetryRing::reset(int nbDrones) {
+    for (int i=0; i<capacity; i++) {
+        slots[i].sequence.store(0,std::memory_order_relaxed);
+        slots[i].nbDrones.store(0,std::memory_order_relaxed);
+        slots[i].data.resize(nbDrones);
+    }
+    head.store(0,std::memory_order_release);
+    dropped.store(0,std::memory_order_relaxed);
+}
+
+void TelemetryRing::publish(qint64 time,const QList<Drone> &drones) {
+    const quint64 number=head.load(std::memory_order_relaxed)+1;
+    Slot &slot=slots[number&(capacity-1)];
+    const int n=qMin(int(drones.size()),int(slot.data.size()));
+    slot.sequence.store(2*number-1,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    DroneSample *data=slot.data.data();
+    for (int i=0; i<n; i++) {
+        const Drone &d=drones[i];
+        data[i]={d.position.x,d.position.y,float(d.azimut),d.getConnectedTo()?d.getConnectedTo()->id:-1};
+    }
+    slot.time.store(time,std::memory_order_relaxed);
+    slot.nbDrones.store(n,std::memory_order_relaxed);
+    slot.sequence.store(2*number,std::memory_order_release);
+    head.store(number,std::memory_order_release);
+}
+
+bool TelemetryRing::read(quint64 number,TelemetryFrame &frame) const {
+    if (number==0 || number>getFrameCount()) return false;
+    const Slot &slot=slots[number&(capacity-1)];
+    const quint64 seq=slot.sequence.load(std::memory_order_acquire);
+    if (seq!=2*number) return false; // overwritten
+    const int n=slot.nbDrones.load(std::memory_order_relaxed);
+    frame.drones.resize(n);
+    memcpy(static_cast<void*>(frame.drones.data()),slot.data.constData(),n*sizeof(DroneSample));
+    frame.time=slot.time.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the producer has started to write this slot again during the copy
+    if (slot.sequence.load(std::memory_order_relaxed)!=seq) return false;
+    frame.number=number;
+    return true;
+}
+
+TelemetryReader::TelemetryReader(const TelemetryRing *p_ring):ring(p_ring),last(p_ring->getFrameCount()) {
+}
+
+bool TelemetryReader::next(TelemetryFrame &frame) {
+    const quint64 headFrame=ring->getFrameCount();
+    if (headFrame<last) last=headFrame; // the ring has been reset
+    while (last<headFrame) {
+        // frames older than the capacity are already overwritten
+        const quint64 oldest=headFrame>quint64(ring->capacity)?headFrame-ring->capacity+1:1;
+        quint64 number=qMax(last+1,oldest);
+        if (ring->read(number,frame)) {
+            const quint64 lost=number-last-1;
+            droppedFrames+=lost;
+            ring->dropped.fetch_add(lost,std::memory_order_relaxed);
+            last=number;
+            return true;
+        }
+        // overwritten during the copy: try the next one
+        droppedFrames+=number-last;
+        ring->dropped.fetch_add(number-last,std::memory_order_relaxed);
+        last=number;
+    }
+    return false;
+}
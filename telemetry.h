@@ -0,0 +1,101 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <trajectory.h>
+
+/**
+ * @brief A published state of all the drones.
+ */
+struct TelemetryFrame {
+    quint64 number=0; ///< 1 for the first published frame, 0 if empty
+    qint64 time=0; ///< simulation time (ms)
+    QVector<DroneSample> drones;
+};
+
+/**
+ * @brief The TelemetryRing class is a single producer, multiple consumers ring
+ * of drone snapshots. The simulation publishes a frame after each tick and never
+ * waits: the oldest slot is overwritten. Each slot is protected by a sequence
+ * number (seqlock), a reader copies the frame and checks that the sequence has
+ * not changed during the copy, else the frame is lost for this reader.
+ * Nothing is locked, neither by the producer nor by the readers.
+ */
+class TelemetryRing {
+public:
+    /**
+     * @brief TelemetryRing
+     * @param p_capacity number of frames kept (a power of 2)
+     */
+    explicit TelemetryRing(int p_capacity=16);
+    /**
+     * @brief reset empties the ring and sizes the slots.
+     * @warning not thread safe, readers must not read during a reset.
+     * @param nbDrones number of drones of each frame
+     */
+    void reset(int nbDrones);
+    /**
+     * @brief publish copies the state of the drones in the next slot (producer only).
+     * @param time simulation time (ms)
+     * @param drones drones of the simulation (same number as given to reset())
+     */
+    void publish(qint64 time,const QList<Drone> &drones);
+    /**
+     * @brief read copies a frame if it is still in the ring.
+     * @param number number of the frame
+     * @param frame result
+     * @return false if the frame is not published yet or has been overwritten.
+     */
+    bool read(quint64 number,TelemetryFrame &frame) const;
+    /**
+     * @brief getFrameCount
+     * @return the number of the last published frame.
+     */
+    quint64 getFrameCount() const { return head.load(std::memory_order_acquire); }
+    int getCapacity() const { return capacity; }
+    /**
+     * @brief getDroppedFrames
+     * @return the frames lost by all the readers since the last reset.
+     */
+    quint64 getDroppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+private:
+    friend class TelemetryReader;
+    struct Slot {
+        std::atomic<quint64> sequence{0}; ///< 2n-1 while frame n is written, 2n when it is complete
+        std::atomic<qint64> time{0};
+        std::atomic<int> nbDrones{0};
+        QVector<DroneSample> data; ///< never reallocated by publish()
+    };
+    int capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<quint64> head{0}; ///< last published frame
+    mutable std::atomic<quint64> dropped{0};
+};
+
+/**
+ * @brief The TelemetryReader class reads all the frames of a ring in order,
+ * frames overwritten before being read are counted as dropped.
+ * Each consumer owns its reader.
+ */
+class TelemetryReader {
+public:
+    /**
+     * @brief TelemetryReader starts after the last published frame.
+     */
+    explicit TelemetryReader(const TelemetryRing *p_ring);
+    /**
+     * @brief next reads the oldest frame not read yet.
+     * @param frame result
+     * @return false if there is no new frame.
+     */
+    bool next(TelemetryFrame &frame);
+    quint64 getDroppedFrames() const { return droppedFrames; }
+private:
+    const TelemetryRing *ring;
+    quint64 last; ///< number of the last frame read or skipped
+    quint64 droppedFrames=0;
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,97 @@
+#include "trace.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QFile>
+#include <QTextStream>
+
+std::atomic<bool> Trace::enabled{false};
+
+namespace {
+
+const int maxEvents=1<<20; ///< older events are dropped beyond this limit
+
+struct TraceEvent {
+    const char *name;
+    qint64 start; ///< ns
+    qint64 duration; ///< ns
+    int thread;
+};
+
+QMutex traceMutex;
+QVector<TraceEvent> events;
+QVector<QPair<const char*,double>> stages; ///< last duration (ms) of each stage
+std::atomic<int> threadCounter{0};
+
+const QElapsedTimer& clock() {
+    static QElapsedTimer timer=[] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer;
+}
+
+int threadIndex() {
+    thread_local int index=threadCounter.fetch_add(1);
+    return index;
+}
+
+} // namespace
+
+void Trace::setEnabled(bool state) {
+    clock(); // starts the time reference
+    enabled.store(state,std::memory_order_relaxed);
+}
+
+qint64 Trace::now() {
+    return clock().nsecsElapsed();
+}
+
+void Trace::record(const char *name,qint64 start,qint64 duration) {
+    const int thread=threadIndex();
+    QMutexLocker lock(&traceMutex);
+    if (events.size()>=maxEvents) {
+        events.remove(0,maxEvents/2);
+    }
+    events.append({name,start,duration,thread});
+
+    auto it=stages.begin();
+    while (it!=stages.end() && it->first!=name) it++;
+    if (it!=stages.end()) {
+        it->second=duration*1e-6;
+    } else {
+        stages.append({name,duration*1e-6});
+    }
+}
+
+void Trace::clear() {
+    QMutexLocker lock(&traceMutex);
+    events.clear();
+    stages.clear();
+}
+
+QVector<QPair<const char*,double>> Trace::lastDurations() {
+    QMutexLocker lock(&traceMutex);
+    return stages;
+}
+
+bool Trace::exportChromeTrace(const QString &filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    QMutexLocker lock(&traceMutex);
+    out << "{\"traceEvents\":[\n";
+    bool first=true;
+    for (auto &e:events) {
+        if (!first) out << ",\n";
+        first=false;
+        // complete events, times in microseconds
+        out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+            << ",\"ts\":" << QString::number(e.start*1e-3,'f',3)
+            << ",\"dur\":" << QString::number(e.duration*1e-3,'f',3) << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
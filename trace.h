@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+#include <atomic>
+
+/**
+ * @brief The Trace class collects timed events of the main stages of the program
+ * (loading, mesh, Voronoi map, links, routing, simulation step, painting).
+ * When tracing is disabled, a scope costs a single atomic read.
+ * Events can be exported in the Chrome trace format (chrome://tracing, Perfetto).
+ */
+class Trace {
+public:
+    static void setEnabled(bool state);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    /**
+     * @brief now
+     * @return the time in nanoseconds since the start of the program.
+     */
+    static qint64 now();
+    /**
+     * @brief record stores a completed event.
+     * @param name static name of the stage (the pointer is kept)
+     * @param start start time in ns (given by now())
+     * @param duration duration in ns
+     */
+    static void record(const char *name,qint64 start,qint64 duration);
+    /**
+     * @brief clear removes all the recorded events.
+     */
+    static void clear();
+    /**
+     * @brief exportChromeTrace writes the events in the Chrome trace JSON format.
+     * @param filename output file
+     * @return true if the file has been written.
+     */
+    static bool exportChromeTrace(const QString &filename);
+    /**
+     * @brief lastDurations gives the last duration of each stage, for the live overlay.
+     * @return list of (name, duration in ms) in order of first appearance.
+     */
+    static QVector<QPair<const char*,double>> lastDurations();
+private:
+    static std::atomic<bool> enabled;
+};
+
+/**
+ * @brief The TraceScope class measures the time spent in the current C++ scope.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char *p_name):name(p_name),start(Trace::isEnabled()?Trace::now():-1) {}
+    ~TraceScope() {
+        if (start>=0) Trace::record(name,start,Trace::now()-start);
+    }
+    TraceScope(const TraceScope&)=delete;
+    TraceScope& operator=(const TraceScope&)=delete;
+private:
+    const char *name;
+    qint64 start;
+};
+
+#define TRACE_CONCAT_(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT_(a,b)
+/// measures the end of the current scope under the given name
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_,__LINE__)(name)
+
+#endif // TRACE_H
@@ -0,0 +1,329 @@
+#include "trajectory.h"
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char fileMagic[4]={'D','R','T','R'};
+const char indexMagic[4]={'D','R','T','I'};
+const quint16 fileVersion=1;
+const int positionQuantisation=16; ///< 1/16 unit
+const int headerSize=16; ///< magic, version, quantisation, nbDrones, keyframeInterval
+const int keyframeEntrySize=20; ///< frame, time, offset
+const int trailerSize=20; ///< nbKeyframes, nbFrames, index offset, magic
+
+inline quint64 zigzag(qint64 v) {
+    return (quint64(v)<<1)^quint64(v>>63);
+}
+
+inline qint64 unzigzag(quint64 v) {
+    return qint64(v>>1)^-qint64(v&1);
+}
+
+void putVarint(QByteArray &buf,quint64 v) {
+    while (v>=0x80) {
+        buf.append(char(v|0x80));
+        v>>=7;
+    }
+    buf.append(char(v));
+}
+
+bool getVarint(const uchar *&p,const uchar *end,quint64 &v) {
+    v=0;
+    int shift=0;
+    while (p<end && shift<64) {
+        uchar b=*p++;
+        v|=quint64(b&0x7F)<<shift;
+        if (!(b&0x80)) return true;
+        shift+=7;
+    }
+    return false;
+}
+
+template <typename T>
+void putRaw(QByteArray &buf,T v) {
+    for (size_t i=0; i<sizeof(T); i++) {
+        buf.append(char((quint64(v)>>(8*i))&0xFF));
+    }
+}
+
+template <typename T>
+T getRaw(const uchar *p) {
+    quint64 v=0;
+    for (size_t i=0; i<sizeof(T); i++) {
+        v|=quint64(p[i])<<(8*i);
+    }
+    return T(v);
+}
+
+inline quint16 quantAzimut(qreal azimut) {
+    return quint16(qint64(std::lround(azimut*65536.0/360.0))&0xFFFF);
+}
+
+} // namespace
+
+/*************************************************************************
+ * TrajectoryWriter
+ *************************************************************************/
+
+bool TrajectoryWriter::open(const QString &filename,int p_nbDrones,int p_keyframeInterval) {
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    nbDrones=p_nbDrones;
+    keyframeInterval=qMax(1,p_keyframeInterval);
+    frameCount=0;
+    index.clear();
+    lastX.fill(0,nbDrones);
+    lastY.fill(0,nbDrones);
+    lastRoom.fill(-1,nbDrones);
+    lastAz.fill(0,nbDrones);
+
+    QByteArray header;
+    header.append(fileMagic,4);
+    putRaw<quint16>(header,fileVersion);
+    putRaw<quint16>(header,positionQuantisation);
+    putRaw<quint32>(header,quint32(nbDrones));
+    putRaw<quint32>(header,quint32(keyframeInterval));
+    file.write(header);
+    return true;
+}
+
+void TrajectoryWriter::writeFrame(qint64 time,const QVector<DroneSample> &drones) {
+    if (!file.isOpen()) return;
+    const bool keyframe=(frameCount%keyframeInterval)==0;
+    buffer.clear();
+    for (int i=0; i<nbDrones; i++) {
+        qint32 x=lastX[i],y=lastY[i],room=lastRoom[i];
+        quint16 az=lastAz[i];
+        if (i<drones.size()) { // missing drones keep their last state
+            const DroneSample &d=drones[i];
+            x=qint32(std::lround(d.x*positionQuantisation));
+            y=qint32(std::lround(d.y*positionQuantisation));
+            az=quantAzimut(d.azimut);
+            room=d.room;
+        }
+        if (keyframe) {
+            putVarint(buffer,zigzag(x));
+            putVarint(buffer,zigzag(y));
+            putVarint(buffer,az);
+            putVarint(buffer,zigzag(room));
+        } else {
+            putVarint(buffer,zigzag(qint64(x)-lastX[i]));
+            putVarint(buffer,zigzag(qint64(y)-lastY[i]));
+            putVarint(buffer,zigzag(qint16(quint16(az-lastAz[i])))); // shortest turn
+            putVarint(buffer,zigzag(qint64(room)-lastRoom[i]));
+        }
+        lastX[i]=x;
+        lastY[i]=y;
+        lastAz[i]=az;
+        lastRoom[i]=room;
+    }
+    if (keyframe) {
+        index.append({quint32(frameCount),time,quint64(file.pos())});
+    }
+    QByteArray head;
+    head.append(keyframe?'K':'D');
+    putVarint(head,zigzag(time));
+    putVarint(head,quint64(buffer.size()));
+    file.write(head);
+    file.write(buffer);
+    frameCount++;
+}
+
+void TrajectoryWriter::close() {
+    if (!file.isOpen()) return;
+    const quint64 indexOffset=quint64(file.pos());
+    QByteArray tail;
+    for (auto &k:index) {
+        putRaw<quint32>(tail,k.frame);
+        putRaw<qint64>(tail,k.time);
+        putRaw<quint64>(tail,k.offset);
+    }
+    putRaw<quint32>(tail,quint32(index.size()));
+    putRaw<quint32>(tail,quint32(frameCount));
+    putRaw<quint64>(tail,indexOffset);
+    tail.append(indexMagic,4);
+    file.write(tail);
+    file.close();
+}
+
+/*************************************************************************
+ * TrajectoryReader
+ *************************************************************************/
+
+bool TrajectoryReader::open(const QString &filename) {
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const qint64 size=file.size();
+    if (size<headerSize) {
+        close();
+        return false;
+    }
+    data=file.map(0,size);
+    if (data==nullptr || memcmp(data,fileMagic,4)!=0 || getRaw<quint16>(data+4)!=fileVersion) {
+        close();
+        return false;
+    }
+    quantisation=getRaw<quint16>(data+6);
+    nbDrones=int(getRaw<quint32>(data+8));
+    lastX.fill(0,nbDrones);
+    lastY.fill(0,nbDrones);
+    lastRoom.fill(-1,nbDrones);
+    lastAz.fill(0,nbDrones);
+
+    bool indexed=false;
+    if (size>=headerSize+trailerSize && memcmp(data+size-4,indexMagic,4)==0) {
+        const quint32 nbKeyframes=getRaw<quint32>(data+size-20);
+        const quint64 indexOffset=getRaw<quint64>(data+size-12);
+        if (indexOffset>=quint64(headerSize) && indexOffset+quint64(nbKeyframes)*keyframeEntrySize==quint64(size-trailerSize)) {
+            frameCount=int(getRaw<quint32>(data+size-16));
+            dataEnd=qint64(indexOffset);
+            const uchar *p=data+indexOffset;
+            index.resize(int(nbKeyframes));
+            indexed=true;
+            for (auto &k:index) {
+                k.frame=getRaw<quint32>(p);
+                k.time=getRaw<qint64>(p+4);
+                k.offset=getRaw<quint64>(p+12);
+                p+=keyframeEntrySize;
+                // a keyframe outside the frames: the index is ignored
+                if (k.offset<quint64(headerSize) || k.offset>=indexOffset) indexed=false;
+            }
+            // duration: time of the last frame, skipping from the last keyframe
+            pos=(!indexed || index.isEmpty())?dataEnd:qint64(index.last().offset);
+            qint64 t;
+            while (peekTime(t)) {
+                duration=t;
+                const uchar *q=data+pos+1;
+                quint64 v,len;
+                if (!getVarint(q,data+dataEnd,v) || !getVarint(q,data+dataEnd,len) || len>quint64(data+dataEnd-q)) break;
+                pos=(q-data)+qint64(len);
+            }
+        }
+    }
+    // log not closed properly: the index is built by a scan of the frames
+    if (!indexed && !rebuildIndex()) {
+        close();
+        return false;
+    }
+    pos=index.isEmpty()?dataEnd:qint64(index.first().offset);
+    return true;
+}
+
+void TrajectoryReader::close() {
+    if (data) file.unmap(const_cast<uchar*>(data));
+    data=nullptr;
+    if (file.isOpen()) file.close();
+    index.clear();
+    dataEnd=pos=0;
+    frameCount=0;
+    duration=0;
+}
+
+bool TrajectoryReader::rebuildIndex() {
+    dataEnd=file.size();
+    pos=headerSize;
+    frameCount=0;
+    index.clear();
+    while (pos<dataEnd) {
+        const uchar *q=data+pos+1;
+        quint64 t,len;
+        if (!getVarint(q,data+dataEnd,t) || !getVarint(q,data+dataEnd,len) || (q-data)+qint64(len)>dataEnd) {
+            dataEnd=pos; // truncated last frame
+            break;
+        }
+        if (data[pos]=='K') {
+            index.append({quint32(frameCount),unzigzag(t),quint64(pos)});
+        }
+        duration=unzigzag(t);
+        frameCount++;
+        pos=(q-data)+qint64(len);
+    }
+    return true;
+}
+
+bool TrajectoryReader::peekTime(qint64 &time) const {
+    if (pos>=dataEnd) return false;
+    const uchar *q=data+pos+1;
+    quint64 t;
+    if (!getVarint(q,data+dataEnd,t)) return false;
+    time=unzigzag(t);
+    return true;
+}
+
+bool TrajectoryReader::readFrame(qint64 &time,QVector<DroneSample> &samples) {
+    if (pos>=dataEnd) return false;
+    const bool keyframe=data[pos]=='K';
+    const uchar *p=data+pos+1;
+    const uchar *end=data+dataEnd;
+    quint64 t,len;
+    // the frames of an indexed log are not checked at the opening
+    if (!getVarint(p,end,t) || !getVarint(p,end,len) || len>quint64(end-p)) {
+        pos=dataEnd;
+        return false;
+    }
+    time=unzigzag(t);
+    end=p+len;
+    samples.resize(nbDrones);
+    quint64 vx,vy,va,vr;
+    for (int i=0; i<nbDrones; i++) {
+        if (!getVarint(p,end,vx) || !getVarint(p,end,vy) || !getVarint(p,end,va) || !getVarint(p,end,vr)) {
+            pos=dataEnd;
+            return false;
+        }
+        if (keyframe) {
+            lastX[i]=qint32(unzigzag(vx));
+            lastY[i]=qint32(unzigzag(vy));
+            lastAz[i]=quint16(va);
+            lastRoom[i]=qint32(unzigzag(vr));
+        } else {
+            lastX[i]+=qint32(unzigzag(vx));
+            lastY[i]+=qint32(unzigzag(vy));
+            lastAz[i]=quint16(lastAz[i]+unzigzag(va));
+            lastRoom[i]+=qint32(unzigzag(vr));
+        }
+        samples[i].x=float(lastX[i])/quantisation;
+        samples[i].y=float(lastY[i])/quantisation;
+        samples[i].azimut=lastAz[i]*360.0f/65536.0f;
+        samples[i].room=lastRoom[i];
+    }
+    pos=end-data;
+    return true;
+}
+
+bool TrajectoryReader::seekTime(qint64 time) {
+    if (index.isEmpty()) return false;
+    // last keyframe at or before time
+    auto it=std::upper_bound(index.begin(),index.end(),time,[](qint64 t,const Keyframe &k) { return t<k.time; });
+    if (it!=index.begin()) it--;
+    pos=qint64(it->offset);
+    // decode the following frames while the next one is still before time
+    QVector<DroneSample> tmp;
+    qint64 frameTime;
+    while (true) {
+        const qint64 current=pos;
+        const uchar *q=data+pos+1;
+        quint64 t,len;
+        if (!getVarint(q,data+dataEnd,t) || !getVarint(q,data+dataEnd,len) || len>quint64(data+dataEnd-q)) break;
+        pos=(q-data)+qint64(len);
+        qint64 nextTime;
+        const bool hasNext=peekTime(nextTime);
+        pos=current;
+        if (!hasNext || nextTime>time) break;
+        readFrame(frameTime,tmp);
+    }
+    return true;
+}
+
+bool TrajectoryReader::readUntil(qint64 time,qint64 &frameTime,QVector<DroneSample> &samples) {
+    bool found=false;
+    qint64 t;
+    while (peekTime(t) && t<=time) {
+        if (!readFrame(frameTime,samples)) break;
+        found=true;
+    }
+    return found;
+}
@@ -0,0 +1,121 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <QFile>
+#include <QVector>
+#include <serveranddrone.h>
+
+/**
+ * @brief State of a drone in a recorded frame.
+ */
+struct DroneSample {
+    float x,y; ///< position
+    float azimut; ///< orientation in degrees [0,360[
+    int room; ///< id of the current server, -1 if none
+};
+
+/**
+ * @brief The TrajectoryWriter class records the drones at each simulation step
+ * in a compact binary log.
+ * Positions are quantised (1/16 unit) and azimuts use 16 bits. Each frame stores
+ * the zigzag varint differences with the previous frame, except keyframes (every
+ * keyframeInterval frames) that store absolute values to allow random seeks.
+ * An index of the keyframes is written at the end of the file by close().
+ */
+class TrajectoryWriter {
+public:
+    ~TrajectoryWriter() { close(); }
+    /**
+     * @brief open creates the log file.
+     * @param filename output file
+     * @param nbDrones number of drones in each frame
+     * @param keyframeInterval number of frames between two keyframes
+     * @return true if the file is created.
+     */
+    bool open(const QString &filename,int nbDrones,int keyframeInterval=50);
+    /**
+     * @brief writeFrame appends a state of the drones.
+     * @param time time of the frame in ms
+     * @param drones state of the drones (same size as given to open())
+     */
+    void writeFrame(qint64 time,const QVector<DroneSample> &drones);
+    /**
+     * @brief close writes the keyframe index and closes the file.
+     */
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    int getFrameCount() const { return frameCount; }
+private:
+    struct Keyframe {
+        quint32 frame;
+        qint64 time;
+        quint64 offset;
+    };
+    QFile file;
+    QByteArray buffer; ///< encoding buffer of the current frame, reused
+    QVector<qint32> lastX,lastY,lastRoom; ///< quantised state of the previous frame
+    QVector<quint16> lastAz;
+    QVector<Keyframe> index;
+    int nbDrones=0;
+    int keyframeInterval=50;
+    int frameCount=0;
+};
+
+/**
+ * @brief The TrajectoryReader class reads a log written by TrajectoryWriter.
+ * The file is mapped in memory, seeking starts from the nearest keyframe.
+ */
+class TrajectoryReader {
+public:
+    ~TrajectoryReader() { close(); }
+    bool open(const QString &filename);
+    void close();
+    int getDroneCount() const { return nbDrones; }
+    int getFrameCount() const { return frameCount; }
+    qint64 getDuration() const { return duration; }
+    /**
+     * @brief seekTime places the reader so that the next frame read is the
+     * last frame recorded at or before time.
+     * @param time in ms from the start of the recording
+     * @return false if the log is empty.
+     */
+    bool seekTime(qint64 time);
+    /**
+     * @brief readFrame decodes the next frame.
+     * @param time time of the frame
+     * @param samples states of the drones
+     * @return false at the end of the log.
+     */
+    bool readFrame(qint64 &time,QVector<DroneSample> &samples);
+    /**
+     * @brief readUntil decodes the frames up to a time and keeps the last one.
+     * @param time limit time in ms
+     * @param frameTime time of the last frame decoded
+     * @param samples states of the drones in this frame
+     * @return false if no frame was available before time.
+     */
+    bool readUntil(qint64 time,qint64 &frameTime,QVector<DroneSample> &samples);
+    bool atEnd() const { return pos>=dataEnd; }
+private:
+    struct Keyframe {
+        quint32 frame;
+        qint64 time;
+        quint64 offset;
+    };
+    bool peekTime(qint64 &time) const;
+    bool rebuildIndex();
+
+    QFile file;
+    const uchar *data=nullptr;
+    qint64 dataEnd=0; ///< end of the frames (start of the index)
+    qint64 pos=0; ///< offset of the next frame
+    QVector<Keyframe> index;
+    QVector<qint32> lastX,lastY,lastRoom;
+    QVector<quint16> lastAz;
+    int nbDrones=0;
+    int quantisation=16;
+    int frameCount=0;
+    qint64 duration=0;
+};
+
+#endif // TRAJECTORY_H
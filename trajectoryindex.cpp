@@ -0,0 +1,370 @@
+#include "trajectoryindex.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char indexFileMagic[4]={'D','R','S','X'};
+const quint32 indexFormatVersion=1;
+const quint32 noTile=0xFFFFFFFF;
+const int tileOffset=32768; ///< tile coordinates are stored on 16 bits
+
+/**
+ * @brief Index file: header, room visits (TreeVisit x nbVisits), room trees
+ * (RoomTree x nbRooms), drone visits (RoomVisit x nbVisits), drone offsets
+ * (nbDrones+1), bucket offsets (nbBuckets+1) and tile entries (nbEntries).
+ * Every section is a multiple of 8 bytes: the tables are read in place.
+ */
+struct IndexHeader {
+    char magic[4];
+    quint32 formatVersion;
+    quint32 nbDrones;
+    quint32 nbRooms;
+    quint32 logFrames;
+    float tileSize;
+    qint64 bucketWidth;
+    quint64 nbVisits;
+    quint64 nbBuckets;
+    quint64 nbEntries;
+};
+
+static_assert(sizeof(IndexHeader)%8==0,"unaligned index sections");
+static_assert(sizeof(RoomVisit)==24 && sizeof(TileEntry)==8,"unexpected index record size");
+static_assert(sizeof(TrajectoryIndex::TreeVisit)==32 && sizeof(TrajectoryIndex::RoomTree)==24,"unexpected index record size");
+
+inline int tileCoord(qreal v,qreal tileSize) {
+    return qBound(0,int(std::floor(v/tileSize))+tileOffset,0xFFFF);
+}
+
+inline quint32 tileId(int column,int row) {
+    return (quint32(row)<<16)|quint32(column);
+}
+
+/**
+ * @brief buildTree computes the latest end of each subtree of an implicit interval tree.
+ * The visits are sorted by start; the leaves are the even indices, the node i of
+ * level k (k trailing ones) has the children i-2^(k-1) and i+2^(k-1). Nodes beyond the
+ * array are skipped: the latest end of the last real subtree is carried up instead.
+ * @return the level of the root, -1 if there is no visit.
+ */
+int buildTree(TrajectoryIndex::TreeVisit *a,qint64 n) {
+    if (n==0) return -1;
+    qint64 lastI=0,last=0;
+    for (qint64 i=0; i<n; i+=2) {
+        lastI=i;
+        last=a[i].maxEnd=a[i].visit.end;
+    }
+    int k=1;
+    for (; (qint64(1)<<k)<=n; k++) {
+        const qint64 x=qint64(1)<<(k-1),i0=(x<<1)-1,step=x<<2;
+        for (qint64 i=i0; i<n; i+=step) {
+            const qint64 left=a[i-x].maxEnd;
+            const qint64 right=i+x<n?a[i+x].maxEnd:last;
+            a[i].maxEnd=qMax(a[i].visit.end,qMax(left,right));
+        }
+        lastI=((lastI>>k)&1)?lastI-x:lastI+x; // parent of the previous lastI
+        if (lastI<n && a[lastI].maxEnd>last) last=a[lastI].maxEnd;
+    }
+    return k-1;
+}
+
+/**
+ * @brief overlapTree calls f for each visit with start < t2 and t1 < end.
+ * The left subtrees ending before t1 and the right subtrees starting after t2
+ * are not visited; small subtrees are scanned.
+ */
+template <typename F>
+void overlapTree(const TrajectoryIndex::TreeVisit *a,qint64 n,int maxLevel,qint64 t1,qint64 t2,F f) {
+    if (n==0 || maxLevel<0) return;
+    struct Node {
+        qint64 x;
+        int k;
+        bool leftDone;
+    } stack[64];
+    int t=0;
+    stack[t++]={(qint64(1)<<maxLevel)-1,maxLevel,false};
+    while (t>0) {
+        const Node z=stack[--t];
+        if (z.k<=3) {
+            const qint64 i0=z.x>>z.k<<z.k;
+            const qint64 i1=qMin(i0+(qint64(1)<<(z.k+1))-1,n);
+            for (qint64 i=i0; i<i1 && a[i].visit.start<t2; i++) {
+                if (t1<a[i].visit.end) f(a[i].visit);
+            }
+        } else if (!z.leftDone) {
+            const qint64 y=z.x-(qint64(1)<<(z.k-1));
+            stack[t++]={z.x,z.k,true};
+            if (y>=n || a[y].maxEnd>t1) stack[t++]={y,z.k-1,false};
+        } else if (z.x<n && a[z.x].visit.start<t2) {
+            if (t1<a[z.x].visit.end) f(a[z.x].visit);
+            stack[t++]={z.x+(qint64(1)<<(z.k-1)),z.k-1,false};
+        }
+    }
+}
+
+} // namespace
+
+/*************************************************************************
+ * TrajectoryIndexBuilder
+ *************************************************************************/
+
+void TrajectoryIndexBuilder::start(int p_nbDrones,qint64 p_bucketWidth,qreal p_tileSize) {
+    nbDrones=p_nbDrones;
+    bucketWidth=qMax(qint64(1),p_bucketWidth);
+    tileSize=p_tileSize>0?p_tileSize:50;
+    lastTime=0;
+    empty=true;
+    currentRoom.fill(-1,nbDrones);
+    enterTime.fill(0,nbDrones);
+    visits.clear();
+    currentBucket=-1;
+    lastTile.fill(noTile,nbDrones);
+    bucketEntries.clear();
+    bucketStart.clear();
+    entries.clear();
+}
+
+void TrajectoryIndexBuilder::addFrame(qint64 time,const QVector<DroneSample> &drones) {
+    const qint64 bucket=qMax(qint64(0),time/bucketWidth);
+    if (bucket>currentBucket) {
+        flushBucket();
+        while (bucketStart.size()<=bucket) bucketStart.append(quint64(entries.size()));
+        currentBucket=bucket;
+        lastTile.fill(noTile,nbDrones);
+    }
+    const int n=qMin(nbDrones,int(drones.size()));
+    for (int i=0; i<n; i++) {
+        const DroneSample &d=drones[i];
+        if (d.room!=currentRoom[i]) {
+            if (currentRoom[i]>=0) visits.append({enterTime[i],time,i,currentRoom[i]});
+            currentRoom[i]=d.room;
+            enterTime[i]=time;
+        }
+        const quint32 tile=tileId(tileCoord(d.x,tileSize),tileCoord(d.y,tileSize));
+        if (tile!=lastTile[i]) {
+            bucketEntries.append({tile,i});
+            lastTile[i]=tile;
+        }
+    }
+    lastTime=time;
+    empty=false;
+}
+
+void TrajectoryIndexBuilder::flushBucket() {
+    std::sort(bucketEntries.begin(),bucketEntries.end());
+    bucketEntries.erase(std::unique(bucketEntries.begin(),bucketEntries.end()),bucketEntries.end());
+    entries.append(bucketEntries);
+    bucketEntries.clear();
+}
+
+bool TrajectoryIndexBuilder::save(const QString &filename,int logFrames) {
+    // the visits still open end after the last frame
+    for (int i=0; i<nbDrones; i++) {
+        if (currentRoom[i]>=0 && !empty) visits.append({enterTime[i],lastTime+1,i,currentRoom[i]});
+        currentRoom[i]=-1;
+    }
+    flushBucket();
+    bucketStart.append(quint64(entries.size()));
+    const quint64 nbVisits=quint64(visits.size());
+    const quint64 nbBuckets=quint64(bucketStart.size()-1);
+
+    // visits by room, in interval trees
+    int nbRooms=0;
+    for (auto &v:visits) nbRooms=qMax(nbRooms,v.room+1);
+    std::sort(visits.begin(),visits.end(),[](const RoomVisit &a,const RoomVisit &b) {
+        return a.room<b.room || (a.room==b.room && a.start<b.start);
+    });
+    QVector<TrajectoryIndex::TreeVisit> tree(visits.size());
+    QVector<TrajectoryIndex::RoomTree> trees(nbRooms);
+    for (int i=0; i<visits.size(); i++) tree[i]={visits[i],0};
+    for (int i=0,r=0; r<nbRooms; r++) {
+        TrajectoryIndex::RoomTree &rt=trees[r];
+        rt.first=quint64(i);
+        while (i<visits.size() && visits[i].room==r) i++;
+        rt.count=quint64(i)-rt.first;
+        rt.maxLevel=buildTree(tree.data()+rt.first,qint64(rt.count));
+        rt.padding=0;
+    }
+
+    // visits by drone, in time order
+    std::sort(visits.begin(),visits.end(),[](const RoomVisit &a,const RoomVisit &b) {
+        return a.drone<b.drone || (a.drone==b.drone && a.start<b.start);
+    });
+    QVector<quint64> droneStart(nbDrones+1,0);
+    for (auto &v:visits) droneStart[v.drone+1]++;
+    for (int i=0; i<nbDrones; i++) droneStart[i+1]+=droneStart[i];
+
+    QSaveFile out(filename);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    IndexHeader header;
+    memcpy(header.magic,indexFileMagic,4);
+    header.formatVersion=indexFormatVersion;
+    header.nbDrones=quint32(nbDrones);
+    header.nbRooms=quint32(nbRooms);
+    header.logFrames=quint32(logFrames);
+    header.tileSize=float(tileSize);
+    header.bucketWidth=bucketWidth;
+    header.nbVisits=nbVisits;
+    header.nbBuckets=nbBuckets;
+    header.nbEntries=quint64(entries.size());
+    out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    out.write(reinterpret_cast<const char*>(tree.constData()),qint64(tree.size())*sizeof(TrajectoryIndex::TreeVisit));
+    out.write(reinterpret_cast<const char*>(trees.constData()),qint64(trees.size())*sizeof(TrajectoryIndex::RoomTree));
+    out.write(reinterpret_cast<const char*>(visits.constData()),qint64(visits.size())*sizeof(RoomVisit));
+    out.write(reinterpret_cast<const char*>(droneStart.constData()),qint64(droneStart.size())*sizeof(quint64));
+    out.write(reinterpret_cast<const char*>(bucketStart.constData()),qint64(bucketStart.size())*sizeof(quint64));
+    out.write(reinterpret_cast<const char*>(entries.constData()),qint64(entries.size())*sizeof(TileEntry));
+    const bool ok=out.commit();
+    start(nbDrones,bucketWidth,tileSize);
+    return ok;
+}
+
+bool TrajectoryIndexBuilder::buildFromLog(const QString &logFile,const QString &indexFile) {
+    TrajectoryReader reader;
+    if (!reader.open(logFile)) return false;
+    TrajectoryIndexBuilder builder;
+    builder.start(reader.getDroneCount());
+    qint64 time;
+    QVector<DroneSample> samples;
+    while (reader.readFrame(time,samples)) builder.addFrame(time,samples);
+    return builder.save(indexFile,reader.getFrameCount());
+}
+
+/*************************************************************************
+ * TrajectoryIndex
+ *************************************************************************/
+
+bool TrajectoryIndex::open(const QString &filename) {
+    close();
+    file.setFileName(filename);
+    IndexHeader header;
+    if (!file.open(QIODevice::ReadOnly) || file.size()<qint64(sizeof(header))) {
+        close();
+        return false;
+    }
+    data=file.map(0,file.size());
+    if (data==nullptr) {
+        close();
+        return false;
+    }
+    memcpy(&header,data,sizeof(header));
+    const quint64 maxCount=quint64(file.size())/8; // bounds the products below
+    if (memcmp(header.magic,indexFileMagic,4)!=0 || header.formatVersion!=indexFormatVersion ||
+        header.nbVisits>maxCount || header.nbBuckets>maxCount || header.nbEntries>maxCount ||
+        header.nbRooms>maxCount || header.bucketWidth<=0 || !(header.tileSize>0)) {
+        close();
+        return false;
+    }
+    const quint64 expected=sizeof(header)+header.nbVisits*(sizeof(TreeVisit)+sizeof(RoomVisit))+
+                           header.nbRooms*sizeof(RoomTree)+(quint64(header.nbDrones)+1+header.nbBuckets+1)*sizeof(quint64)+
+                           header.nbEntries*sizeof(TileEntry);
+    if (quint64(file.size())!=expected) {
+        close();
+        return false;
+    }
+    const uchar *p=data+sizeof(header);
+    roomVisits=reinterpret_cast<const TreeVisit*>(p);
+    p+=header.nbVisits*sizeof(TreeVisit);
+    roomTrees=reinterpret_cast<const RoomTree*>(p);
+    p+=header.nbRooms*sizeof(RoomTree);
+    droneVisits=reinterpret_cast<const RoomVisit*>(p);
+    p+=header.nbVisits*sizeof(RoomVisit);
+    droneStart=reinterpret_cast<const quint64*>(p);
+    p+=(quint64(header.nbDrones)+1)*sizeof(quint64);
+    bucketStart=reinterpret_cast<const quint64*>(p);
+    p+=(header.nbBuckets+1)*sizeof(quint64);
+    entries=reinterpret_cast<const TileEntry*>(p);
+
+    // a corrupted file must not index outside the tables
+    bool valid=droneStart[0]==0 && droneStart[header.nbDrones]==header.nbVisits &&
+               bucketStart[0]==0 && bucketStart[header.nbBuckets]==header.nbEntries;
+    for (quint32 i=0; valid && i<header.nbDrones; i++) valid=droneStart[i]<=droneStart[i+1];
+    for (quint64 b=0; valid && b<header.nbBuckets; b++) valid=bucketStart[b]<=bucketStart[b+1];
+    for (quint32 r=0; valid && r<header.nbRooms; r++) {
+        const RoomTree &t=roomTrees[r];
+        valid=t.first<=header.nbVisits && t.count<=header.nbVisits-t.first && t.maxLevel>=-1 && t.maxLevel<62 &&
+              (t.count==0 || (t.maxLevel>=0 && (qint64(1)<<(t.maxLevel+1))>qint64(t.count)));
+    }
+    if (!valid) {
+        qWarning() << "Invalid trajectory index:" << filename;
+        close();
+        return false;
+    }
+    nbDrones=int(header.nbDrones);
+    nbRooms=int(header.nbRooms);
+    logFrames=int(header.logFrames);
+    bucketWidth=header.bucketWidth;
+    tileSize=header.tileSize;
+    nbBuckets=header.nbBuckets;
+    return true;
+}
+
+void TrajectoryIndex::close() {
+    if (data) file.unmap(const_cast<uchar*>(data));
+    data=nullptr;
+    if (file.isOpen()) file.close();
+    nbDrones=nbRooms=logFrames=0;
+    nbBuckets=0;
+    roomVisits=nullptr;
+    roomTrees=nullptr;
+    droneVisits=nullptr;
+    droneStart=bucketStart=nullptr;
+    entries=nullptr;
+}
+
+QVector<RoomVisit> TrajectoryIndex::visitsOfRoom(int room,qint64 t1,qint64 t2) const {
+    QVector<RoomVisit> result;
+    if (room<0 || room>=nbRooms || t2<t1) return result;
+    const RoomTree &t=roomTrees[room];
+    overlapTree(roomVisits+t.first,qint64(t.count),t.maxLevel,t1,t2+1,[&result](const RoomVisit &v) {
+        result.append(v);
+    });
+    std::sort(result.begin(),result.end(),[](const RoomVisit &a,const RoomVisit &b) { return a.start<b.start; });
+    return result;
+}
+
+bool TrajectoryIndex::visitAt(int drone,qint64 t,RoomVisit &visit) const {
+    if (drone<0 || drone>=nbDrones) return false;
+    const RoomVisit *first=droneVisits+droneStart[drone];
+    const RoomVisit *last=droneVisits+droneStart[drone+1];
+    // last visit started at or before t
+    const RoomVisit *it=std::upper_bound(first,last,t,[](qint64 time,const RoomVisit &v) { return time<v.start; });
+    if (it==first || (it-1)->end<=t) return false;
+    visit=*(it-1);
+    return true;
+}
+
+QVector<int> TrajectoryIndex::dronesInArea(const QRectF &area,qint64 t1,qint64 t2) const {
+    QVector<int> result;
+    if (nbBuckets==0 || t2<t1 || t2<0) return result;
+    const quint64 b1=quint64(qMax(qint64(0),t1/bucketWidth));
+    const quint64 b2=qMin(quint64(t2/bucketWidth),nbBuckets-1);
+    const int col0=tileCoord(area.left(),tileSize),col1=tileCoord(area.right(),tileSize);
+    const int row0=tileCoord(area.top(),tileSize),row1=tileCoord(area.bottom(),tileSize);
+    for (quint64 b=b1; b<=b2; b++) {
+        const TileEntry *first=entries+bucketStart[b];
+        const TileEntry *last=entries+bucketStart[b+1];
+        // the tiles of a row are contiguous in the sorted entries
+        for (int row=row0; row<=row1 && first<last; row++) {
+            const quint32 hi=tileId(col1,row);
+            const TileEntry *it=std::lower_bound(first,last,tileId(col0,row),[](const TileEntry &e,quint32 tile) {
+                return e.tile<tile;
+            });
+            for (; it<last && it->tile<=hi; it++) result.append(it->drone);
+            first=it;
+        }
+    }
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+    return result;
+}
+
+QString TrajectoryIndex::indexFileOf(const QString &logFile) {
+    const QFileInfo info(logFile);
+    return info.dir().filePath(info.completeBaseName()+".drsx");
+}
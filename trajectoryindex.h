@@ -0,0 +1,147 @@
+#ifndef TRAJECTORYINDEX_H
+#define TRAJECTORYINDEX_H
+
+#include <QFile>
+#include <QRectF>
+#include <QVector>
+#include <trajectory.h>
+
+/**
+ * @brief Stay of a drone in a room, the drone is in the room for start <= t < end.
+ */
+struct RoomVisit {
+    qint64 start; ///< ms from the start of the recording
+    qint64 end;
+    qint32 drone;
+    qint32 room;
+};
+
+/**
+ * @brief Drone seen in a position tile during a time bucket.
+ */
+struct TileEntry {
+    quint32 tile; ///< row in the high 16 bits, column in the low 16 bits
+    qint32 drone;
+    bool operator<(const TileEntry &e) const { return tile<e.tile || (tile==e.tile && drone<e.drone); }
+    bool operator==(const TileEntry &e) const { return tile==e.tile && drone==e.drone; }
+};
+
+/**
+ * @brief The TrajectoryIndexBuilder class builds the index of a trajectory log
+ * frame by frame, alongside the TrajectoryWriter, or from an existing log.
+ * - Room visits: a visit is closed each time a drone changes room.
+ * - Position tiles: for each time bucket, the drones seen in each square tile.
+ */
+class TrajectoryIndexBuilder {
+public:
+    /**
+     * @brief start clears the builder.
+     * @param p_nbDrones number of drones of each frame
+     * @param p_bucketWidth duration of a time bucket of the tiles (ms)
+     * @param p_tileSize side of a position tile
+     */
+    void start(int p_nbDrones,qint64 p_bucketWidth=1000,qreal p_tileSize=50);
+    void addFrame(qint64 time,const QVector<DroneSample> &drones);
+    /**
+     * @brief save closes the open visits and writes the index.
+     * @param filename index file
+     * @param logFrames number of frames of the log, to detect an index out of date
+     * @return false on a write error.
+     */
+    bool save(const QString &filename,int logFrames);
+    /**
+     * @brief buildFromLog reads a whole log and writes its index.
+     * @return false if the log cannot be read or the index written.
+     */
+    static bool buildFromLog(const QString &logFile,const QString &indexFile);
+private:
+    void flushBucket();
+
+    int nbDrones=0;
+    qint64 bucketWidth=1000;
+    qreal tileSize=50;
+    qint64 lastTime=0;
+    bool empty=true;
+    QVector<qint32> currentRoom;
+    QVector<qint64> enterTime;
+    QVector<RoomVisit> visits;
+    qint64 currentBucket=-1;
+    QVector<quint32> lastTile; ///< tile of each drone already recorded in the current bucket
+    QVector<TileEntry> bucketEntries; ///< entries of the current bucket
+    QVector<quint64> bucketStart; ///< first entry of each bucket
+    QVector<TileEntry> entries;
+};
+
+/**
+ * @brief The TrajectoryIndex class answers the incident review queries from the
+ * index file, mapped in memory, without decoding the log.
+ * The visits of each room are sorted by start time in an implicit interval tree
+ * (array ordered by start, each inner node keeps the latest end of its subtree):
+ * the visits overlapping a time range are found in O(log n + k).
+ * The visits of each drone are sorted by time (binary search), the tiles of a
+ * bucket are sorted by tile (binary search of each row of tiles).
+ */
+class TrajectoryIndex {
+public:
+    ~TrajectoryIndex() { close(); }
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const { return data!=nullptr; }
+    int getLogFrameCount() const { return logFrames; }
+    int getDroneCount() const { return nbDrones; }
+    int getRoomCount() const { return nbRooms; }
+    /**
+     * @brief visitsOfRoom lists the drones present in a room during a time range.
+     * @param room server id
+     * @param t1,t2 time range in ms (inclusive)
+     * @return the visits overlapping [t1,t2], by start time.
+     */
+    QVector<RoomVisit> visitsOfRoom(int room,qint64 t1,qint64 t2) const;
+    /**
+     * @brief visitAt gives the room of a drone at a time.
+     * @param visit the visit containing t
+     * @return false if the drone was in no room at t.
+     */
+    bool visitAt(int drone,qint64 t,RoomVisit &visit) const;
+    /**
+     * @brief dronesInArea lists the drones seen in the tiles overlapping an area during a time range.
+     * The answer has the resolution of the tiles and time buckets: it may contain drones
+     * that passed near the area.
+     * @return sorted drone indices.
+     */
+    QVector<int> dronesInArea(const QRectF &area,qint64 t1,qint64 t2) const;
+    static QString indexFileOf(const QString &logFile);
+    /**
+     * @brief Node of the interval tree of a room: a visit and the latest end of its subtree.
+     */
+    struct TreeVisit {
+        RoomVisit visit;
+        qint64 maxEnd;
+    };
+    /**
+     * @brief Visits of a room in the tree array.
+     */
+    struct RoomTree {
+        quint64 first;
+        quint64 count;
+        qint32 maxLevel; ///< level of the root, -1 if empty
+        qint32 padding;
+    };
+private:
+    QFile file;
+    const uchar *data=nullptr;
+    int nbDrones=0;
+    int nbRooms=0;
+    int logFrames=0;
+    qint64 bucketWidth=1000;
+    qreal tileSize=50;
+    quint64 nbBuckets=0;
+    const TreeVisit *roomVisits=nullptr;
+    const RoomTree *roomTrees=nullptr;
+    const RoomVisit *droneVisits=nullptr;
+    const quint64 *droneStart=nullptr; ///< first visit of each drone (nbDrones+1)
+    const quint64 *bucketStart=nullptr; ///< first entry of each bucket (nbBuckets+1)
+    const TileEntry *entries=nullptr;
+};
+
+#endif // TRAJECTORYINDEX_H
@@ -0,0 +1,116 @@
+#include "trajectoryquery.h"
+#include "trajectoryindex.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+
+namespace {
+
+const char usage[]=
+    "usage: --query <log> room <id> <t1> <t2>\n"
+    "       --query <log> where <drone> <t>\n"
+    "       --query <log> area <x0> <y0> <x1> <y1> <t1> <t2>\n"
+    "       --query <log> index\n"
+    "times in seconds from the start of the recording\n";
+
+/**
+ * @brief toMs reads a time in seconds.
+ */
+bool toMs(const QString &s,qint64 &ms) {
+    bool ok;
+    const double v=s.toDouble(&ok);
+    ms=qint64(v*1000.0);
+    return ok;
+}
+
+QString seconds(qint64 ms) {
+    return QString::number(ms/1000.0,'f',3);
+}
+
+} // namespace
+
+int runTrajectoryQuery(const QStringList &args) {
+    QTextStream out(stdout);
+    if (args.size()<2) {
+        out << usage;
+        return 1;
+    }
+    const QString &logFile=args[0];
+    const QString &command=args[1];
+    TrajectoryReader log;
+    if (!log.open(logFile)) {
+        out << "cannot read the log " << logFile << "\n";
+        return 1;
+    }
+    const QString indexFile=TrajectoryIndex::indexFileOf(logFile);
+    TrajectoryIndex index;
+    if (command=="index" || !index.open(indexFile) || index.getLogFrameCount()!=log.getFrameCount() ||
+        index.getDroneCount()!=log.getDroneCount()) {
+        index.close();
+        QElapsedTimer timer;
+        timer.start();
+        if (!TrajectoryIndexBuilder::buildFromLog(logFile,indexFile) || !index.open(indexFile)) {
+            out << "cannot write the index " << indexFile << "\n";
+            return 1;
+        }
+        out << "index " << indexFile << " built in " << timer.elapsed() << " ms ("
+            << log.getFrameCount() << " frames)\n";
+    }
+    if (command=="index") return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (command=="room" && args.size()==5) {
+        bool ok;
+        const int room=args[2].toInt(&ok);
+        qint64 t1,t2;
+        if (ok && toMs(args[3],t1) && toMs(args[4],t2)) {
+            const QVector<RoomVisit> visits=index.visitsOfRoom(room,t1,t2);
+            const qint64 ns=timer.nsecsElapsed();
+            out << "drone\tenter (s)\texit (s)\n";
+            for (auto &v:visits) out << v.drone << "\t" << seconds(v.start) << "\t" << seconds(v.end) << "\n";
+            out << visits.size() << " visits (" << ns/1000 << " us)\n";
+            return 0;
+        }
+    } else if (command=="where" && args.size()==4) {
+        bool ok;
+        const int drone=args[2].toInt(&ok);
+        qint64 t;
+        if (ok && toMs(args[3],t) && drone>=0 && drone<log.getDroneCount()) {
+            // exact position: decoded from the keyframe before t
+            qint64 frameTime;
+            QVector<DroneSample> samples;
+            if (!log.seekTime(t) || !log.readFrame(frameTime,samples) || frameTime>t) {
+                out << "no frame before " << seconds(t) << " s\n";
+                return 1;
+            }
+            const DroneSample &s=samples[drone];
+            RoomVisit visit;
+            const bool inRoom=index.visitAt(drone,t,visit);
+            const qint64 ns=timer.nsecsElapsed();
+            out << "drone " << drone << " at " << seconds(frameTime) << " s: position (" << s.x << ", " << s.y
+                << ") azimut " << s.azimut << "\n";
+            if (inRoom) {
+                out << "room " << visit.room << " from " << seconds(visit.start) << " s to " << seconds(visit.end) << " s\n";
+            } else {
+                out << "in no room\n";
+            }
+            out << "(" << ns/1000 << " us)\n";
+            return 0;
+        }
+    } else if (command=="area" && args.size()==8) {
+        double v[4];
+        bool ok=true;
+        for (int i=0; i<4 && ok; i++) v[i]=args[2+i].toDouble(&ok);
+        qint64 t1,t2;
+        if (ok && toMs(args[6],t1) && toMs(args[7],t2)) {
+            const QRectF area(QPointF(qMin(v[0],v[2]),qMin(v[1],v[3])),QPointF(qMax(v[0],v[2]),qMax(v[1],v[3])));
+            const QVector<int> drones=index.dronesInArea(area,t1,t2);
+            const qint64 ns=timer.nsecsElapsed();
+            for (int d:drones) out << d << "\n";
+            out << drones.size() << " drones (" << ns/1000 << " us)\n";
+            return 0;
+        }
+    }
+    out << usage;
+    return 1;
+}
@@ -0,0 +1,17 @@
+#ifndef TRAJECTORYQUERY_H
+#define TRAJECTORYQUERY_H
+
+#include <QStringList>
+
+/**
+ * @brief runTrajectoryQuery answers an incident review query on a trajectory log
+ * from the command line (DronesAndRooms --query <log> <command> ...) and prints
+ * the result on the standard output. The index of the log (see TrajectoryIndex)
+ * is built first if it is missing or out of date.
+ * @param args the log and the command, times in seconds:
+ * room <id> <t1> <t2>, where <drone> <t>, area <x0> <y0> <x1> <y1> <t1> <t2>, index
+ * @return the exit code of the program.
+ */
+int runTrajectoryQuery(const QStringList &args);
+
+#endif // TRAJECTORYQUERY_H
@@ -1,16 +1,25 @@
 #include <trianglemesh.h>
+#include <trace.h>
 
-TriangleMesh::TriangleMesh(QList<Server> &servers) {
+void TriangleMesh::build(const QList<Server> &servers,Algorithm algorithm) {
+    TRACE_SCOPE("TriangleMesh");
     // fill tabVerticies from servers
+    tabVertices.clear();
     for (auto &s:servers) {
         tabVertices.push_back(Vector2D(s.position.x(),s.position.y()));
     }
+    if (algorithm==DivideAndConquer) {
+        TRACE_SCOPE("delaunayDivideAndConquer");
+        delaunay.build(tabVertices,tabTriangles);
+        return;
+    }
     // create the convex hull
-    Polygon convexHull(tabVertices);
+    convexHull.setConvexHull(tabVertices,hullWork);
 
-    tabTriangles=convexHull.getTriangles();
+    tabTriangles.clear();
+    for (auto &t:convexHull.getTriangles()) tabTriangles.push_back(t);
     // list of server that are not in the convexhull
-    QList<Vector2D> internalVertices;
+    internalVertices.clear();
     for (auto &s:servers) {
         Vector2D p(Vector2D(s.position.x(),s.position.y()));
         if (!convexHull.isAVertex(p)) {
@@ -18,19 +27,44 @@ TriangleMesh::TriangleMesh(QList<Server> &servers) {
         }
     }
 
-    for (auto &vertex:internalVertices) {
-        auto tri=tabTriangles.begin();
-        while (tri!=tabTriangles.end() && !tri->contains(&vertex)) tri++;
-        if (tri!=tabTriangles.end()) {
-            Vector2D v0 = (*tri)[0];
-            Vector2D v1 = (*tri)[1];
-            Vector2D v2 = (*tri)[2];
-            tri->update(v0,v1,vertex);
-            tabTriangles.push_back(Triangle(v1,v2,vertex));
-            tabTriangles.push_back(Triangle(v2,v0,vertex));
+    {
+        TRACE_SCOPE("meshInsertion");
+        for (auto &vertex:internalVertices) {
+            auto tri=tabTriangles.begin();
+            while (tri!=tabTriangles.end() && !tri->contains(&vertex)) tri++;
+            if (tri!=tabTriangles.end()) {
+                // a vertex on an edge (grids, convex hull) splits the two triangles of this edge
+                int edge=-1;
+                for (int i=0; i<3; i++) {
+                    const Vector2D a=(*tri)[i],b=(*tri)[(i+1)%3];
+                    if ((double(b.x)-a.x)*(double(vertex.y)-a.y)==(double(b.y)-a.y)*(double(vertex.x)-a.x)) edge=i;
+                }
+                if (edge>=0) {
+                    Vector2D v0 = (*tri)[edge];
+                    Vector2D v1 = (*tri)[(edge+1)%3];
+                    Vector2D v2 = (*tri)[(edge+2)%3];
+                    tri->update(v0,vertex,v2);
+                    auto opp=tabTriangles.begin();
+                    while (opp!=tabTriangles.end() && !opp->hasEdge(v1,v0)) opp++;
+                    if (opp!=tabTriangles.end()) {
+                        Vector2D v3 = opp->getNextVertex(v0);
+                        opp->update(v1,vertex,v3);
+                        tabTriangles.push_back(Triangle(vertex,v0,v3));
+                    }
+                    tabTriangles.push_back(Triangle(vertex,v1,v2));
+                } else {
+                    Vector2D v0 = (*tri)[0];
+                    Vector2D v1 = (*tri)[1];
+                    Vector2D v2 = (*tri)[2];
+                    tri->update(v0,v1,vertex);
+                    tabTriangles.push_back(Triangle(v1,v2,vertex));
+                    tabTriangles.push_back(Triangle(v2,v0,vertex));
+                }
+            }
         }
     }
 
+    TRACE_SCOPE("delaunayFlips");
     while (!checkDelaunay()) {
         // search the first triangle that is not delaunay compliant and flippabe
         auto it = tabTriangles.begin();
@@ -127,8 +161,8 @@ QPair<Triangle*,Vector2D[4]> TriangleMesh::findOppositTriangle(Triangle *tri, Ve
     return res;
 }
 
-QVector<Vector2D> TriangleMesh::findOppositPointOfTrianglesWithCommonEdge(const Triangle &tri) {
-    QVector<Vector2D> res;
+QVarLengthArray<Vector2D,4> TriangleMesh::findOppositPointOfTrianglesWithCommonEdge(const Triangle &tri) {
+    QVarLengthArray<Vector2D,4> res;
     for (auto &t:tabTriangles) {
         if (tri.hasEdge(t[1],t[0])) res.push_back(t[2]);
         else if (tri.hasEdge(t[2],t[1])) res.push_back(t[0]);
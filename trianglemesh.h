@@ -3,12 +3,30 @@
 
 #include <serveranddrone.h>
 #include <polygon.h>
+#include <delaunay.h>
+#include <QVarLengthArray>
 
 class TriangleMesh {
 public:
-    TriangleMesh(QList<Server> &servers);
+    /**
+     * @brief Algorithm used to build the Delaunay triangulation.
+     * - Incremental: insertion in the triangles of the convex hull then flips.
+     * - DivideAndConquer: parallel O(n log n) build for very large maps, same triangles.
+     * Both use inCircumcircle(): the diagonals between cocircular points are the same.
+     */
+    enum Algorithm { Incremental, DivideAndConquer };
+    TriangleMesh() {}
+    TriangleMesh(const QList<Server> &servers,Algorithm algorithm=Incremental) { build(servers,algorithm); }
+    /**
+     * @brief build triangulates the positions of the servers. The arrays of the
+     * previous build are reused: the build of a map of the same size does not
+     * allocate (except the threads of the divide and conquer on very large maps).
+     */
+    void build(const QList<Server> &servers,Algorithm algorithm=Incremental);
     void setBox(const QPoint &origin,const QSize &size) { winX0=origin.x(); winY0=origin.y(); winX1=origin.x()+size.width(); winY1=origin.y()+size.height(); }
     QVector<Triangle>* getTriangles() { return &tabTriangles; }
+    ConstSpan<Triangle> triangles() const { return {tabTriangles.constData(),int(tabTriangles.size())}; }
+    ConstSpan<Vector2D> vertices() const { return {tabVertices.constData(),int(tabVertices.size())}; }
     bool isInWindow(int x,int y) const { return (x>winX0 && x<winX1 && y>winY0 && y<winY1); }
     bool isInWindow(const Vector2D pos) const { return (pos.x>winX0 && pos.x<winX1 && pos.y>winY0 && pos.y<winY1); }
     int getWindowXmin() const { return winX0; }
@@ -17,14 +35,17 @@ public:
     int getWindowYmax() const { return winY1; }
 private:
     bool checkDelaunay();
-    QVector<Vector2D> findOppositPointOfTrianglesWithCommonEdge(const Triangle &tri);
+    QVarLengthArray<Vector2D,4> findOppositPointOfTrianglesWithCommonEdge(const Triangle &tri);
     QPair<Triangle*,Vector2D[4]> findOppositTriangle(Triangle *tri, Vector2D oppVertex);
     void flipTriangle(Triangle *);
 
     QVector<Vector2D> tabVertices;
     QVector<Triangle> tabTriangles;
-    Polygon* convexHull=nullptr;
-    int winX0,winX1,winY0,winY1;
+    DelaunayBuilder delaunay; ///< buffers of the divide and conquer build
+    Polygon convexHull;
+    QVector<Vector2D> hullWork; ///< buffer of Polygon::setConvexHull()
+    QVector<Vector2D> internalVertices; ///< servers that are not in the convex hull
+    int winX0=0,winX1=0,winY0=0,winY1=0;
 };
 
 #endif // TRIANGLEMESH_H
@@ -0,0 +1,18 @@
+QT       += core gui widgets
+
+CONFIG += c++17
+
+# reads the segment exported by DronesAndRooms (File > Share world)
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    sharedworldreader.cpp \
+    viewerwidget.cpp
+
+HEADERS += \
+    ../sharedworld.h \
+    sharedworldreader.h \
+    viewerwidget.h
+
+unix:!macx: LIBS += -lrt
@@ -0,0 +1,17 @@
+#include "viewerwidget.h"
+
+#include <QApplication>
+
+/**
+ * DroneViewer [segment name]: displays the drones of a DronesAndRooms
+ * process running on the same host, through its shared memory export.
+ */
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    const QStringList args = a.arguments();
+    ViewerWidget w(args.size() > 1 ? args[1].toUtf8() : QByteArray(sharedWorldDefaultName));
+    w.resize(800, 800);
+    w.show();
+    return a.exec();
+}
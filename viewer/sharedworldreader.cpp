@@ -0,0 +1,100 @@
+#include "sharedworldreader.h"
+#include <QThread>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int maxReadTries=100; ///< a read gives up if the writer is always writing
+
+} // namespace
+
+bool SharedWorldReader::open(const QByteArray &name) {
+    close();
+#ifdef Q_OS_UNIX
+    const int fd=shm_open(name.constData(),O_RDONLY,0);
+    if (fd<0) return false;
+    struct stat st;
+    if (fstat(fd,&st)!=0 || quint64(st.st_size)<sizeof(SharedHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *ptr=mmap(nullptr,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if (ptr==MAP_FAILED) return false;
+    const SharedHeader *h=static_cast<const SharedHeader*>(ptr);
+    if (h->magic!=sharedWorldMagic || h->version!=sharedWorldVersion) {
+        munmap(ptr,st.st_size);
+        return false;
+    }
+    memory=ptr;
+    size=st.st_size;
+    header=h;
+    return true;
+#else
+    Q_UNUSED(name);
+    return false;
+#endif
+}
+
+void SharedWorldReader::close() {
+#ifdef Q_OS_UNIX
+    if (memory) munmap(const_cast<void*>(memory),size);
+#endif
+    memory=nullptr;
+    header=nullptr;
+    size=0;
+}
+
+bool SharedWorldReader::read(SharedSnapshot &snapshot) const {
+    if (header==nullptr) return false;
+    for (int i=0; i<maxReadTries; i++) {
+        if (isObsolete()) return false;
+        const quint64 seq=header->sequence.load(std::memory_order_acquire);
+        if (seq&1) { // the writer is updating the segment
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        SharedSnapshot copied=snapshot;
+        const bool valid=copy(copied);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (valid && header->sequence.load(std::memory_order_relaxed)==seq) {
+            snapshot=std::move(copied);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Counts and offsets may be torn during a write: they are checked against the
+ * size of the mapping before any access, the sequence check rejects the copy.
+ */
+bool SharedWorldReader::copy(SharedSnapshot &snapshot) const {
+    const char *base=static_cast<const char*>(memory);
+    const qint64 nServers=header->nServers,nVertices=header->nVertices,nDrones=header->nDrones;
+    if (nServers<0 || nVertices<0 || nDrones<0 ||
+        header->serversOffset+quint64(nServers)*sizeof(SharedServer)>size ||
+        header->verticesOffset+quint64(nVertices)*2*sizeof(float)>size ||
+        header->dronesOffset+quint64(nDrones)*sizeof(SharedDrone)>size) {
+        return false;
+    }
+    if (header->generation!=snapshot.generation) {
+        snapshot.generation=header->generation;
+        snapshot.window=QRect(header->windowX,header->windowY,header->windowWidth,header->windowHeight);
+        snapshot.servers.resize(nServers);
+        memcpy(static_cast<void*>(snapshot.servers.data()),base+header->serversOffset,nServers*sizeof(SharedServer));
+        const float *vertices=reinterpret_cast<const float*>(base+header->verticesOffset);
+        snapshot.vertices.resize(nVertices);
+        for (int k=0; k<nVertices; k++) snapshot.vertices[k]=QPointF(vertices[2*k],vertices[2*k+1]);
+    }
+    snapshot.time=header->time;
+    snapshot.drones.resize(nDrones);
+    memcpy(static_cast<void*>(snapshot.drones.data()),base+header->dronesOffset,nDrones*sizeof(SharedDrone));
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef SHAREDWORLDREADER_H
+#define SHAREDWORLDREADER_H
+
+#include <QPointF>
+#include <QRect>
+#include <QVector>
+#include <sharedworld.h>
+
+/**
+ * @brief A consistent copy of the shared segment.
+ */
+struct SharedSnapshot {
+    quint64 generation=0; ///< 0 until the geometry has been read
+    qint64 time=0;
+    QRect window;
+    QVector<SharedServer> servers;
+    QVector<QPointF> vertices;
+    QVector<SharedDrone> drones;
+};
+
+/**
+ * @brief The SharedWorldReader class maps the segment of a SharedWorldWriter
+ * in read only mode. The geometry is copied again only when its generation
+ * changes, the drones are copied at each read. A copy is kept only if the
+ * seqlock sequence was even and unchanged during the copy, the writer is never
+ * slowed down.
+ */
+class SharedWorldReader {
+public:
+    ~SharedWorldReader() { close(); }
+    bool open(const QByteArray &name);
+    void close();
+    bool isOpen() const { return header!=nullptr; }
+    /**
+     * @brief isObsolete
+     * @return true if the writer has removed the segment (new scenario or end of the program).
+     */
+    bool isObsolete() const { return header && header->obsolete.load(std::memory_order_acquire)!=0; }
+    /**
+     * @brief read updates a snapshot with the current content of the segment.
+     * @param snapshot result, its geometry is reused if the generation is the same
+     * @return false if no consistent state has been read.
+     */
+    bool read(SharedSnapshot &snapshot) const;
+private:
+    bool copy(SharedSnapshot &snapshot) const;
+
+    const void *memory=nullptr;
+    quint64 size=0;
+    const SharedHeader *header=nullptr;
+};
+
+#endif // SHAREDWORLDREADER_H
@@ -0,0 +1,73 @@
+#include "viewerwidget.h"
+#include <QPainter>
+#include <QPolygonF>
+
+ViewerWidget::ViewerWidget(const QByteArray &p_name,QWidget *parent):QWidget(parent),name(p_name) {
+    setWindowTitle("Drone viewer - "+QString::fromUtf8(name));
+    connect(&timer,&QTimer::timeout,this,&ViewerWidget::poll);
+    timer.start(16);
+}
+
+void ViewerWidget::poll() {
+    // the writer has loaded a new scenario or has stopped
+    if (reader.isObsolete()) {
+        reader.close();
+        snapshot=SharedSnapshot();
+    }
+    if (!reader.isOpen() && !reader.open(name)) {
+        update();
+        return;
+    }
+    if (reader.read(snapshot)) {
+        readFailures=0;
+        update();
+    } else {
+        readFailures++;
+    }
+}
+
+void ViewerWidget::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.fillRect(rect(),Qt::white);
+    if (snapshot.generation==0 || snapshot.window.isEmpty()) {
+        painter.drawText(rect(),Qt::AlignCenter,"Waiting for "+QString::fromUtf8(name)+"...");
+        return;
+    }
+    painter.save();
+    painter.scale(qreal(width())/snapshot.window.width(),qreal(height())/snapshot.window.height());
+    painter.translate(-snapshot.window.x(),-snapshot.window.y());
+
+    // cells and servers
+    QPen cellPen(Qt::black);
+    cellPen.setCosmetic(true);
+    for (const SharedServer &s:snapshot.servers) {
+        const QColor color(QRgb(s.rgb)); // opaque
+        if (s.firstVertex>=0 && s.nVertices>2 && s.firstVertex+s.nVertices<=snapshot.vertices.size()) {
+            painter.setPen(cellPen);
+            painter.setBrush(color.lighter(150));
+            painter.drawPolygon(snapshot.vertices.constData()+s.firstVertex,s.nVertices);
+        }
+        painter.setBrush(color);
+        painter.drawEllipse(QPointF(s.x,s.y),15,15);
+    }
+
+    // drones as small arrows
+    const QPolygonF arrow({QPointF(0,-12),QPointF(8,10),QPointF(0,5),QPointF(-8,10)});
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(Qt::darkBlue);
+    for (const SharedDrone &d:snapshot.drones) {
+        painter.save();
+        painter.translate(d.x,d.y);
+        painter.rotate(d.azimut);
+        painter.drawPolygon(arrow);
+        painter.restore();
+    }
+    painter.restore();
+
+    painter.setPen(Qt::black);
+    painter.drawText(8,16,QString("t=%1 s | %2 servers | %3 drones%4")
+                              .arg(snapshot.time/1000.0,0,'f',1)
+                              .arg(snapshot.servers.size())
+                              .arg(snapshot.drones.size())
+                              .arg(QString::fromLatin1(readFailures>0?" | writer busy":"")));
+}
@@ -0,0 +1,28 @@
+#ifndef VIEWERWIDGET_H
+#define VIEWERWIDGET_H
+
+#include <QWidget>
+#include <QTimer>
+#include "sharedworldreader.h"
+
+/**
+ * @brief The ViewerWidget class draws the cells, the servers and the drones
+ * exported by another process, in place of the Canvas of DronesAndRooms.
+ */
+class ViewerWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit ViewerWidget(const QByteArray &p_name,QWidget *parent=nullptr);
+protected:
+    void paintEvent(QPaintEvent*) override;
+private slots:
+    void poll();
+private:
+    QByteArray name; ///< name of the shared memory segment
+    SharedWorldReader reader;
+    SharedSnapshot snapshot;
+    QTimer timer;
+    int readFailures=0;
+};
+
+#endif // VIEWERWIDGET_H
@@ -0,0 +1,797 @@
+#include "world.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <numeric>
+#include <cstring>
+#include <failover.h>
+#include <hilbert.h>
+#include <trace.h>
+
+namespace {
+
+const int hierarchyMinServers=1000; ///< larger maps are routed by a contraction hierarchy
+const char cacheMagic[4]={'D','R','W','C'};
+const quint32 cacheFormatVersion=3;
+
+/**
+ * @brief Cache file: header, then (vertices,triangles) count of each cell,
+ * cell vertices, cell triangles (6 floats), links, first link of the routing
+ * table (n x n, -1 for none), routing distances (n x n doubles) and backup
+ * links (n x n, -1 for none).
+ * The tables are absent (routingSize=0) for maps using a contraction hierarchy,
+ * the hierarchy then ends the file (see ContractionHierarchy::save()).
+ */
+struct CacheHeader {
+    char magic[4];
+    quint32 formatVersion;
+    quint32 algorithmVersion;
+    quint32 nServers;
+    quint32 nLinks;
+    quint32 nVertices; ///< vertices of all the cells
+    quint32 nTriangles; ///< triangles of all the cells
+    quint32 routingSize; ///< nServers, or 0 without routing table
+    quint32 backupSize; ///< nServers, or 0 without backup links
+    quint32 hierarchy; ///< 1 if the contraction hierarchy ends the file
+};
+
+struct CacheLink {
+    qint32 node1,node2; ///< server ids
+    float x,y; ///< center of the common edge
+};
+
+static_assert(sizeof(Vector2D)==2*sizeof(float),"Vector2D is stored as 2 floats");
+
+} // namespace
+
+Q_LOGGING_CATEGORY(lcBuild,"dronesandrooms.build",QtInfoMsg)
+
+World::~World() {
+    qDeleteAll(links);
+    delete router;
+    delete roomGrid;
+}
+
+bool World::build(const QString &filename,const QPoint &defaultOrigin,const QSize &defaultSize,const Progress &p_progress) {
+    TRACE_SCOPE("buildWorld");
+    progress=p_progress;
+    canceled=false;
+    error.clear();
+
+    bool parsed;
+    {
+        TRACE_SCOPE("parseJson");
+        parsed=loader.load(filename);
+    }
+    if (!parsed) {
+        error=loader.errorString();
+        return false;
+    }
+    hasWindow=loader.hasWindow;
+    windowOrigin=hasWindow?loader.windowOrigin:defaultOrigin;
+    windowSize=hasWindow?loader.windowSize:defaultSize;
+    // swap keeps the addresses of the servers targeted by the drones,
+    // the buffers of the previous scenario are reused by the new servers
+    // and its lists by the next load
+    servers.swap(loader.servers);
+    adoptBuffers(loader.servers);
+    drones.swap(loader.drones);
+    // the ids change with the order: the cache key includes it
+    if (loader.spatialOrder) spatialOrder=true;
+    if (spatialOrder) sortServersAlongHilbert(servers,drones);
+    resetRouting(servers.size()<hierarchyMinServers);
+
+    // cells, links and routing only depend on the file, the window and the algorithms
+    const QString cacheFile=cachePath(filename);
+    if (!cacheFile.isEmpty() && loadCache(cacheFile)) {
+        qCDebug(lcBuild) << "World cache hit:" << cacheFile;
+        createRoomGrid(cacheFile);
+        return report(100,"done");
+    }
+
+    if (!computeDerivedData(cacheFile)) return false;
+    if (!cacheFile.isEmpty()) saveCache(cacheFile);
+    return true;
+}
+
+bool World::rebuild(const Progress &p_progress) {
+    TRACE_SCOPE("rebuildWorld");
+    progress=p_progress;
+    canceled=false;
+    error.clear();
+    resetRouting(servers.size()<hierarchyMinServers);
+    return computeDerivedData(QString());
+}
+
+bool World::computeDerivedData(const QString &cacheFile) {
+    if (!report(10,"Voronoi map")) return false;
+    createVoronoiMap();
+    if (!report(40,"links")) return false;
+    createServersLinks();
+    if (!report(60,"routing")) return false;
+    // O(n³) table for small maps, near linear hierarchy for the large ones
+    if (servers.size()>=hierarchyMinServers) {
+        buildHierarchy();
+    } else {
+        fillDistanceArray();
+        if (!canceled) qCDebug(lcBuild) << "Routing table:" << servers.size() << "x" << servers.size();
+    }
+    if (!report(85,"backup routes")) return false;
+    if (router==nullptr) computeBackupLinks();
+    if (!report(90,"room grid")) return false;
+    createRoomGrid(cacheFile);
+    return report(100,"done");
+}
+
+void World::adoptBuffers(QList<Server> &previous) {
+    const int n=qMin(servers.size(),previous.size());
+    for (int i=0; i<n; i++) {
+        Server &s=servers[i];
+        std::swap(s.area,previous[i].area);
+        s.links.swap(previous[i].links);
+        s.bestDistance.swap(previous[i].bestDistance);
+        s.backupLink.swap(previous[i].backupLink);
+        // clear() keeps the capacity
+        s.area.clear();
+        s.links.clear();
+        s.bestDistance.clear();
+        s.backupLink.clear();
+    }
+}
+
+void World::resetRouting(bool table) {
+    if (table) {
+        delete router;
+        router=nullptr;
+        return;
+    }
+    distanceArray.clear();
+    for (auto &s:servers) {
+        s.bestDistance.clear();
+        s.backupLink.clear();
+    }
+}
+
+Link* World::acquireLink(int index,Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge) {
+    if (index<links.size()) {
+        links[index]->set(n1,n2,edge);
+        return links[index];
+    }
+    Link *link=new Link(n1,n2,edge);
+    links.append(link);
+    return link;
+}
+
+void World::releaseLinks(int count) {
+    while (links.size()>count) delete links.takeLast();
+}
+
+QString World::cachePath(const QString &filename) const {
+    QFile file(filename);
+    const QString dir=QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dir.isEmpty() || !file.open(QIODevice::ReadOnly)) return QString();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) return QString();
+    hash.addData(QString("%1 %2 %3 %4 %5 %6").arg(algorithmVersion)
+                 .arg(windowOrigin.x()).arg(windowOrigin.y())
+                 .arg(windowSize.width()).arg(windowSize.height())
+                 .arg(QString::fromLatin1(spatialOrder?"hilbert":"file")).toUtf8());
+    return dir+"/worlds/"+QString::fromLatin1(hash.result().toHex())+".drwc";
+}
+
+bool World::loadCache(const QString &path) {
+    TRACE_SCOPE("loadWorldCache");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const qint64 size=file.size();
+    if (size<qint64(sizeof(CacheHeader))) return false;
+    const uchar *data=file.map(0,size);
+    if (data==nullptr) return false;
+
+    CacheHeader header;
+    memcpy(&header,data,sizeof(header));
+    const qint64 n=servers.size();
+    // table and backup links for the small maps, hierarchy for the large ones
+    const bool hierarchy=n>=hierarchyMinServers;
+    if (memcmp(header.magic,cacheMagic,4)!=0 || header.formatVersion!=cacheFormatVersion ||
+        header.algorithmVersion!=algorithmVersion || header.nServers!=n ||
+        header.routingSize!=(hierarchy?0:n) || header.backupSize!=header.routingSize ||
+        header.hierarchy!=(hierarchy?1:0)) {
+        return false;
+    }
+    const qint64 expected=qint64(sizeof(CacheHeader))+n*2*sizeof(quint32)+
+                          qint64(header.nVertices)*sizeof(Vector2D)+qint64(header.nTriangles)*6*sizeof(float)+
+                          qint64(header.nLinks)*sizeof(CacheLink)+
+                          qint64(header.routingSize)*header.routingSize*(2*sizeof(qint32)+sizeof(double));
+    if (hierarchy?size<=expected:size!=expected) {
+        qWarning() << "Invalid world cache:" << path;
+        return false;
+    }
+
+    const uchar *counts=data+sizeof(CacheHeader);
+    const uchar *vertices=counts+n*2*sizeof(quint32);
+    const uchar *triangles=vertices+qint64(header.nVertices)*sizeof(Vector2D);
+    const uchar *tabLinks=triangles+qint64(header.nTriangles)*6*sizeof(float);
+    const uchar *firstLinks=tabLinks+qint64(header.nLinks)*sizeof(CacheLink);
+    const uchar *distances=firstLinks+n*n*sizeof(qint32);
+    const uchar *backups=distances+n*n*sizeof(double);
+
+    // cells
+    qint64 nv=0,nt=0;
+    QVector<Vector2D> &pts=cachedVertices;
+    QVector<Triangle> &tris=cachedTriangles;
+    for (int i=0; i<n; i++) {
+        quint32 c[2];
+        memcpy(c,counts+i*sizeof(c),sizeof(c));
+        if (nv+c[0]>header.nVertices || nt+c[1]>header.nTriangles) {
+            clearDerivedData();
+            return false;
+        }
+        pts.resize(c[0]);
+        memcpy(pts.data(),vertices+nv*sizeof(Vector2D),c[0]*sizeof(Vector2D));
+        tris.clear();
+        for (quint32 k=0; k<c[1]; k++) {
+            float f[6];
+            memcpy(f,triangles+(nt+k)*sizeof(f),sizeof(f));
+            tris.append(Triangle(Vector2D(f[0],f[1]),Vector2D(f[2],f[3]),Vector2D(f[4],f[5])));
+        }
+        servers[i].area.restore(pts,tris);
+        nv+=c[0];
+        nt+=c[1];
+    }
+
+    // links, in the order of createServersLinks()
+    for (quint32 k=0; k<header.nLinks; k++) {
+        CacheLink l;
+        memcpy(&l,tabLinks+k*sizeof(l),sizeof(l));
+        if (l.node1<0 || l.node1>=n || l.node2<0 || l.node2>=n) {
+            clearDerivedData();
+            return false;
+        }
+        const Vector2D center(l.x,l.y);
+        Link *link=acquireLink(k,&servers[l.node1],&servers[l.node2],{center,center});
+        servers[l.node1].links.append(link);
+        servers[l.node2].links.append(link);
+    }
+    releaseLinks(header.nLinks);
+
+    if (hierarchy) {
+        if (router==nullptr) router=new ContractionHierarchy;
+        if (!router->load(data+expected,size-expected,links)) {
+            qWarning() << "Invalid contraction hierarchy in the world cache:" << path;
+            clearDerivedData();
+            return false;
+        }
+        return true;
+    }
+
+    // routing table and backup links
+    distanceArray.resize(n);
+    for (int i=0; i<n; i++) {
+        servers[i].bestDistance.resize(n);
+        distanceArray[i].resize(n);
+        for (int j=0; j<n; j++) {
+            qint32 link;
+            double d;
+            memcpy(&link,firstLinks+(i*n+j)*sizeof(qint32),sizeof(link));
+            memcpy(&d,distances+(i*n+j)*sizeof(double),sizeof(d));
+            servers[i].bestDistance[j]={link>=0 && link<links.size()?links[link]:nullptr,d};
+            distanceArray[i][j]=float(d);
+        }
+    }
+    for (int i=0; i<n; i++) {
+        servers[i].backupLink.resize(n);
+        for (int j=0; j<n; j++) {
+            qint32 link;
+            memcpy(&link,backups+(i*n+j)*sizeof(qint32),sizeof(link));
+            servers[i].backupLink[j]=link>=0 && link<links.size()?links[link]:nullptr;
+        }
+    }
+    return true;
+}
+
+bool World::saveCache(const QString &path) {
+    TRACE_SCOPE("saveWorldCache");
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    auto write=[&file](const void *src,qint64 bytes) {
+        file.write(reinterpret_cast<const char*>(src),bytes);
+    };
+    const int n=servers.size();
+
+    CacheHeader header;
+    memcpy(header.magic,cacheMagic,4);
+    header.formatVersion=cacheFormatVersion;
+    header.algorithmVersion=algorithmVersion;
+    header.nServers=n;
+    header.nLinks=links.size();
+    header.nVertices=header.nTriangles=0;
+    // the tables are only present on maps routed by fillDistanceArray()
+    header.routingSize=(n>0 && servers[0].bestDistance.size()==n)?n:0;
+    header.backupSize=(n>0 && servers[0].backupLink.size()==n)?header.routingSize:0;
+    header.hierarchy=router!=nullptr?1:0;
+    for (auto &s:servers) {
+        header.nVertices+=s.area.nbVertices();
+        header.nTriangles+=s.area.getTriangles().size();
+    }
+    write(&header,sizeof(header));
+    for (auto &s:servers) {
+        const quint32 c[2]={quint32(s.area.nbVertices()),quint32(s.area.getTriangles().size())};
+        write(c,sizeof(c));
+    }
+    for (auto &s:servers) {
+        const ConstSpan<Vector2D> v=s.area.vertices();
+        write(v.data(),v.size()*sizeof(Vector2D));
+    }
+    for (auto &s:servers) {
+        for (const Triangle &t:s.area.triangleSpan()) {
+            const float f[6]={t[0].x,t[0].y,t[1].x,t[1].y,t[2].x,t[2].y};
+            write(f,sizeof(f));
+        }
+    }
+    QHash<const Link*,qint32> linkIndex;
+    for (Link *l:links) {
+        linkIndex.insert(l,linkIndex.size());
+        const Vector2D center=l->getEdgeCenter();
+        const CacheLink cl={l->getNode1()->id,l->getNode2()->id,center.x,center.y};
+        write(&cl,sizeof(cl));
+    }
+    if (router!=nullptr) {
+        router->save(file,linkIndex);
+        return file.commit();
+    }
+    // an incomplete routing is not cached
+    if (header.routingSize!=quint32(n) || header.backupSize!=quint32(n)) return false;
+    QVector<qint32> firstLinks(n);
+    QVector<double> distances(n);
+    for (int i=0; i<n; i++) {
+        for (int j=0; j<n; j++) {
+            firstLinks[j]=linkIndex.value(servers[i].bestDistance[j].first,-1);
+        }
+        write(firstLinks.constData(),n*sizeof(qint32));
+    }
+    for (int i=0; i<n; i++) {
+        for (int j=0; j<n; j++) {
+            distances[j]=servers[i].bestDistance[j].second;
+        }
+        write(distances.constData(),n*sizeof(double));
+    }
+    for (int i=0; i<n; i++) {
+        for (int j=0; j<n; j++) {
+            firstLinks[j]=linkIndex.value(servers[i].backupLink[j],-1);
+        }
+        write(firstLinks.constData(),n*sizeof(qint32));
+    }
+    return file.commit();
+}
+
+void World::buildHierarchy() {
+    TRACE_SCOPE("buildHierarchy");
+    if (router==nullptr) router=new ContractionHierarchy;
+    router->build(servers,links);
+    qCDebug(lcBuild) << "Contraction hierarchy:" << servers.size() << "servers," << router->getShortcutCount() << "shortcuts";
+}
+
+void World::computeBackupLinks() {
+    TRACE_SCOPE("computeBackupLinks");
+    const qint64 n=servers.size();
+    backupGraph.build(int(n),links);
+    // index of each link, found by a binary search on its address
+    backupLinkIndex.resize(links.size());
+    for (int k=0; k<links.size(); k++) backupLinkIndex[k]={links[k],k};
+    auto byAddress=[](const QPair<const Link*,qint32> &a,const QPair<const Link*,qint32> &b) {
+        return std::less<const Link*>()(a.first,b.first);
+    };
+    std::sort(backupLinkIndex.begin(),backupLinkIndex.end(),byAddress);
+    auto indexOf=[&](const Link *l) {
+        auto it=std::lower_bound(backupLinkIndex.cbegin(),backupLinkIndex.cend(),qMakePair(l,qint32(0)),byAddress);
+        return (l!=nullptr && it!=backupLinkIndex.cend() && it->first==l)?it->second:-1;
+    };
+    QVector<qreal> &dist=backupDistance;
+    QVector<qint32> &firstLinks=backupFirstLinks;
+    dist.resize(n*n);
+    firstLinks.resize(n*n);
+    for (qint64 i=0; i<n; i++) {
+        if (servers[i].bestDistance.size()!=n) return;
+        for (qint64 j=0; j<n; j++) {
+            dist[i*n+j]=servers[i].bestDistance[j].second;
+            firstLinks[i*n+j]=indexOf(servers[i].bestDistance[j].first);
+        }
+    }
+    QVector<qint32> &backups=backupResult;
+    loopFreeAlternates(backupGraph,dist,firstLinks,backups);
+    int covered=0;
+    for (qint64 i=0; i<n; i++) {
+        servers[i].backupLink.resize(n);
+        for (qint64 j=0; j<n; j++) {
+            const qint32 b=backups[i*n+j];
+            servers[i].backupLink[j]=b>=0?links[b]:nullptr;
+            if (b>=0) covered++;
+        }
+    }
+    qCDebug(lcBuild) << "Backup next hops:" << covered << "of" << n*(n-1) << "routes";
+}
+
+void World::clearDerivedData() {
+    qDeleteAll(links);
+    links.clear();
+    for (auto &s:servers) {
+        s.area=Polygon();
+        s.links.clear();
+        s.bestDistance.clear();
+        s.backupLink.clear();
+    }
+    distanceArray.clear();
+    delete roomGrid;
+    roomGrid=nullptr;
+}
+
+void World::createRoomGrid(const QString &cacheFile) {
+    if (roomCellSize<=0) {
+        delete roomGrid;
+        roomGrid=nullptr;
+        return;
+    }
+    // the grid of the previous build keeps its arrays
+    if (roomGrid==nullptr) roomGrid=new RoomGrid;
+    QString gridFile;
+    if (!cacheFile.isEmpty()) {
+        gridFile=QFileInfo(cacheFile).path()+"/"+QFileInfo(cacheFile).completeBaseName()+".drrg";
+        if (roomGrid->map(gridFile,servers.size(),windowOrigin,windowSize,roomCellSize)) return;
+    }
+    roomGrid->build(servers,windowOrigin,windowSize,roomCellSize);
+    if (!gridFile.isEmpty()) roomGrid->save(gridFile);
+}
+
+bool World::report(int percent,const char *stage) {
+    if (!canceled && progress && !progress(percent,stage)) {
+        canceled=true;
+        error="canceled";
+    }
+    return !canceled;
+}
+
+void World::createVoronoiCell(Server &server,const TriangleMesh &mesh,const QVector<const Triangle*> &tabTri) {
+    // tabTri: list of triangles containing vert
+    const Vector2D vert(server.position.x(),server.position.y());
+    server.area.clear();
+    if (tabTri.isEmpty()) return;
+    // find left border
+    auto first = tabTri.begin();
+    auto tt_it = tabTri.begin();
+    bool found=false;
+    while (tt_it!=tabTri.end() && !found) {
+        auto comp_it = tabTri.begin();
+        while (comp_it!=tabTri.end() && (*tt_it)->getNextVertex(vert)!=(*comp_it)->getPrevVertex(vert)) {
+            comp_it++;
+        }
+        if (comp_it==tabTri.end()) {
+            first=tt_it;
+            found=true;
+        }
+        tt_it++;
+    }
+    // create polygon
+
+    //poly->setColor(server.color);
+    tt_it=first;
+    if (found && mesh.isInWindow((*tt_it)->getCenter().x,(*tt_it)->getCenter().y)) { // add a point for the left border
+        Vector2D V = (*first)->nextEdgeNormal(vert);
+        float k;
+        if (V.x > 0) { // (circumCenter+k V).x=width
+            k = (mesh.getWindowXmax() - (*first)->getCenter().x) / float(V.x);
+        } else {
+            k = (mesh.getWindowXmin()-(*first)->getCenter().x) / float(V.x);
+        }
+        if (V.y > 0) { // (circumCenter+k V).y=height
+            k = fmin(k, (mesh.getWindowYmax() - (*first)->getCenter().y) / float(V.y));
+        } else {
+            k = fmin(k, (mesh.getWindowYmin()-(*first)->getCenter().y) / float(V.y));
+        }
+        server.area.addVertex(Vector2D((*first)->getCenter() + k * V));
+    }
+    auto comp_it = first;
+    do {
+        server.area.addVertex((*tt_it)->getCenter());
+        // search triangle on right of tt_it
+        comp_it = tabTri.begin();
+        while (comp_it!=tabTri.end() && (*tt_it)->getPrevVertex(vert)!=(*comp_it)->getNextVertex(vert)) {
+            comp_it++;
+        }
+        if (comp_it!=tabTri.end()) tt_it = comp_it;
+    } while (tt_it!=first && comp_it!=tabTri.end());
+    if (found && mesh.isInWindow((*tt_it)->getCenter())) { // add a point for the right border
+        Vector2D V = (*tt_it)->previousEdgeNormal(vert);
+        float k;
+        if (V.x > 0) { // (circumCenter+k V).x=width
+            k = (mesh.getWindowXmax() - (*tt_it)->getCenter().x) / float(V.x);
+        } else {
+            k = (mesh.getWindowXmin()-(*tt_it)->getCenter().x) / float(V.x);
+        }
+        if (V.y > 0) { // (circumCenter+k V).y=height
+            k = fmin(k, (mesh.getWindowYmax() - (*tt_it)->getCenter().y) / float(V.y));
+        } else {
+            k = fmin(k, (mesh.getWindowYmin()-(*tt_it)->getCenter().y) / float(V.y));
+        }
+        server.area.addVertex(Vector2D((*tt_it)->getCenter() + k * V));
+    }
+    server.area.clip(mesh.getWindowXmin(),mesh.getWindowYmin(),mesh.getWindowXmax(),mesh.getWindowYmax());
+    server.area.triangulate();
+}
+
+void World::createVoronoiMap() {
+    TRACE_SCOPE("createVoronoiMap");
+    // the incremental build is quadratic, large maps use the parallel divide and conquer
+    // (same triangles, cocircular sites included)
+    const int divideAndConquerMinServers=256;
+    const int n=servers.size();
+    const bool large=n>=divideAndConquerMinServers;
+    mesh.build(servers,large?TriangleMesh::DivideAndConquer:TriangleMesh::Incremental);
+    mesh.setBox(windowOrigin,windowSize);
+    if (spatialOrder) sortTrianglesAlongHilbert(*mesh.getTriangles());
+
+    // lists of triangles around each vertex, in the order of the mesh
+    auto vertexKey = [](const Vector2D &v) {
+        quint32 bx,by;
+        memcpy(&bx,&v.x,sizeof(float));
+        memcpy(&by,&v.y,sizeof(float));
+        return (quint64(bx)<<32)|by;
+    };
+    // servers at the same position share their list (slot), found by a binary search
+    siteSlots.resize(n);
+    for (int i=0; i<n; i++) {
+        siteSlots[i]={vertexKey(Vector2D(servers[i].position.x(),servers[i].position.y())),i};
+    }
+    std::sort(siteSlots.begin(),siteSlots.end());
+    serverSlot.resize(n);
+    int slot=-1;
+    for (int k=0; k<n; k++) {
+        if (k==0 || siteSlots[k].first!=siteSlots[k-1].first) slot++;
+        serverSlot[siteSlots[k].second]=slot;
+        siteSlots[k].second=slot;
+    }
+    around.resize(slot+1);
+    for (auto &list:around) list.clear();
+    for (const Triangle &tri:mesh.triangles()) {
+        for (const Vector2D &v:tri.vertices()) {
+            const quint64 key=vertexKey(v);
+            auto it=std::lower_bound(siteSlots.cbegin(),siteSlots.cend(),key,[](const QPair<quint64,int> &e,quint64 k) {
+                return e.first<k;
+            });
+            if (it!=siteSlots.cend() && it->first==key) around[it->second].append(&tri);
+        }
+    }
+
+    // each cell only reads the mesh and writes its own server: parallel stage,
+    // the result does not depend on the scheduling
+    Server *cells=servers.data();
+    auto cell=[&](int i) {
+        createVoronoiCell(cells[i],mesh,around[serverSlot[i]]);
+    };
+    if (large) {
+        cellOrder.resize(n);
+        std::iota(cellOrder.begin(),cellOrder.end(),0);
+        QtConcurrent::blockingMap(cellOrder,cell);
+    } else {
+        // the cells of a small map cost less than a dispatch to the pool
+        for (int i=0; i<n; i++) cell(i);
+    }
+}
+
+void World::createServersLinks()
+{
+    TRACE_SCOPE("createServersLinks");
+    /***********************************************************************
+     ******************
+     ******************
+     * Exercise 2 — Graph Creation (Neighbors)
+     *
+     * Goal:
+     *   Connect servers with a Link if their Voronoi polygons share a common edge.
+     *
+     * Neighbor criterion:
+     *   Two servers i and j are neighbors if polygon(i) and polygon(j)
+     *   contain an identical edge segment (same endpoints, possibly reversed).
+     *
+     * Output:
+     *   - links contains all created Link*
+     *   - each Server.links adjacency list is filled
+     *
+     * Complexity:
+     *   For n servers and ~v edges per polygon:
+     *     O(n^2 * v^2) edge comparisons (acceptable for small n).
+     ***********************************************************************/
+
+    // The links of the previous build are reused in order (no allocation when
+    // reloading a map of the same size), the extra ones are deleted at the end
+    int nLinks = 0;
+
+    // Clear adjacency lists (their capacity is kept)
+    for (auto &s : servers) s.links.clear();
+
+    // Small epsilon-based comparison for points (floating geometry)
+    auto samePoint = [](const Vector2D &a, const Vector2D &b) -> bool {
+        const double eps2 = 1e-6;
+        return a.distance2(b) <= eps2;
+    };
+
+    const int n = servers.size();
+
+    // Compare each pair of servers only once (i < j)
+    for (int i = 0; i < n; ++i) {
+        if (i % 64 == 0 && !report(40 + 20 * i / n, "links")) {
+            releaseLinks(nLinks);
+            return;
+        }
+        for (int j = i + 1; j < n; ++j) {
+
+            const Polygon &polyA = servers[i].area;
+            const Polygon &polyB = servers[j].area;
+
+            bool foundCommonEdge = false;
+            QPair<Vector2D, Vector2D> commonEdge;
+
+            // Compare edges of polygon A with edges of polygon B (views, no copy)
+            for (const EdgeView eA : polyA.edges()) { // (P_k, P_{k+1})
+                for (const EdgeView eB : polyB.edges()) {
+                    // Same edge if endpoints match in same order or reversed order
+                    const bool sameDir =
+                        samePoint(eA.first,  eB.first)  && samePoint(eA.second, eB.second);
+                    const bool oppDir  =
+                        samePoint(eA.first,  eB.second) && samePoint(eA.second, eB.first);
+
+                    if (sameDir || oppDir) {
+                        commonEdge = eA.toPair();
+                        foundCommonEdge = true;
+                        break;
+                    }
+                }
+                if (foundCommonEdge) break;
+            }
+
+            // If polygons share an edge => create a Link between the two servers
+            if (foundCommonEdge) {
+                Link *link = acquireLink(nLinks++,
+                                         &servers[i],
+                                         &servers[j],
+                                         commonEdge);
+
+                servers[i].links.append(link);
+                servers[j].links.append(link);
+            }
+        }
+    }
+    releaseLinks(nLinks);
+}
+
+void World::fillDistanceArray()
+{
+    TRACE_SCOPE("fillDistanceArray");
+    /***********************************************************************
+     * Exercise 2 — All-Pairs Shortest Paths + Routing Table
+     *
+     * Goal:
+     *   Compute the shortest path distance between every pair of servers,
+     *   and store for each source server i and target j:
+     *     - total shortest distance
+     *     - first Link to take (first hop) to reach j from i
+     *
+     * Data structures:
+     *   - distanceArray[i][j] : shortest distance value (for debug/UI)
+     *   - servers[i].bestDistance[j] = { firstLink, totalDistance }
+     *
+     * Algorithm:
+     *   Floyd–Warshall (all-pairs shortest paths)
+     *
+     * Complexity:
+     *   O(n^3), where n = number of servers
+     ***********************************************************************/
+
+    const int nServers = servers.size();
+    const qreal INF = 1e18;
+
+    // Prepare distanceArray
+    distanceArray.resize(nServers);
+    for (int i = 0; i < nServers; ++i)
+        distanceArray[i].resize(nServers);
+
+    // Initialize bestDistance for every server
+    for (auto &s : servers) {
+        s.bestDistance.resize(nServers);
+        for (int j = 0; j < nServers; ++j)
+            s.bestDistance[j] = { nullptr, 0.0 };
+    }
+
+    // dist matrix + next-hop matrix, row major in buffers kept for the next build
+    floydDistance.fill(INF, qsizetype(nServers) * nServers);
+    floydNext.fill(-1, qsizetype(nServers) * nServers);
+    qreal *dist = floydDistance.data();
+    int *next = floydNext.data();
+    auto at = [nServers](int i, int j) { return qsizetype(i) * nServers + j; };
+
+    // Distance from a node to itself is 0
+    for (int i = 0; i < nServers; ++i) {
+        dist[at(i, i)] = 0.0;
+        next[at(i, i)] = i;
+    }
+
+    // Initialize with direct edges from Links
+    for (Link *l : links) {
+        const int a = l->getNode1()->id;
+        const int b = l->getNode2()->id;
+        const qreal w = l->getDistance();
+
+        // Keep smallest edge if duplicates exist
+        if (w < dist[at(a, b)]) {
+            dist[at(a, b)] = w;
+            dist[at(b, a)] = w;
+            next[at(a, b)] = b;
+            next[at(b, a)] = a;
+        }
+    }
+
+    // Floyd–Warshall: try improving dist[i][j] using intermediate k
+    for (int k = 0; k < nServers; ++k) {
+        if (k % 16 == 0 && !report(60 + 40 * k / nServers, "routing")) return;
+        const qreal *distK = dist + at(k, 0);
+        for (int i = 0; i < nServers; ++i) {
+            qreal *distI = dist + at(i, 0);
+            int *nextI = next + at(i, 0);
+            // dist[k][k] is 0: this pass changes neither dist[i][k] nor the row k
+            const qreal distIK = distI[k];
+            const int nextIK = nextI[k];
+            for (int j = 0; j < nServers; ++j) {
+                const qreal alt = distIK + distK[j];
+                if (alt < distI[j]) {
+                    distI[j] = alt;
+                    // First hop from i to j becomes the first hop from i to k
+                    nextI[j] = nextIK;
+                }
+            }
+        }
+    }
+
+    // Build distanceArray + routing table bestDistance
+    for (int i = 0; i < nServers; ++i) {
+        for (int j = 0; j < nServers; ++j) {
+
+            const qreal d = dist[at(i, j)];
+            distanceArray[i][j] = (d >= INF) ? float(INF) : float(d);
+
+            // Same node: no hop needed
+            if (i == j) {
+                servers[i].bestDistance[j] = { nullptr, 0.0 };
+                continue;
+            }
+
+            // Unreachable target
+            if (d >= INF || next[at(i, j)] == -1) {
+                servers[i].bestDistance[j] = { nullptr, d };
+                continue;
+            }
+
+            // The next matrix tells the next node ID (first hop) from i toward j
+            const int firstHop = next[at(i, j)];
+
+            // Find the actual Link* that connects i to firstHop
+            Link *firstLink = nullptr;
+            for (Link *l : servers[i].links) {
+                const int n1 = l->getNode1()->id;
+                const int n2 = l->getNode2()->id;
+                if ((n1 == i && n2 == firstHop) || (n2 == i && n1 == firstHop)) {
+                    firstLink = l;
+                    break;
+                }
+            }
+
+            // Store routing decision + shortest total distance
+            servers[i].bestDistance[j] = { firstLink, d };
+        }
+    }
+    // The complete n×n table is no longer printed (O(n²) strings), the size is
+    // printed by the build, the cost of this stage is available with the tracing.
+}
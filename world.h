@@ -0,0 +1,184 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <QList>
+#include <QLoggingCategory>
+#include <QPoint>
+#include <QSize>
+#include <functional>
+#include <serveranddrone.h>
+#include <trianglemesh.h>
+#include <contractionhierarchy.h>
+#include <roomgrid.h>
+#include <failover.h>
+#include <scenarioloader.h>
+
+const qreal defaultRoomCellSize=4; ///< side of a cell of the room grid
+
+// statistics of each build, off by default: QT_LOGGING_RULES="dronesandrooms.build.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcBuild)
+
+/**
+ * @brief The World class holds a scenario and everything computed from it:
+ * Voronoi cells of the servers, links between neighbour servers and routing table.
+ * A world is built on a background thread without touching the displayed one,
+ * then its content is swapped with the Canvas in a single step.
+ */
+class World {
+public:
+    /**
+     * @brief algorithmVersion must be increased when the computation of the cells,
+     * links or routing changes, it invalidates the cache files.
+     */
+    static constexpr quint32 algorithmVersion=2;
+
+    /**
+     * @brief Progress is called between the stages of the build.
+     * @param percent progress of the build (0..100)
+     * @param stage name of the current stage
+     * @return false to cancel the build.
+     */
+    using Progress=std::function<bool(int percent,const char *stage)>;
+
+    World()=default;
+    ~World();
+    World(const World&)=delete;
+    World& operator=(const World&)=delete;
+
+    /**
+     * @brief build loads a JSON scenario and computes cells, links and routing.
+     * The result is saved in the user cache folder, keyed by a hash of the file, of the
+     * window and of algorithmVersion; when the key matches, the cache file is mapped
+     * and read back instead of computing the geometry and the routing (table, backup
+     * links or contraction hierarchy).
+     * @param filename JSON scenario
+     * @param defaultOrigin window origin used if the scenario has none
+     * @param defaultSize window size used if the scenario has none
+     * @param p_progress optional progress and cancellation callback
+     * @return true if the world is complete, else see errorString().
+     */
+    bool build(const QString &filename,const QPoint &defaultOrigin,const QSize &defaultSize,const Progress &p_progress=Progress());
+    /**
+     * @brief rebuild recomputes cells, links and routing of the current servers, after
+     * an edit of their positions, without the cache.
+     * build() and rebuild() reuse the buffers of the previous build of the world:
+     * servers and drones with their names, mesh, cell vertices and triangles, links,
+     * routing table or hierarchy, backup links and room grid.
+     * Rebuilding a map of the same size does not allocate, except the dispatch of the
+     * parallel stages of the maps of 256 servers or more; reloading it also opens and
+     * maps the files of the scenario and of the cache.
+     * @param p_progress optional progress and cancellation callback
+     * @return false if the rebuild has been canceled.
+     */
+    bool rebuild(const Progress &p_progress=Progress());
+    const QString& errorString() const { return error; }
+    bool isCanceled() const { return canceled; }
+
+    bool hasWindow=false;
+    QPoint windowOrigin;
+    QSize windowSize;
+    QList<Server> servers;
+    QList<Drone> drones;
+    QList<Link*> links; ///< owned by the world
+    QVector<QVector<float>> distanceArray;
+    ContractionHierarchy *router=nullptr; ///< routing of the large maps (no bestDistance table), owned
+    RoomGrid *roomGrid=nullptr; ///< location of the drones in the cells, owned
+    qreal roomCellSize=defaultRoomCellSize; ///< resolution of roomGrid, set before build(), 0 for no grid
+    bool spatialOrder=false; ///< servers and Delaunay triangles sorted along a Hilbert curve by build(), set before it or by "hilbert": true in the scenario
+
+    /**
+     * @brief createVoronoiMap computes the cell of each server from the Delaunay
+     * mesh of the servers, clipped by the window.
+     */
+    void createVoronoiMap();
+    /**
+     * @brief createServersLinks links the servers whose cells share an edge.
+     */
+    void createServersLinks();
+    /**
+     * @brief fillDistanceArray computes the bestDistance table of all the servers
+     * (Floyd-Warshall, O(n³) time, O(n²) memory).
+     */
+    void fillDistanceArray();
+    /**
+     * @brief buildHierarchy preprocesses the graph of links for the router,
+     * used instead of fillDistanceArray() on large maps.
+     */
+    void buildHierarchy();
+    /**
+     * @brief computeBackupLinks sets the loop free alternate of each (server,target)
+     * from the bestDistance table, see loopFreeAlternates().
+     */
+    void computeBackupLinks();
+    /**
+     * @brief createRoomGrid rasterizes the cells over the window, or maps the raster
+     * saved beside the cache file of the world.
+     * @param cacheFile cache file of the world, empty if there is no cache
+     */
+    void createRoomGrid(const QString &cacheFile);
+private:
+    /**
+     * @brief createVoronoiCell builds the clipped and triangulated cell of a server.
+     * @param server the server whose area is computed
+     * @param mesh Delaunay mesh of the servers (read only)
+     * @param tabTri triangles of the mesh having the server as vertex
+     */
+    static void createVoronoiCell(Server &server,const TriangleMesh &mesh,const QVector<const Triangle*> &tabTri);
+    /**
+     * @brief computeDerivedData runs the stages after the loading: cells, links, routing, room grid.
+     * @return false if canceled.
+     */
+    bool computeDerivedData(const QString &cacheFile);
+    /**
+     * @brief adoptBuffers gives the buffers of the servers of the previous scenario
+     * (cell, links, routes) to the new servers, emptied.
+     */
+    void adoptBuffers(QList<Server> &previous);
+    /**
+     * @brief resetRouting drops the routing of the other kind left by a previous build.
+     * @param table true for a map routed by the bestDistance table, false for the hierarchy
+     */
+    void resetRouting(bool table);
+    /**
+     * @brief acquireLink reuses the link of the previous build at this index, or creates it.
+     * @param index number of the link, links are acquired in order
+     */
+    Link* acquireLink(int index,Server *n1,Server *n2,const QPair<Vector2D,Vector2D> &edge);
+    /**
+     * @brief releaseLinks deletes the links left over by the previous build.
+     * @param count number of links acquired by the current build
+     */
+    void releaseLinks(int count);
+    /**
+     * @brief report forwards the progress and records a cancellation.
+     * @return false if the build must stop.
+     */
+    bool report(int percent,const char *stage);
+    QString cachePath(const QString &filename) const;
+    bool loadCache(const QString &path);
+    bool saveCache(const QString &path);
+    void clearDerivedData();
+
+    Progress progress;
+    bool canceled=false;
+    QString error;
+
+    // buffers kept between the builds
+    ScenarioLoader loader; ///< holds the servers and drones of the previous scenario
+    QVector<Vector2D> cachedVertices; ///< vertices of a cell read by loadCache()
+    QVector<Triangle> cachedTriangles; ///< triangles of a cell read by loadCache()
+    TriangleMesh mesh; ///< Delaunay mesh of the servers
+    QVector<QPair<quint64,int>> siteSlots; ///< (position, slot) sorted by position
+    QVector<int> serverSlot; ///< slot of each server, servers at the same position share it
+    QVector<QVector<const Triangle*>> around; ///< triangles of the mesh around each slot
+    QVector<int> cellOrder; ///< servers given to the parallel build of the cells
+    QVector<qreal> floydDistance; ///< n x n distances of fillDistanceArray()
+    QVector<int> floydNext; ///< n x n next servers of fillDistanceArray()
+    RoutingGraph backupGraph; ///< links of computeBackupLinks()
+    QVector<QPair<const Link*,qint32>> backupLinkIndex; ///< (link, index in links) sorted by address
+    QVector<qreal> backupDistance; ///< n x n distances given to loopFreeAlternates()
+    QVector<qint32> backupFirstLinks; ///< n x n primary first links
+    QVector<qint32> backupResult; ///< n x n backup links
+};
+
+#endif // WORLD_H